@@ -10,7 +10,7 @@ Buffer::Buffer(vk::Device device,
                const std::vector<uint32_t>& queueFamilies,
                const Buffer::Info& info) :
   m_device{ device },
-  m_deviceMemoryProperties{ deviceMemoryProperties }
+  m_deviceMemoryProperties{ &deviceMemoryProperties }
 {
     try {
         create(info, queueFamilies);
@@ -31,6 +31,7 @@ void Buffer::create(const Buffer::Info& info, const std::vector<uint32_t>& queue
     m_bufferCount    = info.count;
     m_bufferByteSize = info.elemSize * info.count;
     m_indexType      = info.indexType;
+    m_usage          = info.usage;
 
     vk::BufferCreateInfo bufferCreateInfo{
         .size                  = m_bufferByteSize,
@@ -42,9 +43,15 @@ void Buffer::create(const Buffer::Info& info, const std::vector<uint32_t>& queue
     m_buffer = m_device.createBuffer(bufferCreateInfo);
 
     vk::MemoryRequirements bufferMemReq{ m_device.getBufferMemoryRequirements(m_buffer) };
+    vk::MemoryAllocateFlagsInfo memAllocFlagsInfo{
+        .flags = vk::MemoryAllocateFlagBits::eDeviceAddress,
+    };
     vk::MemoryAllocateInfo memAllocInfo{
+        .pNext           = (info.usage & vk::BufferUsageFlagBits::eShaderDeviceAddress)
+                               ? &memAllocFlagsInfo
+                               : nullptr,
         .allocationSize  = bufferMemReq.size,
-        .memoryTypeIndex = find_memory_type_index(m_deviceMemoryProperties,
+        .memoryTypeIndex = find_memory_type_index(*m_deviceMemoryProperties,
                                                   info.memoryProperties,
                                                   bufferMemReq.memoryTypeBits),
     };
@@ -53,17 +60,46 @@ void Buffer::create(const Buffer::Info& info, const std::vector<uint32_t>& queue
     m_device.bindBufferMemory(m_buffer, m_bufferMemory, 0);
 }
 
-void Buffer::copy_data(vk::DeviceSize offset, vk::DeviceSize size, void* dataSrc)
+void Buffer::copy_data(vk::DeviceSize offset, vk::DeviceSize size, const void* dataSrc)
 {
-    EC_ASSERT(!(m_bufferLocation & vk::MemoryPropertyFlagBits::eDeviceLocal));
+    // Device local too with UMA or resizable BAR (see Device::create_buffer)
+    EC_ASSERT(m_bufferLocation & vk::MemoryPropertyFlagBits::eHostVisible);
+    if (m_mappedData) {
+        memcpy(static_cast<std::byte*>(m_mappedData) + offset, dataSrc, static_cast<size_t>(size));
+        return;
+    }
     void* dataDst;
     std::ignore = m_device.mapMemory(m_bufferMemory, offset, size, {}, &dataDst);
     memcpy(dataDst, dataSrc, static_cast<size_t>(size));
     m_device.unmapMemory(m_bufferMemory);
 }
 
+void* Buffer::map()
+{
+    EC_ASSERT(m_bufferLocation & vk::MemoryPropertyFlagBits::eHostVisible);
+    if (!m_mappedData) {
+        std::ignore = m_device.mapMemory(m_bufferMemory, 0, VK_WHOLE_SIZE, {}, &m_mappedData);
+    }
+    return m_mappedData;
+}
+
+void Buffer::unmap()
+{
+    if (m_mappedData) {
+        m_device.unmapMemory(m_bufferMemory);
+        m_mappedData = nullptr;
+    }
+}
+
+vk::DeviceAddress Buffer::get_device_address() const
+{
+    EC_ASSERT(m_usage & vk::BufferUsageFlagBits::eShaderDeviceAddress);
+    return m_device.getBufferAddress(vk::BufferDeviceAddressInfo{ .buffer = m_buffer });
+}
+
 void Buffer::free()
 {
+    unmap();
     m_device.freeMemory(m_bufferMemory);
     m_device.destroyBuffer(m_buffer);
 }
@@ -7,6 +7,8 @@ class Buffer
 {
     friend class Device;
     friend class GraphicsContext;
+    friend class UniformRing;
+    friend class FrameReadback;
 
 public:
 
@@ -21,11 +23,22 @@ public:
     Buffer(const Buffer&) = default;
     Buffer(Buffer&&)      = default;
 
+    Buffer& operator=(const Buffer&) = default;
+    Buffer& operator=(Buffer&&)      = default;
+
     vk::IndexType get_index_type() const { return m_indexType; }
     uint32_t get_count() const { return m_bufferCount; }
     vk::DeviceSize get_size() const { return m_bufferByteSize; }
 
-    void copy_data(vk::DeviceSize offset, vk::DeviceSize size, void* data);
+    void copy_data(vk::DeviceSize offset, vk::DeviceSize size, const void* data);
+
+    // Keeps the whole buffer mapped until unmap() or free(), copy_data then skips map/unmap
+    void* map();
+    void unmap();
+    void* get_mapped_data() const { return m_mappedData; }
+
+    // Only valid if the buffer was created with eShaderDeviceAddress usage
+    vk::DeviceAddress get_device_address() const;
 
 private:
 
@@ -45,6 +58,8 @@ private:
     vk::Buffer m_buffer;
     vk::DeviceMemory m_bufferMemory;
     vk::MemoryPropertyFlags m_bufferLocation;
+    vk::BufferUsageFlags m_usage;
+    void* m_mappedData{};
 
     uint32_t m_bufferCount{};
     vk::DeviceSize m_bufferByteSize{};
@@ -53,7 +68,7 @@ private:
     vk::IndexType m_indexType{ vk::IndexType::eNoneKHR };
 
     vk::Device m_device;
-    const vk::PhysicalDeviceMemoryProperties& m_deviceMemoryProperties;
+    const vk::PhysicalDeviceMemoryProperties* m_deviceMemoryProperties;
 };
 
 }  // namespace ec::vulkan
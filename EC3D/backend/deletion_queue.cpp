@@ -0,0 +1,52 @@
+#include "pch.hpp"
+#include "deletion_queue.hpp"
+
+namespace ec::vulkan
+{
+
+DeletionQueue::DeletionQueue(vk::Device device) :
+  m_device{ device }
+{
+}
+
+void DeletionQueue::retire(Resource&& resource, uint64_t frameNumber)
+{
+    EC_ASSERT(m_resources.empty() || m_resources.back().frameNumber <= frameNumber);
+    m_resources.push_back({
+        .frameNumber = frameNumber,
+        .resource    = std::move(resource),
+    });
+}
+
+void DeletionQueue::flush(uint64_t completedFrame)
+{
+    while (!m_resources.empty() && m_resources.front().frameNumber <= completedFrame) {
+        destroy(m_resources.front().resource);
+        m_resources.pop_front();
+    }
+}
+
+void DeletionQueue::flush_all()
+{
+    for (auto& retired : m_resources) {
+        destroy(retired.resource);
+    }
+    m_resources.clear();
+}
+
+void DeletionQueue::destroy(Resource& resource)
+{
+    if (auto* image{ std::get_if<Image>(&resource) }) {
+        image->free();
+    } else if (auto* view{ std::get_if<vk::ImageView>(&resource) }) {
+        m_device.destroyImageView(*view);
+    } else if (auto* framebuffer{ std::get_if<vk::Framebuffer>(&resource) }) {
+        m_device.destroyFramebuffer(*framebuffer);
+    } else if (auto* swapchain{ std::get_if<vk::SwapchainKHR>(&resource) }) {
+        m_device.destroySwapchainKHR(*swapchain);
+    } else if (auto* pipeline{ std::get_if<vk::Pipeline>(&resource) }) {
+        m_device.destroyPipeline(*pipeline);
+    }
+}
+
+}  // namespace ec::vulkan
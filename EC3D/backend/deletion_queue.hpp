@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include "image.hpp"
+
+#include <deque>
+#include <variant>
+
+namespace ec::vulkan
+{
+
+// Resources replaced while frames in flight may still use them (e.g. on swapchain recreation).
+// Each one is tagged with the frame number at retirement and destroyed once that frame is done,
+// so replacing them never waits for the device to be idle
+class DeletionQueue
+{
+public:
+
+    using Resource
+        = std::variant<Image, vk::ImageView, vk::Framebuffer, vk::SwapchainKHR, vk::Pipeline>;
+
+    DeletionQueue() = default;
+    explicit DeletionQueue(vk::Device device);
+    DeletionQueue(DeletionQueue&&) = default;
+
+    DeletionQueue& operator=(DeletionQueue&&) = default;
+
+    void retire(Resource&& resource, uint64_t frameNumber);
+
+    // Destroys the resources retired up to completedFrame (inclusive)
+    void flush(uint64_t completedFrame);
+    // Only when the device is idle
+    void flush_all();
+
+    size_t get_size() const { return m_resources.size(); }
+
+private:
+
+    void destroy(Resource& resource);
+
+private:
+
+    vk::Device m_device{};
+
+    struct RetiredResource {
+        uint64_t frameNumber{};
+        Resource resource{};
+    };
+    std::deque<RetiredResource> m_resources{};  // Sorted by frame number
+};
+
+}  // namespace ec::vulkan
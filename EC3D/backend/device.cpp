@@ -3,19 +3,24 @@
 #include "utils.hpp"
 #include "graphics_context.hpp"
 
+#include <numeric>
 #include <set>
+#include <vulkan/vulkan_format_traits.hpp>
 
 namespace ec::vulkan
 {
 
 Device::Device(const Device::Info& info) :
-  m_surface(&info.surface)
+  m_surface(&info.surface),
+  m_recordAhead(info.recordAhead)
 {
     try {
         obtain_physical_device(info.availablePhysicalDevices);
-        create_device(info.extensionsToEnable);
-        create_transfer_command_pool();
-        create_swapchain(info.framebufferSize, info.verticalSync);
+        create_device(info.extensionsToEnable, info.shaderObjects);
+        create_command_pools();
+        m_transferTimeline = QueueTimeline{ m_logicalDevice };
+        m_graphicsTimeline = QueueTimeline{ m_logicalDevice };
+        create_swapchain(info.framebufferSize, info.verticalSync, info.swapchainImages);
     }
     catch (const std::exception& e) {
         EC_LOG_CRITICAL("Unable to initialize Device. Reason: {}", e.what());
@@ -33,6 +38,17 @@ void Device::free()
         m_graphicsContext->free();
     }
     m_swapchain.free(m_logicalDevice);
+    release_finished_uploads();  // All of them after waiting for idle
+    m_transferTimeline.free();
+    m_graphicsTimeline.free();
+    if (m_transferCommandPool) {
+        m_logicalDevice.destroyCommandPool(m_transferCommandPool);
+        m_transferCommandPool = nullptr;
+    }
+    if (m_graphicsCommandPool) {
+        m_logicalDevice.destroyCommandPool(m_graphicsCommandPool);
+        m_graphicsCommandPool = nullptr;
+    }
     if (m_logicalDevice) {
         m_logicalDevice.destroy();
         m_logicalDevice = nullptr;
@@ -41,12 +57,26 @@ void Device::free()
 
 GraphicsContext& Device::create_graphics_context()
 {
+    vk::DeviceSize minBufferOffsetAlignment{ std::max(
+        m_limits.minUniformBufferOffsetAlignment,
+        m_limits.minStorageBufferOffsetAlignment) };
+    // Timestamps are only written if the graphics queue supports them
+    auto queueFamilyProperties{ m_physicalDevice.getQueueFamilyProperties() };
+    bool timestamps{ queueFamilyProperties[m_queueFamilyIndices.graphics].timestampValidBits > 0 };
     GraphicsContext::Info contextInfo{
-        .device                 = m_logicalDevice,
-        .deviceMemoryProperties = m_memoryProperties,
-        .swapchain              = m_swapchain,
-        .queue                  = m_queues.graphics,
-        .queueFamilyIndex       = static_cast<uint32_t>(m_queueFamilyIndices.graphics),
+        .device                   = m_logicalDevice,
+        .deviceMemoryProperties   = m_memoryProperties,
+        .swapchain                = m_swapchain,
+        .queue                    = m_queues.graphics,
+        .queueFamilyIndex         = static_cast<uint32_t>(m_queueFamilyIndices.graphics),
+        .minBufferOffsetAlignment = minBufferOffsetAlignment,
+        .bufferDeviceAddress      = m_enabledFeatures.bufferDeviceAddress,
+        .extendedDynamicState     = m_enabledFeatures.extendedDynamicState,
+        .dynamicRendering         = m_enabledFeatures.dynamicRendering,
+        .graphicsPipelineLibrary  = m_enabledFeatures.graphicsPipelineLibrary,
+        .shaderObject             = m_enabledFeatures.shaderObject,
+        .recordAhead              = m_recordAhead,
+        .timestampPeriod          = timestamps ? m_limits.timestampPeriod : 0.f,
     };
     m_graphicsContext.emplace(contextInfo);
 
@@ -58,60 +88,519 @@ Buffer Device::create_buffer(const Buffer::Info& info)
 {
     std::vector<uint32_t> queueFamilies = { static_cast<uint32_t>(m_queueFamilyIndices.graphics),
                                             static_cast<uint32_t>(m_queueFamilyIndices.transfer) };
-    return Buffer(m_logicalDevice, m_memoryProperties, queueFamilies, info);
+    // Buffers that would be uploaded to are written directly when all device memory is mappable
+    Buffer::Info bufferInfo{ info };
+    if (m_directUploads && (info.memoryProperties & vk::MemoryPropertyFlagBits::eDeviceLocal)
+        && (info.usage & vk::BufferUsageFlagBits::eTransferDst)) {
+        bufferInfo.memoryProperties |= vk::MemoryPropertyFlagBits::eHostVisible
+                                       | vk::MemoryPropertyFlagBits::eHostCoherent;
+    }
+    return Buffer(m_logicalDevice, m_memoryProperties, queueFamilies, bufferInfo);
 }
 
-void Device::transfer_to_buffer(Buffer& dstBuffer, vk::DeviceSize size, void* data)
+void Device::transfer_to_buffer(Buffer& dstBuffer, vk::DeviceSize size, const void* data)
 {
-    // If the destination buffer is not device local, should probably use buffer.copy_data instead
-    EC_ASSERT(dstBuffer.m_bufferLocation & vk::MemoryPropertyFlagBits::eDeviceLocal);
+    transfer_to_buffers({ { .dstBuffer = &dstBuffer, .size = size, .data = data } });
+}
+
+void Device::transfer_to_buffers(const std::vector<BufferTransfer>& transfers)
+{
+    // Staging offsets are kept aligned for the copies
+    constexpr vk::DeviceSize stagingAlignment{ 16 };
+    std::vector<vk::DeviceSize> stagingOffsets(transfers.size());
+    vk::DeviceSize stagingSize{};
+    for (size_t i = 0; i < transfers.size(); ++i) {
+        // If the destination buffer is not device local, should probably use copy_data instead
+        EC_ASSERT(transfers[i].dstBuffer->m_bufferLocation
+                  & vk::MemoryPropertyFlagBits::eDeviceLocal);
+        EC_ASSERT(transfers[i].size <= transfers[i].dstBuffer->get_size());
+        if (transfers[i].size == 0) {
+            continue;  // Nothing to write or stage
+        }
+        // Mappable with UMA or resizable BAR, no staging or copy commands needed
+        if (transfers[i].dstBuffer->m_bufferLocation & vk::MemoryPropertyFlagBits::eHostVisible) {
+            transfers[i].dstBuffer->copy_data(0, transfers[i].size, transfers[i].data);
+            continue;
+        }
+        stagingOffsets[i] = stagingSize;
+        stagingSize       = (stagingSize + transfers[i].size + stagingAlignment - 1)
+                      & ~(stagingAlignment - 1);
+    }
+    if (stagingSize == 0) {
+        return;
+    }
 
     Buffer::Info stagingBufferInfo{
-        .count    = dstBuffer.get_count(),
-        .elemSize = dstBuffer.get_size() / dstBuffer.get_count(),
+        .count    = 1,
+        .elemSize = stagingSize,
         .usage    = vk::BufferUsageFlagBits::eTransferSrc,
         .memoryProperties
         = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
     };
     std::vector<uint32_t> queueFamilies = { static_cast<uint32_t>(m_queueFamilyIndices.transfer) };
     Buffer stagingBuffer(m_logicalDevice, m_memoryProperties, queueFamilies, stagingBufferInfo);
-    stagingBuffer.copy_data(0, size, data);
+    auto staged{ [&](size_t i) {
+        return transfers[i].size > 0
+               && !(transfers[i].dstBuffer->m_bufferLocation
+                    & vk::MemoryPropertyFlagBits::eHostVisible);
+    } };
+    stagingBuffer.map();
+    for (size_t i = 0; i < transfers.size(); ++i) {
+        if (staged(i)) {
+            stagingBuffer.copy_data(stagingOffsets[i], transfers[i].size, transfers[i].data);
+        }
+    }
+    stagingBuffer.unmap();
+
+    vk::CommandBuffer transferCommandBuffer{ begin_single_use_commands(m_transferCommandPool) };
+    for (size_t i = 0; i < transfers.size(); ++i) {
+        if (!staged(i)) {
+            continue;
+        }
+        vk::BufferCopy bufferCopyRegion{
+            .srcOffset = stagingOffsets[i],
+            .dstOffset = 0,
+            .size      = transfers[i].size,
+        };
+        transferCommandBuffer.copyBuffer(stagingBuffer.get_handle(),
+                                         transfers[i].dstBuffer->get_handle(),
+                                         1,
+                                         &bufferCopyRegion);
+    }
+    // Other transfers and frames on the graphics queue are not waited on
+    submit_single_use_commands(transferCommandBuffer,
+                               m_transferCommandPool,
+                               m_queues.transfer,
+                               m_transferTimeline);
+
+    stagingBuffer.free();
+}
+
+Image Device::create_texture(const ImageData& data)
+{
+    // e.g. ASTC on most desktop GPUs, or BC on mobile ones
+    auto formatFeatures{ m_physicalDevice.getFormatProperties(data.format).optimalTilingFeatures };
+    if (!(formatFeatures & vk::FormatFeatureFlagBits::eSampledImage)) {
+        throw std::runtime_error(
+            std::format("Format {} can't be sampled by the device", vk::to_string(data.format)));
+    }
+    // Read by the mip blits, or copied into a resized image (see ImageTransfer::srcImage)
+    vk::ImageUsageFlags usage{ vk::ImageUsageFlagBits::eSampled
+                               | vk::ImageUsageFlagBits::eTransferDst
+                               | vk::ImageUsageFlagBits::eTransferSrc };
+    if (data.levels.size() == data.mipLevels && m_enabledFeatures.hostImageCopy) {
+        auto formatProperties{
+            m_physicalDevice.getFormatProperties2<vk::FormatProperties2, vk::FormatProperties3>(
+                data.format)
+        };
+        if (formatProperties.get<vk::FormatProperties3>().optimalTilingFeatures
+            & vk::FormatFeatureFlagBits2::eHostImageTransferEXT) {
+            usage |= vk::ImageUsageFlagBits::eHostTransferEXT;  // See host_copy_to_images
+        }
+    }
+    Image::Info imageInfo{
+        .width                  = data.extent.width,
+        .height                 = data.extent.height,
+        .depth                  = data.extent.depth,
+        .mipLevels              = data.mipLevels,
+        .arrayLayers            = data.arrayLayers,
+        .type                   = data.type,
+        .format                 = data.format,
+        .usage                  = usage,
+        .samples                = vk::SampleCountFlagBits::e1,
+        .layout                 = vk::ImageLayout::eUndefined,
+        .memoryProperties       = vk::MemoryPropertyFlagBits::eDeviceLocal,
+        .deviceMemoryProperties = m_memoryProperties,
+    };
+    Image texture{ m_logicalDevice, imageInfo };
+    try {
+        texture.create_view(data.format, vk::ImageAspectFlagBits::eColor);
+    }
+    catch (const std::exception&) {
+        texture.free();
+        throw;
+    }
+    return texture;
+}
+
+void Device::transfer_to_images(const std::vector<ImageTransfer>& transfers)
+{
+    auto upload{ record_image_transfers(host_copy_to_images(transfers)) };
+    if (!upload) {
+        return;
+    }
+    submit_single_use_commands(upload->commandBuffer,
+                               m_graphicsCommandPool,
+                               m_queues.graphics,
+                               m_graphicsTimeline);
+    if (upload->stagingBuffer) {
+        upload->stagingBuffer->free();
+    }
+}
+
+uint64_t Device::transfer_to_images_async(const std::vector<ImageTransfer>& transfers)
+{
+    release_finished_uploads();
+    auto upload{ record_image_transfers(host_copy_to_images(transfers)) };
+    if (!upload) {
+        return 0;  // Nothing submitted, the timeline is always past it
+    }
+    upload->timelineValue = submit_commands(upload->commandBuffer,
+                                            m_queues.graphics,
+                                            m_graphicsTimeline);
+    m_pendingUploads.push_back(std::move(upload.value()));
+    return m_pendingUploads.back().timelineValue;
+}
+
+std::vector<ImageTransfer> Device::host_copy_to_images(const std::vector<ImageTransfer>& transfers)
+{
+    std::vector<ImageTransfer> remaining{};
+    for (const auto& transfer : transfers) {
+        const Image& image{ *transfer.dstImage };
+        const ImageData& data{ *transfer.data };
+        // Levels can't be generated or copied from another image by the host
+        if (transfer.srcImage || !(image.get_usage() & vk::ImageUsageFlagBits::eHostTransferEXT)
+            || data.levels.size() != image.get_mip_levels()
+            || std::ranges::find(m_hostImageCopyLayouts, transfer.finalLayout)
+                   == m_hostImageCopyLayouts.end()) {
+            remaining.push_back(transfer);
+            continue;
+        }
+
+        // Copied directly in the final layout, the previous contents are discarded
+        m_logicalDevice.transitionImageLayoutEXT(vk::HostImageLayoutTransitionInfoEXT{
+            .image     = image.get_image(),
+            .oldLayout = vk::ImageLayout::eUndefined,
+            .newLayout = transfer.finalLayout,
+            .subresourceRange{
+                              .aspectMask     = vk::ImageAspectFlagBits::eColor,
+                              .baseMipLevel   = 0,
+                              .levelCount     = image.get_mip_levels(),
+                              .baseArrayLayer = 0,
+                              .layerCount     = image.get_array_layers(),
+                              },
+        });
+        std::vector<vk::MemoryToImageCopyEXT> regions{};
+        for (uint32_t level = 0; level < data.levels.size(); ++level) {
+            regions.push_back(vk::MemoryToImageCopyEXT{
+                .pHostPointer      = data.levels[level].data(),
+                .memoryRowLength   = 0,  // Tightly packed
+                .memoryImageHeight = 0,
+                .imageSubresource{
+                                  .aspectMask     = vk::ImageAspectFlagBits::eColor,
+                                  .mipLevel       = level,
+                                  .baseArrayLayer = 0,
+                                  .layerCount     = data.arrayLayers,
+                                  },
+                .imageExtent = mip_level_extent(data.extent, level),
+            });
+        }
+        m_logicalDevice.copyMemoryToImageEXT(vk::CopyMemoryToImageInfoEXT{
+            .dstImage       = image.get_image(),
+            .dstImageLayout = transfer.finalLayout,
+            .regionCount    = static_cast<uint32_t>(regions.size()),
+            .pRegions       = regions.data(),
+        });
+    }
+    return remaining;
+}
+
+bool Device::is_transfer_complete(uint64_t transferValue)
+{
+    release_finished_uploads();
+    return m_graphicsTimeline.is_complete(transferValue);
+}
+
+MemoryBudget Device::get_memory_budget() const
+{
+    MemoryBudget memoryBudget{};
+    vk::PhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+    if (m_enabledFeatures.memoryBudget) {
+        budgetProperties = m_physicalDevice
+                               .getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2,
+                                                     vk::PhysicalDeviceMemoryBudgetPropertiesEXT>()
+                               .get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+    }
+    for (uint32_t i = 0; i < m_memoryProperties.memoryHeapCount; ++i) {
+        if (!(m_memoryProperties.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal)) {
+            continue;
+        }
+        if (m_enabledFeatures.memoryBudget) {
+            memoryBudget.budget += budgetProperties.heapBudget[i];
+            memoryBudget.usage += budgetProperties.heapUsage[i];
+        } else {
+            memoryBudget.budget += m_memoryProperties.memoryHeaps[i].size;
+        }
+    }
+    return memoryBudget;
+}
+
+std::optional<Device::PendingUpload> Device::record_image_transfers(
+    const std::vector<ImageTransfer>& transfers)
+{
+    // Copies read whole texel blocks, so offsets are aligned to the block size too
+    std::vector<std::vector<vk::DeviceSize>> stagingOffsets(transfers.size());
+    std::vector<std::optional<vk::Filter>> mipmapFilters(transfers.size());
+    vk::DeviceSize stagingSize{};
+    for (size_t i = 0; i < transfers.size(); ++i) {
+        const ImageData& data{ *transfers[i].data };
+        const Image& image{ *transfers[i].dstImage };
+        const Image* srcImage{ transfers[i].srcImage };
+        EC_ASSERT(data.format == image.get_format());
+        if (srcImage) {
+            EC_ASSERT(srcImage->get_format() == image.get_format()
+                      && srcImage->get_mip_levels() + data.levels.size() >= image.get_mip_levels()
+                      && data.levels.size() < image.get_mip_levels());
+        } else {
+            EC_ASSERT(data.levels.size() == 1 || data.levels.size() == image.get_mip_levels());
+        }
+        // Checked before recording, the missing levels are blitted from the first one
+        if (!srcImage && data.levels.size() < image.get_mip_levels()) {
+            mipmapFilters[i] = get_mipmap_filter(data.format);
+        }
+        vk::DeviceSize alignment{ std::lcm(vk::DeviceSize{ 16 },
+                                           vk::DeviceSize{ vk::blockSize(data.format) }) };
+        for (uint32_t level = 0; level < data.levels.size(); ++level) {
+            EC_ASSERT(data.levels[level].size()
+                      == image_level_size(data.format, data.extent, level, data.arrayLayers));
+            stagingSize = (stagingSize + alignment - 1) / alignment * alignment;
+            stagingOffsets[i].push_back(stagingSize);
+            stagingSize += data.levels[level].size();
+        }
+    }
+    if (transfers.empty()) {
+        return std::nullopt;
+    }
+
+    std::optional<Buffer> stagingBuffer{};
+    if (stagingSize > 0) {
+        Buffer::Info stagingBufferInfo{
+            .count    = 1,
+            .elemSize = stagingSize,
+            .usage    = vk::BufferUsageFlagBits::eTransferSrc,
+            .memoryProperties
+            = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+        };
+        std::vector<uint32_t> queueFamilies{ static_cast<uint32_t>(m_queueFamilyIndices.graphics) };
+        stagingBuffer.emplace(m_logicalDevice,
+                              m_memoryProperties,
+                              queueFamilies,
+                              stagingBufferInfo);
+        stagingBuffer->map();
+        for (size_t i = 0; i < transfers.size(); ++i) {
+            const auto& levels{ transfers[i].data->levels };
+            for (size_t level = 0; level < levels.size(); ++level) {
+                stagingBuffer->copy_data(stagingOffsets[i][level],
+                                         levels[level].size(),
+                                         levels[level].data());
+            }
+        }
+        stagingBuffer->unmap();
+    }
+
+    vk::CommandBuffer commandBuffer{ begin_single_use_commands(m_graphicsCommandPool) };
+    auto levelRange{ [](const Image& image, uint32_t levelCount) {
+        return vk::ImageSubresourceRange{
+            .aspectMask     = vk::ImageAspectFlagBits::eColor,
+            .baseMipLevel   = 0,
+            .levelCount     = levelCount,
+            .baseArrayLayer = 0,
+            .layerCount     = image.get_array_layers(),
+        };
+    } };
+
+    // The previous contents are discarded, the source images are read in between their uses
+    std::vector<vk::ImageMemoryBarrier2> barriers{};
+    for (size_t i = 0; i < transfers.size(); ++i) {
+        const Image& image{ *transfers[i].dstImage };
+        barriers.push_back(layout_transition_barrier(image.get_image(),
+                                                     vk::ImageLayout::eUndefined,
+                                                     vk::ImageLayout::eTransferDstOptimal,
+                                                     levelRange(image, image.get_mip_levels())));
+        if (const Image* srcImage{ transfers[i].srcImage }) {
+            barriers.push_back(
+                layout_transition_barrier(srcImage->get_image(),
+                                          transfers[i].finalLayout,
+                                          vk::ImageLayout::eTransferSrcOptimal,
+                                          levelRange(*srcImage, srcImage->get_mip_levels())));
+        }
+    }
+    commandBuffer.pipelineBarrier2(vk::DependencyInfo{
+        .imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size()),
+        .pImageMemoryBarriers    = barriers.data(),
+    });
+
+    for (size_t i = 0; i < transfers.size(); ++i) {
+        const ImageData& data{ *transfers[i].data };
+        const Image& image{ *transfers[i].dstImage };
+        if (const Image* srcImage{ transfers[i].srcImage }) {
+            // Both images end with the smallest level. Negative when growing, the levels the
+            // source lacks are staged from data
+            auto levelOffset{ static_cast<int32_t>(srcImage->get_mip_levels())
+                              - static_cast<int32_t>(image.get_mip_levels()) };
+            std::vector<vk::ImageCopy2> regions{};
+            for (auto level = static_cast<uint32_t>(data.levels.size());
+                 level < image.get_mip_levels();
+                 ++level) {
+                int32_t srcLevel{ static_cast<int32_t>(level) + levelOffset };
+                EC_ASSERT(srcLevel >= 0);
+                regions.push_back(vk::ImageCopy2{
+                    .srcSubresource{
+                                    .aspectMask     = vk::ImageAspectFlagBits::eColor,
+                                    .mipLevel       = static_cast<uint32_t>(srcLevel),
+                                    .baseArrayLayer = 0,
+                                    .layerCount     = data.arrayLayers,
+                                    },
+                    .dstSubresource{
+                                    .aspectMask     = vk::ImageAspectFlagBits::eColor,
+                                    .mipLevel       = level,
+                                    .baseArrayLayer = 0,
+                                    .layerCount     = data.arrayLayers,
+                                    },
+                    .extent = mip_level_extent(data.extent, level),
+                });
+            }
+            commandBuffer.copyImage2(vk::CopyImageInfo2{
+                .srcImage       = srcImage->get_image(),
+                .srcImageLayout = vk::ImageLayout::eTransferSrcOptimal,
+                .dstImage       = image.get_image(),
+                .dstImageLayout = vk::ImageLayout::eTransferDstOptimal,
+                .regionCount    = static_cast<uint32_t>(regions.size()),
+                .pRegions       = regions.data(),
+            });
+        }
+        if (data.levels.empty()) {
+            continue;
+        }
+        std::vector<vk::BufferImageCopy2> regions{};
+        for (uint32_t level = 0; level < data.levels.size(); ++level) {
+            regions.push_back(vk::BufferImageCopy2{
+                .bufferOffset      = stagingOffsets[i][level],
+                .bufferRowLength   = 0,  // Tightly packed
+                .bufferImageHeight = 0,
+                .imageSubresource{
+                                  .aspectMask     = vk::ImageAspectFlagBits::eColor,
+                                  .mipLevel       = level,
+                                  .baseArrayLayer = 0,
+                                  .layerCount     = data.arrayLayers,
+                                  },
+                .imageExtent = mip_level_extent(data.extent, level),
+            });
+        }
+        commandBuffer.copyBufferToImage2(vk::CopyBufferToImageInfo2{
+            .srcBuffer      = stagingBuffer->get_handle(),
+            .dstImage       = image.get_image(),
+            .dstImageLayout = vk::ImageLayout::eTransferDstOptimal,
+            .regionCount    = static_cast<uint32_t>(regions.size()),
+            .pRegions       = regions.data(),
+        });
+    }
+
+    barriers.clear();
+    for (size_t i = 0; i < transfers.size(); ++i) {
+        const Image& image{ *transfers[i].dstImage };
+        vk::ImageLayout finalLayout{ transfers[i].finalLayout };
+        if (const Image* srcImage{ transfers[i].srcImage }) {
+            barriers.push_back(
+                layout_transition_barrier(srcImage->get_image(),
+                                          vk::ImageLayout::eTransferSrcOptimal,
+                                          finalLayout,
+                                          levelRange(*srcImage, srcImage->get_mip_levels())));
+        }
+        if (mipmapFilters[i]) {
+            image.record_mipmap_generation(commandBuffer,
+                                           vk::ImageLayout::eTransferDstOptimal,
+                                           finalLayout,
+                                           mipmapFilters[i].value());
+        } else {
+            auto range{ levelRange(image, image.get_mip_levels()) };
+            barriers.push_back(layout_transition_barrier(image.get_image(),
+                                                         vk::ImageLayout::eTransferDstOptimal,
+                                                         finalLayout,
+                                                         range));
+        }
+    }
+    if (!barriers.empty()) {
+        commandBuffer.pipelineBarrier2(vk::DependencyInfo{
+            .imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size()),
+            .pImageMemoryBarriers    = barriers.data(),
+        });
+    }
+    return PendingUpload{
+        .commandBuffer = commandBuffer,
+        .stagingBuffer = std::move(stagingBuffer),
+    };
+}
 
-    // TODO: Move all this into a function
+void Device::release_finished_uploads()
+{
+    while (!m_pendingUploads.empty()
+           && m_graphicsTimeline.is_complete(m_pendingUploads.front().timelineValue)) {
+        auto& upload{ m_pendingUploads.front() };
+        m_logicalDevice.freeCommandBuffers(m_graphicsCommandPool, 1, &upload.commandBuffer);
+        if (upload.stagingBuffer) {
+            upload.stagingBuffer->free();
+        }
+        m_pendingUploads.pop_front();
+    }
+}
+
+vk::CommandBuffer Device::begin_single_use_commands(vk::CommandPool commandPool)
+{
     vk::CommandBufferAllocateInfo allocateInfo{
-        .commandPool        = m_transferCommandPool,
+        .commandPool        = commandPool,
         .level              = vk::CommandBufferLevel::ePrimary,
         .commandBufferCount = 1,
     };
-    vk::CommandBuffer transferCommandBuffer{ m_logicalDevice.allocateCommandBuffers(
-        allocateInfo)[0] };
+    vk::CommandBuffer commandBuffer{ m_logicalDevice.allocateCommandBuffers(allocateInfo)[0] };
 
     vk::CommandBufferBeginInfo beginInfo{
         .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
     };
-    transferCommandBuffer.begin(beginInfo);
-
-    vk::BufferCopy bufferCopyRegion{
-        .srcOffset = 0,
-        .dstOffset = 0,
-        .size      = size,
-    };
-    transferCommandBuffer.copyBuffer(stagingBuffer.get_handle(),
-                                     dstBuffer.get_handle(),
-                                     1,
-                                     &bufferCopyRegion);
+    commandBuffer.begin(beginInfo);
+    return commandBuffer;
+}
 
-    transferCommandBuffer.end();
-    vk::SubmitInfo submitInfo{
-        .commandBufferCount = 1,
-        .pCommandBuffers    = &transferCommandBuffer,
+uint64_t Device::submit_commands(vk::CommandBuffer commandBuffer,
+                                 vk::Queue queue,
+                                 QueueTimeline& timeline)
+{
+    commandBuffer.end();
+    vk::CommandBufferSubmitInfo commandBufferInfo{
+        .commandBuffer = commandBuffer,
     };
-    m_queues.transfer.submit(submitInfo);
+    uint64_t timelineValue{ timeline.next_value() };
+    vk::SemaphoreSubmitInfo signalInfo{ timeline.signal_info(timelineValue) };
+    queue.submit2(vk::SubmitInfo2{
+        .commandBufferInfoCount   = 1,
+        .pCommandBufferInfos      = &commandBufferInfo,
+        .signalSemaphoreInfoCount = 1,
+        .pSignalSemaphoreInfos    = &signalInfo,
+    });
+    return timelineValue;
+}
 
-    m_queues.transfer.waitIdle();  // TODO: Remove this and use a semaphore
+void Device::submit_single_use_commands(vk::CommandBuffer commandBuffer,
+                                        vk::CommandPool commandPool,
+                                        vk::Queue queue,
+                                        QueueTimeline& timeline)
+{
+    timeline.wait(submit_commands(commandBuffer, queue, timeline));
+    m_logicalDevice.freeCommandBuffers(commandPool, 1, &commandBuffer);
+}
 
-    m_logicalDevice.freeCommandBuffers(m_transferCommandPool, 1, &transferCommandBuffer);
-    stagingBuffer.free();
+vk::Filter Device::get_mipmap_filter(vk::Format format)
+{
+    // Block compressed formats are never blit destinations, their mips must come from the file
+    auto formatFeatures{ m_physicalDevice.getFormatProperties(format).optimalTilingFeatures };
+    if (!(formatFeatures & vk::FormatFeatureFlagBits::eBlitSrc)
+        || !(formatFeatures & vk::FormatFeatureFlagBits::eBlitDst)) {
+        throw std::runtime_error(
+            std::format("Format {} does not support blits for mipmapping", vk::to_string(format)));
+    }
+    return formatFeatures & vk::FormatFeatureFlagBits::eSampledImageFilterLinear
+               ? vk::Filter::eLinear
+               : vk::Filter::eNearest;
 }
 
 void Device::obtain_physical_device(const std::vector<vk::PhysicalDevice>& physDevices)
@@ -129,9 +618,15 @@ void Device::obtain_physical_device(const std::vector<vk::PhysicalDevice>& physD
 
     m_physicalDevice   = *selPhysDevice;
     m_memoryProperties = m_physicalDevice.getMemoryProperties();
+    m_limits           = m_physicalDevice.getProperties().limits;
+    m_directUploads    = device_memory_is_host_visible(m_memoryProperties);
+    if (m_directUploads) {
+        EC_LOG_DEBUG("Device local memory is host visible, uploads skip staging where possible");
+    }
 }
 
-void Device::create_device(const std::vector<const char*>& extToEnable)
+void Device::create_device(const std::vector<const char*>& extToEnable,
+                           bool shaderObjectsRequested)
 {
     std::set<int> uniqueQueueFamilyIndices{
         m_queueFamilyIndices.graphics,
@@ -156,11 +651,143 @@ void Device::create_device(const std::vector<const char*>& extToEnable)
     // Hard-coded extensions here
     std::vector<const char*> extensions{ extToEnable };
 
-    vk::PhysicalDeviceSynchronization2Features sync2Features{
+    auto supportedFeatures{ m_physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2,
+                                                          vk::PhysicalDeviceVulkan12Features,
+                                                          vk::PhysicalDeviceVulkan13Features>() };
+    const auto& supportedVk12Features{ supportedFeatures.get<vk::PhysicalDeviceVulkan12Features>() };
+    const auto& supportedVk13Features{ supportedFeatures.get<vk::PhysicalDeviceVulkan13Features>() };
+    m_enabledFeatures.bufferDeviceAddress = supportedVk12Features.bufferDeviceAddress;
+    m_enabledFeatures.dynamicRendering    = supportedVk13Features.dynamicRendering;
+    // Extended dynamic state commands are core since Vulkan 1.3
+    m_enabledFeatures.extendedDynamicState
+        = m_physicalDevice.getProperties().apiVersion >= VK_API_VERSION_1_3;
+
+    // Only queried, it has no features to enable
+    if (device_supports_extensions(m_physicalDevice, { VK_EXT_MEMORY_BUDGET_EXTENSION_NAME })) {
+        m_enabledFeatures.memoryBudget = true;
+        extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+
+    // Feature structs of the enabled extensions only, chained in front of the core ones
+    void* extensionFeatures{};
+    auto chain_features{ [&](auto& features)
+                         {
+                             features.pNext    = extensionFeatures;
+                             extensionFeatures = &features;
+                         } };
+
+    // Shader objects (only with dynamic rendering, all state is dynamic)
+    vk::PhysicalDeviceShaderObjectFeaturesEXT shaderObjectFeatures{
+        .shaderObject = VK_FALSE,
+    };
+    if (shaderObjectsRequested && m_enabledFeatures.dynamicRendering
+        && m_enabledFeatures.extendedDynamicState
+        && device_supports_extensions(m_physicalDevice, { VK_EXT_SHADER_OBJECT_EXTENSION_NAME })) {
+        auto shaderObjectSupport{ m_physicalDevice.getFeatures2<
+            vk::PhysicalDeviceFeatures2,
+            vk::PhysicalDeviceShaderObjectFeaturesEXT>() };
+        m_enabledFeatures.shaderObject
+            = shaderObjectSupport.get<vk::PhysicalDeviceShaderObjectFeaturesEXT>().shaderObject;
+    }
+    if (m_enabledFeatures.shaderObject) {
+        extensions.push_back(VK_EXT_SHADER_OBJECT_EXTENSION_NAME);
+        shaderObjectFeatures.shaderObject = VK_TRUE;
+        chain_features(shaderObjectFeatures);
+    } else if (shaderObjectsRequested) {
+        EC_LOG_WARN("Shader objects requested but not supported, falling back to pipelines");
+    }
+
+    // Graphics pipeline library (VK_KHR_pipeline_library is a dependency). Unused with shader
+    // objects, since no pipelines are created
+    std::vector<const char*> pipelineLibraryExtensions{
+        VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME,
+        VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME,
+    };
+    vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipelineLibraryFeatures{
+        .graphicsPipelineLibrary = VK_FALSE,
+    };
+    if (!m_enabledFeatures.shaderObject
+        && device_supports_extensions(m_physicalDevice, pipelineLibraryExtensions)) {
+        auto pipelineLibrarySupport{ m_physicalDevice.getFeatures2<
+            vk::PhysicalDeviceFeatures2,
+            vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>() };
+        m_enabledFeatures.graphicsPipelineLibrary
+            = pipelineLibrarySupport.get<vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>()
+                  .graphicsPipelineLibrary;
+    }
+    if (m_enabledFeatures.graphicsPipelineLibrary) {
+        extensions.insert(extensions.end(),
+                          pipelineLibraryExtensions.begin(),
+                          pipelineLibraryExtensions.end());
+        pipelineLibraryFeatures.graphicsPipelineLibrary = VK_TRUE;
+        chain_features(pipelineLibraryFeatures);
+
+        auto pipelineLibraryProperties{ m_physicalDevice.getProperties2<
+            vk::PhysicalDeviceProperties2,
+            vk::PhysicalDeviceGraphicsPipelineLibraryPropertiesEXT>() };
+        if (!pipelineLibraryProperties.get<vk::PhysicalDeviceGraphicsPipelineLibraryPropertiesEXT>()
+                 .graphicsPipelineLibraryFastLinking) {
+            EC_LOG_WARN("Graphics pipeline library linking is not fast in this device!");
+        }
+    }
+
+    // Images written by the host on UMA devices, without staging
+    vk::PhysicalDeviceHostImageCopyFeaturesEXT hostImageCopyFeatures{
+        .hostImageCopy = VK_FALSE,
+    };
+    if (m_directUploads
+        && device_supports_extensions(m_physicalDevice,
+                                      { VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME })) {
+        auto hostImageCopySupport{ m_physicalDevice.getFeatures2<
+            vk::PhysicalDeviceFeatures2,
+            vk::PhysicalDeviceHostImageCopyFeaturesEXT>() };
+        m_enabledFeatures.hostImageCopy
+            = hostImageCopySupport.get<vk::PhysicalDeviceHostImageCopyFeaturesEXT>().hostImageCopy;
+    }
+    if (m_enabledFeatures.hostImageCopy) {
+        extensions.push_back(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME);
+        hostImageCopyFeatures.hostImageCopy = VK_TRUE;
+        chain_features(hostImageCopyFeatures);
+        // Layouts images can be in while copied to, queried twice for their count first
+        vk::PhysicalDeviceHostImageCopyPropertiesEXT hostImageCopyProperties{};
+        vk::PhysicalDeviceProperties2 properties{ .pNext = &hostImageCopyProperties };
+        m_physicalDevice.getProperties2(&properties);
+        m_hostImageCopyLayouts.resize(hostImageCopyProperties.copyDstLayoutCount);
+        hostImageCopyProperties.pCopyDstLayouts = m_hostImageCopyLayouts.data();
+        m_physicalDevice.getProperties2(&properties);
+    }
+
+    // 8-bit indices for small meshes
+    vk::PhysicalDeviceIndexTypeUint8FeaturesEXT indexTypeUint8Features{
+        .indexTypeUint8 = VK_FALSE,
+    };
+    if (device_supports_extensions(m_physicalDevice, { VK_EXT_INDEX_TYPE_UINT8_EXTENSION_NAME })) {
+        auto indexTypeUint8Support{ m_physicalDevice.getFeatures2<
+            vk::PhysicalDeviceFeatures2,
+            vk::PhysicalDeviceIndexTypeUint8FeaturesEXT>() };
+        m_enabledFeatures.indexTypeUint8
+            = indexTypeUint8Support.get<vk::PhysicalDeviceIndexTypeUint8FeaturesEXT>()
+                  .indexTypeUint8;
+    }
+    if (m_enabledFeatures.indexTypeUint8) {
+        extensions.push_back(VK_EXT_INDEX_TYPE_UINT8_EXTENSION_NAME);
+        indexTypeUint8Features.indexTypeUint8 = VK_TRUE;
+        chain_features(indexTypeUint8Features);
+    }
+
+    vk::PhysicalDeviceVulkan13Features vk13Features{
+        .pNext            = extensionFeatures,
         .synchronization2 = true,
+        .dynamicRendering = m_enabledFeatures.dynamicRendering,
+    };
+
+    vk::PhysicalDeviceVulkan12Features vk12Features{
+        .pNext               = &vk13Features,
+        .timelineSemaphore   = true,
+        .bufferDeviceAddress = m_enabledFeatures.bufferDeviceAddress,
     };
 
-    vk::DeviceCreateInfo deviceCreateInfo{ .pNext = &sync2Features,
+    vk::DeviceCreateInfo deviceCreateInfo{ .pNext = &vk12Features,
                                            .queueCreateInfoCount
                                            = static_cast<uint32_t>(queueCreateInfos.size()),
                                            .pQueueCreateInfos = queueCreateInfos.data(),
@@ -176,26 +803,33 @@ void Device::create_device(const std::vector<const char*>& extToEnable)
     m_queues.transfer = m_logicalDevice.getQueue(m_queueFamilyIndices.transfer, 0);
 }
 
-void Device::create_swapchain(std::tuple<int, int> framebufferSize, bool verticalSyncEnabled)
+void Device::create_swapchain(std::tuple<int, int> framebufferSize,
+                              bool verticalSyncEnabled,
+                              uint32_t imageCount)
 {
     Swapchain::Info swapchainInfo{
-        .physDevice      = m_physicalDevice,
-        .device          = m_logicalDevice,
-        .surface         = *m_surface,
-        .framebufferSize = framebufferSize,
-        .verticalSync    = verticalSyncEnabled,
+        .physDevice         = m_physicalDevice,
+        .device             = m_logicalDevice,
+        .surface            = *m_surface,
+        .framebufferSize    = framebufferSize,
+        .verticalSync       = verticalSyncEnabled,
+        .imageCount         = imageCount,
+        .minOffscreenImages = GraphicsContext::MAX_RENDERING_FRAMES,
     };
 
     m_swapchain = Swapchain(swapchainInfo);
 }
 
-void Device::create_transfer_command_pool()
+void Device::create_command_pools()
 {
     vk::CommandPoolCreateInfo commandPoolCreateInfo{
         .flags            = vk::CommandPoolCreateFlagBits::eTransient,
         .queueFamilyIndex = static_cast<uint32_t>(m_queueFamilyIndices.transfer),
     };
     m_transferCommandPool = m_logicalDevice.createCommandPool(commandPoolCreateInfo);
+
+    commandPoolCreateInfo.queueFamilyIndex = static_cast<uint32_t>(m_queueFamilyIndices.graphics);
+    m_graphicsCommandPool = m_logicalDevice.createCommandPool(commandPoolCreateInfo);
 }
 
 bool Device::physical_device_meets_requirements(const vk::PhysicalDevice& physDevice)
@@ -204,7 +838,7 @@ bool Device::physical_device_meets_requirements(const vk::PhysicalDevice& physDe
     // auto physDeviceFeatures{ physDevice.getFeatures() };
 
     std::vector<const char*> extToEnable{ VK_KHR_SWAPCHAIN_EXTENSION_NAME };
-    if (!device_supports_extensions(physDevice, extToEnable)) {
+    if (*m_surface && !device_supports_extensions(physDevice, extToEnable)) {
         return false;
     }
 
@@ -232,8 +866,10 @@ QueueFamilyIndices Device::obtain_queue_family_indices(vk::PhysicalDevice physDe
             queueFamilyIndices.graphics = i;
         }
 
-        auto surfaceSupport = physDevice.getSurfaceSupportKHR(static_cast<uint32_t>(i), *m_surface);
-        if (surfaceSupport) {
+        if (!*m_surface) {
+            // Headless, nothing is presented. Set to the graphics queue to share its checks
+            queueFamilyIndices.present = queueFamilyIndices.graphics;
+        } else if (physDevice.getSurfaceSupportKHR(static_cast<uint32_t>(i), *m_surface)) {
             queueFamilyIndices.present = i;
         }
 
@@ -280,4 +916,25 @@ bool device_supports_extensions(vk::PhysicalDevice physDevice,
     return contains_all_names(devExtNames, requiredExtNames);
 }
 
+bool device_memory_is_host_visible(const vk::PhysicalDeviceMemoryProperties& memoryProperties)
+{
+    vk::DeviceSize largestHeapSize{};
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i) {
+        if (memoryProperties.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal) {
+            largestHeapSize = std::max(largestHeapSize, memoryProperties.memoryHeaps[i].size);
+        }
+    }
+    constexpr vk::MemoryPropertyFlags directFlags{ vk::MemoryPropertyFlagBits::eDeviceLocal
+                                                   | vk::MemoryPropertyFlagBits::eHostVisible
+                                                   | vk::MemoryPropertyFlagBits::eHostCoherent };
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+        const auto& memoryType{ memoryProperties.memoryTypes[i] };
+        if ((memoryType.propertyFlags & directFlags) == directFlags
+            && memoryProperties.memoryHeaps[memoryType.heapIndex].size == largestHeapSize) {
+            return true;
+        }
+    }
+    return false;
+}
+
 }  // namespace ec::vulkan
@@ -4,6 +4,10 @@
 #include "swapchain.hpp"
 #include "graphics_context.hpp"
 #include "buffer.hpp"
+#include "image.hpp"
+#include "queue_timeline.hpp"
+
+#include <deque>
 
 namespace ec::vulkan
 {
@@ -16,6 +20,30 @@ struct QueueFamilyIndices {
     bool all_valid() { return graphics >= 0 && present >= 0 && transfer >= 0; }
 };
 
+// Copy of host data to the beginning of a device local buffer
+struct BufferTransfer {
+    Buffer* dstBuffer;
+    vk::DeviceSize size;
+    const void* data;
+};
+
+// Copy of host pixels to every level of an image created for them (see Device::create_texture)
+struct ImageTransfer {
+    Image* dstImage;
+    const ImageData* data;
+    vk::ImageLayout finalLayout{ vk::ImageLayout::eShaderReadOnlyOptimal };
+    // If set, the levels after the ones in data are copied from the smallest levels of this
+    // image instead of generated. It is in finalLayout, and is left in it
+    const Image* srcImage{};
+};
+
+// Of the device local heaps, in bytes. Usage counts every process and is 0 without
+// VK_EXT_memory_budget, then the budget is the size of the heaps
+struct MemoryBudget {
+    vk::DeviceSize budget{};
+    vk::DeviceSize usage{};
+};
+
 class Device
 {
 public:
@@ -23,9 +51,12 @@ public:
     struct Info {
         const std::vector<vk::PhysicalDevice>& availablePhysicalDevices;
         const std::vector<const char*>& extensionsToEnable;
-        vk::SurfaceKHR surface;
+        vk::SurfaceKHR surface;  // Null for headless rendering, without present queue
         std::tuple<int, int> framebufferSize;
         bool verticalSync;
+        uint32_t swapchainImages;
+        bool shaderObjects;  // Use VK_EXT_shader_object instead of pipelines if supported
+        bool recordAhead;    // Passed on to the graphics context
     };
 
     Device() = default;
@@ -43,18 +74,72 @@ public:
     const vk::Format get_swapchain_image_format() const { return m_swapchain.get_format(); }
     const vk::Extent2D get_swapchain_extent() const { return m_swapchain.get_extent(); }
 
+    // The swapchain is recreated by the graphics context at the beginning of the next frame
+    void set_framebuffer_size(std::tuple<int, int> framebufferSize)
+    {
+        m_swapchain.set_framebuffer_size(framebufferSize);
+    }
+
     GraphicsContext& create_graphics_context();
     Buffer create_buffer(const Buffer::Info& info);
-
-    void transfer_to_buffer(Buffer& dstBuffer, vk::DeviceSize size, void* data);
+    // The buffer must not be in use by the GPU
+    void free_buffer(Buffer& buffer) { buffer.free(); }
+
+    void transfer_to_buffer(Buffer& dstBuffer, vk::DeviceSize size, const void* data);
+    // All the copies go through one staging buffer and a single submission
+    void transfer_to_buffers(const std::vector<BufferTransfer>& transfers);
+
+    // Device local sampled image with a view, sized and formatted for the data. It is undefined
+    // until transferred
+    Image create_texture(const ImageData& data);
+    // The image must not be in use by the GPU
+    void free_image(Image& image) { image.free(); }
+    // Like transfer_to_buffers, but on the graphics queue. It owns the images afterwards without
+    // ownership transfers, and can also blit the missing mip levels
+    void transfer_to_images(const std::vector<ImageTransfer>& transfers);
+    // Returns right after submitting, with the value to check for completion. Later submissions
+    // to the graphics queue can already use the images
+    uint64_t transfer_to_images_async(const std::vector<ImageTransfer>& transfers);
+    // Also releases the staging memory of the finished asynchronous transfers
+    bool is_transfer_complete(uint64_t transferValue);
+
+    MemoryBudget get_memory_budget() const;
+    // vk::IndexType::eUint8EXT can be used
+    bool supports_uint8_indices() const { return m_enabledFeatures.indexTypeUint8; }
 
 private:
 
     void obtain_physical_device(const std::vector<vk::PhysicalDevice>& physDevices);
-    void create_device(const std::vector<const char*>& extToEnable);
-    void create_swapchain(std::tuple<int, int> framebufferSize, bool verticalSyncEnabled);
-
-    void create_transfer_command_pool();
+    void create_device(const std::vector<const char*>& extToEnable, bool shaderObjectsRequested);
+    void create_swapchain(std::tuple<int, int> framebufferSize,
+                          bool verticalSyncEnabled,
+                          uint32_t imageCount);
+
+    void create_command_pools();
+    // Throws if the format can't be blitted
+    vk::Filter get_mipmap_filter(vk::Format format);
+
+    // Image transfers recorded on the graphics queue, with their staging memory
+    struct PendingUpload {
+        vk::CommandBuffer commandBuffer;
+        std::optional<Buffer> stagingBuffer;  // Nothing if every level is copied on the GPU
+        uint64_t timelineValue{};
+    };
+    // Nothing if there is nothing to copy
+    std::optional<PendingUpload> record_image_transfers(const std::vector<ImageTransfer>& transfers);
+    // Copies with VK_EXT_host_image_copy what it can, returns the transfers left for the GPU
+    std::vector<ImageTransfer> host_copy_to_images(const std::vector<ImageTransfer>& transfers);
+    void release_finished_uploads();
+
+    // One-off command buffers, submitted on their own and waited on before returning
+    vk::CommandBuffer begin_single_use_commands(vk::CommandPool commandPool);
+    uint64_t submit_commands(vk::CommandBuffer commandBuffer,
+                             vk::Queue queue,
+                             QueueTimeline& timeline);
+    void submit_single_use_commands(vk::CommandBuffer commandBuffer,
+                                    vk::CommandPool commandPool,
+                                    vk::Queue queue,
+                                    QueueTimeline& timeline);
 
     bool physical_device_meets_requirements(const vk::PhysicalDevice& physDevice);
     QueueFamilyIndices obtain_queue_family_indices(vk::PhysicalDevice physDevice);
@@ -63,6 +148,22 @@ private:
 
     vk::PhysicalDevice m_physicalDevice;
     vk::PhysicalDeviceMemoryProperties m_memoryProperties;
+    vk::PhysicalDeviceLimits m_limits;
+
+    // Optional features, enabled if supported
+    struct {
+        bool bufferDeviceAddress{};
+        bool extendedDynamicState{};
+        bool dynamicRendering{};
+        bool graphicsPipelineLibrary{};
+        bool shaderObject{};  // Only if requested, replaces pipelines entirely
+        bool memoryBudget{};
+        bool hostImageCopy{};  // Only with direct uploads
+        bool indexTypeUint8{};
+    } m_enabledFeatures;
+    // All device local memory is host visible (UMA or resizable BAR), so uploads write it directly
+    bool m_directUploads{};
+    std::vector<vk::ImageLayout> m_hostImageCopyLayouts{};
 
     vk::Device m_logicalDevice;
 
@@ -77,6 +178,12 @@ private:
     Swapchain m_swapchain;
 
     vk::CommandPool m_transferCommandPool;
+    bool m_recordAhead{};
+    QueueTimeline m_transferTimeline{};
+    // Uploads that need graphics capabilities, like blits
+    vk::CommandPool m_graphicsCommandPool;
+    QueueTimeline m_graphicsTimeline{};
+    std::deque<PendingUpload> m_pendingUploads{};  // In submission order
 
     // For now just one to test
     std::optional<GraphicsContext> m_graphicsContext{};
@@ -85,5 +192,8 @@ private:
 // Support functions not bound to Device
 bool device_supports_extensions(vk::PhysicalDevice physDevice,
                                 const std::vector<const char*>& requiredExtNames);
+// The largest device local heap has host visible and coherent memory, true on UMA and with
+// resizable BAR but not with a small BAR window
+bool device_memory_is_host_visible(const vk::PhysicalDeviceMemoryProperties& memoryProperties);
 
 }  // namespace ec::vulkan
@@ -0,0 +1,165 @@
+#include "pch.hpp"
+#include "frame_readback.hpp"
+#include "utils.hpp"
+
+namespace ec::vulkan
+{
+
+static bool has_memory_type(const vk::PhysicalDeviceMemoryProperties& deviceMemoryProperties,
+                            vk::MemoryPropertyFlags memoryProperties)
+{
+    for (uint32_t i = 0; i < deviceMemoryProperties.memoryTypeCount; ++i) {
+        if ((deviceMemoryProperties.memoryTypes[i].propertyFlags & memoryProperties)
+            == memoryProperties) {
+            return true;
+        }
+    }
+    return false;
+}
+
+FrameReadback::FrameReadback(const FrameReadback::Info& info) :
+  m_device{ info.device },
+  m_deviceMemoryProperties{ &info.deviceMemoryProperties },
+  m_queueFamilyIndex{ info.queueFamilyIndex },
+  m_slots(info.numFrames)
+{
+    // The CPU reads every byte, which is very slow from uncached memory
+    m_memoryProperties = vk::MemoryPropertyFlagBits::eHostVisible
+                         | vk::MemoryPropertyFlagBits::eHostCoherent
+                         | vk::MemoryPropertyFlagBits::eHostCached;
+    if (!has_memory_type(info.deviceMemoryProperties, m_memoryProperties)) {
+        m_memoryProperties &= ~vk::MemoryPropertyFlags(vk::MemoryPropertyFlagBits::eHostCached);
+    }
+}
+
+void FrameReadback::free()
+{
+    for (auto& slot : m_slots) {
+        if (slot.buffer) {
+            slot.buffer->free();
+            slot.buffer.reset();
+        }
+        slot.pending = false;
+    }
+}
+
+void FrameReadback::record_copy(vk::CommandBuffer commandBuffer,
+                                vk::Image image,
+                                vk::ImageLayout layout,
+                                vk::Extent2D extent,
+                                vk::Format format,
+                                uint32_t frameIndex,
+                                uint64_t frameNumber)
+{
+    auto& slot{ m_slots[frameIndex] };
+    EC_ASSERT(!slot.pending);
+
+    // The slot's frame is done, so the buffer can be replaced right away
+    vk::DeviceSize size{ static_cast<vk::DeviceSize>(extent.width) * extent.height * 4 };
+    if (!slot.buffer || slot.buffer->get_size() < size) {
+        if (slot.buffer) {
+            slot.buffer->free();
+        }
+        slot.buffer.emplace(Buffer{ m_device,
+                                    *m_deviceMemoryProperties,
+                                    { m_queueFamilyIndex },
+                                    Buffer::Info{
+                                        .count            = 1,
+                                        .elemSize         = size,
+                                        .usage            = vk::BufferUsageFlagBits::eTransferDst,
+                                        .memoryProperties = m_memoryProperties,
+                                    } });
+        slot.data = static_cast<const std::byte*>(slot.buffer->map());
+    }
+
+    vk::ImageSubresourceRange colorRange{
+        .aspectMask = vk::ImageAspectFlagBits::eColor,
+        .levelCount = 1,
+        .layerCount = 1,
+    };
+    // Even without a layout change, render passes may not make the writes visible to transfers
+    bool needsTransition{ layout != vk::ImageLayout::eTransferSrcOptimal };
+    vk::ImageMemoryBarrier2 toTransfer{
+        .srcStageMask        = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+        .srcAccessMask       = vk::AccessFlagBits2::eColorAttachmentWrite,
+        .dstStageMask        = vk::PipelineStageFlagBits2::eCopy,
+        .dstAccessMask       = vk::AccessFlagBits2::eTransferRead,
+        .oldLayout           = layout,
+        .newLayout           = vk::ImageLayout::eTransferSrcOptimal,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image               = image,
+        .subresourceRange    = colorRange,
+    };
+    commandBuffer.pipelineBarrier2(vk::DependencyInfo{
+        .imageMemoryBarrierCount = 1,
+        .pImageMemoryBarriers    = &toTransfer,
+    });
+
+    vk::BufferImageCopy region{
+        .bufferOffset      = 0,
+        .bufferRowLength   = 0,  // Tightly packed
+        .bufferImageHeight = 0,
+        .imageSubresource{
+                          .aspectMask     = vk::ImageAspectFlagBits::eColor,
+                          .mipLevel       = 0,
+                          .baseArrayLayer = 0,
+                          .layerCount     = 1,
+                          },
+        .imageExtent = { extent.width, extent.height, 1 },
+    };
+    commandBuffer.copyImageToBuffer(image,
+                                    vk::ImageLayout::eTransferSrcOptimal,
+                                    slot.buffer->get_handle(),
+                                    region);
+
+    // Make the copy visible to the host once the frame timeline value is signaled
+    vk::BufferMemoryBarrier2 toHost{
+        .srcStageMask  = vk::PipelineStageFlagBits2::eCopy,
+        .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+        .dstStageMask  = vk::PipelineStageFlagBits2::eHost,
+        .dstAccessMask = vk::AccessFlagBits2::eHostRead,
+        .buffer        = slot.buffer->get_handle(),
+        .offset        = 0,
+        .size          = size,
+    };
+    vk::ImageMemoryBarrier2 fromTransfer{};
+    if (needsTransition) {
+        fromTransfer = layout_transition_barrier(image,
+                                                 vk::ImageLayout::eTransferSrcOptimal,
+                                                 layout,
+                                                 colorRange);
+    }
+    commandBuffer.pipelineBarrier2(vk::DependencyInfo{
+        .bufferMemoryBarrierCount = 1,
+        .pBufferMemoryBarriers    = &toHost,
+        .imageMemoryBarrierCount  = needsTransition ? 1u : 0u,
+        .pImageMemoryBarriers     = &fromTransfer,
+    });
+
+    slot.pending     = true;
+    slot.frameNumber = frameNumber;
+    slot.extent      = extent;
+    slot.format      = format;
+}
+
+void FrameReadback::collect(uint32_t frameIndex, const ReadbackCallback& callback)
+{
+    auto& slot{ m_slots[frameIndex] };
+    if (!slot.pending) {
+        return;
+    }
+    slot.pending = false;
+    if (!callback) {
+        return;
+    }
+    callback(ReadbackFrame{
+        .frameNumber = slot.frameNumber,
+        .extent      = slot.extent,
+        .format      = slot.format,
+        .data        = slot.data,
+        .size        = static_cast<size_t>(slot.extent.width) * slot.extent.height * 4,
+    });
+}
+
+}  // namespace ec::vulkan
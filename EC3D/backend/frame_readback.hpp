@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include "buffer.hpp"
+#include "image.hpp"
+
+#include <functional>
+#include <optional>
+
+namespace ec::vulkan
+{
+
+// Pixels of a rendered frame, only valid during the readback callback
+struct ReadbackFrame {
+    uint64_t frameNumber{};
+    vk::Extent2D extent{};
+    vk::Format format{};  // 4 bytes per pixel (RGBA8 or BGRA8)
+    const std::byte* data{};
+    size_t size{};
+};
+
+using ReadbackCallback = std::function<void(const ReadbackFrame&)>;
+
+// One host-visible buffer per frame in flight. A copy recorded in the slot of a frame is read
+// when that slot comes around again, after its frame has been waited on, so reading back never
+// stalls the GPU. Pixels arrive numFrames frames after they were rendered
+class FrameReadback
+{
+public:
+
+    struct Info {
+        vk::Device device;
+        const vk::PhysicalDeviceMemoryProperties& deviceMemoryProperties;
+        uint32_t queueFamilyIndex;
+        uint32_t numFrames;
+    };
+
+    FrameReadback() = default;
+    FrameReadback(const FrameReadback::Info& info);
+    FrameReadback(FrameReadback&&) = default;
+
+    FrameReadback& operator=(FrameReadback&&) = default;
+
+    void free();
+
+    // Records the copy of the color image (in layout, and left in it) to the slot of frameIndex
+    void record_copy(vk::CommandBuffer commandBuffer,
+                     vk::Image image,
+                     vk::ImageLayout layout,
+                     vk::Extent2D extent,
+                     vk::Format format,
+                     uint32_t frameIndex,
+                     uint64_t frameNumber);
+
+    // Calls back if a copy is pending in the slot of frameIndex. Its frame must be done
+    void collect(uint32_t frameIndex, const ReadbackCallback& callback);
+
+private:
+
+    vk::Device m_device{};
+    const vk::PhysicalDeviceMemoryProperties* m_deviceMemoryProperties{};
+    uint32_t m_queueFamilyIndex{};
+    vk::MemoryPropertyFlags m_memoryProperties{};
+
+    struct Slot {
+        std::optional<Buffer> buffer{};  // Grown on demand, e.g. after a resize
+        const std::byte* data{};
+        bool pending{};
+        uint64_t frameNumber{};
+        vk::Extent2D extent{};
+        vk::Format format{};
+    };
+    std::vector<Slot> m_slots{};
+};
+
+}  // namespace ec::vulkan
@@ -1,8 +1,11 @@
 #include "pch.hpp"
 #include "graphics_context.hpp"
 #include "image.hpp"
+#include "utils.hpp"
 #include "misc/timer.hpp"
 
+#include <bit>
+
 namespace ec::vulkan
 {
 
@@ -13,14 +16,42 @@ GraphicsContext::GraphicsContext(const GraphicsContext::Info& info) :
   m_graphicsQueueIndex{ info.queueFamilyIndex },
   m_swapchain{ &info.swapchain },
   m_currentFrameIdx{ 0 },
-  m_pipelineManager{ PipelineManager::Info{ .device = m_device } }
+  m_dynamicRendering{ info.dynamicRendering },
+  m_pipelineManager{ PipelineManager::Info{
+      .device                  = m_device,
+      .extendedDynamicState    = info.extendedDynamicState,
+      .graphicsPipelineLibrary = info.graphicsPipelineLibrary,
+      .shaderObject            = info.shaderObject,
+  } },
+  m_minBufferOffsetAlignment{ info.minBufferOffsetAlignment },
+  m_bufferDeviceAddress{ info.bufferDeviceAddress },
+  m_recordAhead{ info.recordAhead },
+  m_timestampPeriod{ info.timestampPeriod },
+  m_deletionQueue{ info.device }
 {
+    // Nothing to wait for when acquiring offscreen images
+    if (m_recordAhead && m_swapchain->is_headless()) {
+        m_recordAhead = false;
+    } else if (m_recordAhead && !m_swapchain->supports_transfer_dst()) {
+        EC_LOG_WARN("Swapchain images can't be copied to, record-ahead is disabled");
+        m_recordAhead = false;
+    }
 }
 
 void GraphicsContext::free()
 {
     m_graphicsQueue.waitIdle();
     m_pipelineManager.free();
+    if (m_readback) {
+        m_readback->free();
+        m_readback.reset();
+    }
+    m_readbackCallback = nullptr;
+    m_readbackActive   = false;
+    if (m_uniformRing) {
+        m_uniformRing->free();
+        m_uniformRing.reset();
+    }
     for (auto& frame : m_frames) {
         if (frame.imageAvailableSemaphore) {
             m_device.destroySemaphore(frame.imageAvailableSemaphore);
@@ -30,10 +61,6 @@ void GraphicsContext::free()
             m_device.destroySemaphore(frame.imageRenderedSemaphore);
             frame.imageRenderedSemaphore = nullptr;
         }
-        if (frame.imageRenderedFence) {
-            m_device.destroyFence(frame.imageRenderedFence);
-            frame.imageRenderedFence = nullptr;
-        }
         for (auto& cBuffer : frame.commandBuffers) {
             m_device.freeCommandBuffers(frame.commandPool, cBuffer);
         }
@@ -43,26 +70,31 @@ void GraphicsContext::free()
             frame.commandPool = nullptr;
         }
     };
-    if (!m_framebuffers.empty()) {
-        for (auto& framebuffer : m_framebuffers) {
-            m_device.destroyFramebuffer(framebuffer);
-        }
+    m_timeline.free();
+    if (m_timestampQueryPool) {
+        m_device.destroyQueryPool(m_timestampQueryPool);
+        m_timestampQueryPool = nullptr;
+    }
+    m_latencyController.reset();
+    m_deletionQueue.flush_all();
+    for (auto& framebuffer : m_framebuffers) {
+        m_device.destroyFramebuffer(framebuffer);
     }
     m_framebuffers.clear();
-    if (!m_framebufferImages.empty()) {
-        for (auto& swapchainFramebuffer : m_framebufferImages) {
-            for (size_t j = 0; j < swapchainFramebuffer.size(); ++j) {
-                if (j != m_swapchainAttachmentIndex) {
-                    swapchainFramebuffer[j].free();
-                }
+    for (auto& swapchainFramebuffer : m_framebufferImages) {
+        for (size_t j = 0; j < swapchainFramebuffer.size(); ++j) {
+            if (owns_attachment_image(j)) {
+                swapchainFramebuffer[j].free();
             }
         }
     }
     m_framebufferImages.clear();
+    m_framebufferImageInfos.clear();
     if (m_renderPass) {
         m_device.destroyRenderPass(m_renderPass);
         m_renderPass = nullptr;
     }
+    m_mode = Mode::renderPass;
 }
 
 void GraphicsContext::create_render_pass(const RenderPassInfo& info)
@@ -73,14 +105,6 @@ void GraphicsContext::create_render_pass(const RenderPassInfo& info)
 
     m_renderPassInfo = info;
 
-    struct FramebufferImageInfo {
-        vk::Format format{};
-        vk::SampleCountFlagBits samples{};
-        vk::ImageLayout initialLayout{};
-        vk::ImageUsageFlags usage{};
-        vk::ImageAspectFlags aspect{};
-        bool isSwapchainImage{};
-    };
     // Gather information for later
     std::vector<FramebufferImageInfo> framebufferImageInfos(info.attachments.size());
 
@@ -96,7 +120,7 @@ void GraphicsContext::create_render_pass(const RenderPassInfo& info)
             .stencilLoadOp  = currentAttachment.stencilLoadOp,
             .stencilStoreOp = currentAttachment.stencilStoreOp,
             .initialLayout  = currentAttachment.initialLayout,
-            .finalLayout    = currentAttachment.finalLayout,
+            .finalLayout    = get_final_layout(currentAttachment),
         };
 
         if (currentAttachment.finalLayout == vk::ImageLayout::ePresentSrcKHR) {
@@ -110,12 +134,12 @@ void GraphicsContext::create_render_pass(const RenderPassInfo& info)
                 throw std::runtime_error(
                     "Attachment set to present source is not compatible with the swapchain!");
             }
-        } else {
-            framebufferImageInfos[i].format        = currentAttachment.format;
-            framebufferImageInfos[i].samples       = currentAttachment.numSamples;
-            framebufferImageInfos[i].initialLayout = currentAttachment.initialLayout;
-            framebufferImageInfos[i].aspect        = currentAttachment.aspect;
         }
+        // Also for the swapchain attachment, which is an image of its own with record-ahead
+        framebufferImageInfos[i].format        = currentAttachment.format;
+        framebufferImageInfos[i].samples       = currentAttachment.numSamples;
+        framebufferImageInfos[i].initialLayout = currentAttachment.initialLayout;
+        framebufferImageInfos[i].aspect        = currentAttachment.aspect;
     }
     if (!swapchainAttachmentFound) {
         throw std::runtime_error("Swapchain attachment not found when creating the renderpass!");
@@ -188,22 +212,9 @@ void GraphicsContext::create_render_pass(const RenderPassInfo& info)
         throw;
     }
 
-    m_framebufferImages.resize(m_swapchain->get_num_images());
+    m_framebufferImageInfos = std::move(framebufferImageInfos);
     try {
-        for (size_t i = 0; i < m_framebufferImages.size(); ++i) {
-            for (auto& imgInfo : framebufferImageInfos) {
-                if (imgInfo.isSwapchainImage) {
-                    m_framebufferImages[i].push_back({});  // Dummy, swapchain image already exists
-                    continue;
-                }
-                create_framebuffer_image(imgInfo.format,
-                                         imgInfo.usage,
-                                         imgInfo.samples,
-                                         imgInfo.initialLayout,
-                                         imgInfo.aspect);
-            }
-        }
-        create_framebuffers();
+        create_size_dependent_resources();
     }
     catch (const std::exception& e) {
         EC_LOG_ERROR("Failed to create framebuffers: {}", e.what());
@@ -211,11 +222,81 @@ void GraphicsContext::create_render_pass(const RenderPassInfo& info)
         throw;
     }
 
+    create_frame_resources();
+}
+
+void GraphicsContext::create_dynamic_rendering(const RenderingInfo& info)
+{
+    if (m_renderPass || m_mode == Mode::dynamicRendering) {
+        throw std::runtime_error("Render targets already exist in this context!");
+    }
+    if (!m_dynamicRendering) {
+        throw std::runtime_error("Dynamic rendering is not supported by the device!");
+    }
+
+    m_mode = Mode::dynamicRendering;
+
+    // Attachments are stored as {color..., depth} so clear values can be set by index
+    m_renderPassInfo             = {};
+    m_renderPassInfo.attachments = info.colorAttachments;
+    if (info.depthAttachment.has_value()) {
+        m_renderPassInfo.attachments.push_back(info.depthAttachment.value());
+    }
+    m_numColorAttachments = static_cast<uint32_t>(info.colorAttachments.size());
+
+    bool swapchainAttachmentFound{};
+    for (size_t i = 0; i < info.colorAttachments.size(); ++i) {
+        if (info.colorAttachments[i].finalLayout != vk::ImageLayout::ePresentSrcKHR) {
+            continue;
+        }
+        if (swapchainAttachmentFound) {
+            throw std::runtime_error("Multiple attachments set to present!");
+        }
+        if (info.colorAttachments[i].format != m_swapchain->get_format()) {
+            throw std::runtime_error(
+                "Attachment set to present source is not compatible with the swapchain!");
+        }
+        swapchainAttachmentFound   = true;
+        m_swapchainAttachmentIndex = static_cast<uint32_t>(i);
+    }
+    if (!swapchainAttachmentFound) {
+        throw std::runtime_error("Swapchain attachment not found when creating the attachments!");
+    }
+
+    // Only the images are created, no render pass or framebuffer depends on them
+    for (size_t i = 0; i < m_renderPassInfo.attachments.size(); ++i) {
+        auto& attachment{ m_renderPassInfo.attachments[i] };
+        m_framebufferImageInfos.push_back({
+            .format           = attachment.format,
+            .samples          = attachment.numSamples,
+            .initialLayout    = vk::ImageLayout::eUndefined,
+            .usage            = i < m_numColorAttachments
+                                    ? vk::ImageUsageFlagBits::eColorAttachment
+                                    : vk::ImageUsageFlagBits::eDepthStencilAttachment,
+            .aspect           = attachment.aspect,
+            .isSwapchainImage = i == m_swapchainAttachmentIndex,
+        });
+    }
+    try {
+        create_size_dependent_resources();
+    }
+    catch (const std::exception& e) {
+        EC_LOG_ERROR("Failed to create attachment images: {}", e.what());
+        free();
+        throw;
+    }
+
+    create_frame_resources();
+}
+
+void GraphicsContext::create_frame_resources()
+{
     try {
         create_frame_synchronization();
+        create_timestamp_query_pool();
     }
     catch (const std::exception& e) {
-        EC_LOG_ERROR("Failed to create frame synchronization (semaphores/fence): {}", e.what());
+        EC_LOG_ERROR("Failed to create frame synchronization (semaphores/queries): {}", e.what());
         free();
         throw;
     }
@@ -233,24 +314,205 @@ void GraphicsContext::create_render_pass(const RenderPassInfo& info)
 
 uint32_t GraphicsContext::create_pipeline(GraphicsPipelineInfo& info)
 {
-    info.viewportExtent = m_swapchain->get_extent();
-    info.renderPass     = m_renderPass;
+    if (m_pipelineManager.uses_shader_objects() && m_mode != Mode::dynamicRendering) {
+        throw std::runtime_error("Shader objects can only be used with dynamic rendering!");
+    }
+    if (m_mode == Mode::dynamicRendering) {
+        info.renderPass             = nullptr;
+        info.colorAttachmentFormats = {};
+        for (uint32_t i = 0; i < m_numColorAttachments; ++i) {
+            info.colorAttachmentFormats.push_back(m_renderPassInfo.attachments[i].format);
+        }
+        info.depthAttachmentFormat = m_renderPassInfo.attachments.size() > m_numColorAttachments
+                                         ? m_renderPassInfo.attachments.back().format
+                                         : vk::Format::eUndefined;
+    } else {
+        info.renderPass = m_renderPass;
+    }
     return m_pipelineManager.create_basic_graphics_pipeline(info);
 }
 
-void GraphicsContext::begin_rendering()
+UniformRing& GraphicsContext::create_uniform_ring(vk::DeviceSize bytesPerFrame)
+{
+    if (m_uniformRing) {
+        throw std::runtime_error("Uniform ring already exists in this context!");
+    }
+
+    UniformRing::Info ringInfo{
+        .bytesPerFrame = bytesPerFrame,
+        .numFrames     = MAX_RENDERING_FRAMES,
+        .alignment     = m_minBufferOffsetAlignment,
+        .deviceAddress = m_bufferDeviceAddress,
+    };
+    m_uniformRing.emplace(m_device,
+                          *m_deviceMemoryProperties,
+                          std::vector<uint32_t>{ m_graphicsQueueIndex },
+                          ringInfo);
+    m_uniformRing->begin_frame(m_currentFrameIdx);
+
+    return m_uniformRing.value();
+}
+
+void GraphicsContext::start_readback(ReadbackCallback callback)
+{
+    if (!m_recordAhead && !m_swapchain->supports_transfer_src()) {
+        throw std::runtime_error("Swapchain images can't be copied, readback is not supported!");
+    }
+    // Frames are read back and exported as 4 bytes per pixel
+    switch (m_swapchain->get_format()) {
+        case vk::Format::eR8G8B8A8Unorm:
+        case vk::Format::eR8G8B8A8Srgb:
+        case vk::Format::eB8G8R8A8Unorm:
+        case vk::Format::eB8G8R8A8Srgb: break;
+        default:
+            throw std::runtime_error(
+                std::format("Frames in {} can't be read back, only 8-bit RGBA and BGRA can",
+                            vk::to_string(m_swapchain->get_format())));
+    }
+    if (!m_readback) {
+        m_readback.emplace(FrameReadback::Info{
+            .device                 = m_device,
+            .deviceMemoryProperties = *m_deviceMemoryProperties,
+            .queueFamilyIndex       = m_graphicsQueueIndex,
+            .numFrames              = MAX_RENDERING_FRAMES,
+        });
+    }
+    m_readbackCallback = std::move(callback);
+    m_readbackActive   = true;
+}
+
+void GraphicsContext::stop_readback()
 {
-    std::ignore = m_device.waitForFences(m_frames[m_currentFrameIdx].imageRenderedFence,
-                                         VK_TRUE,
-                                         std::numeric_limits<uint64_t>::max());
-    m_device.resetFences(m_frames[m_currentFrameIdx].imageRenderedFence);
+    if (!m_readback) {
+        return;
+    }
+    m_readbackActive = false;
+    m_timeline.wait_all();
+    // Oldest frame first
+    for (uint32_t i = 0; i < MAX_RENDERING_FRAMES; ++i) {
+        m_readback->collect((m_currentFrameIdx + i) % MAX_RENDERING_FRAMES, m_readbackCallback);
+    }
+    m_readbackCallback = nullptr;
+}
+
+bool GraphicsContext::begin_rendering()
+{
+    // Interval since the previous frame began, minus the time it spent blocked
+    float frameInterval{ m_frameTimer.get_delta_time() };
+    m_frameTimings.cpuTime = std::max(frameInterval - m_blockedTime, 0.f);
+    m_blockedTime          = 0.f;
+
+    // At most m_framesInFlight frames are pending, waiting for the oldest frees its resources
+    if (m_frameNumber >= m_framesInFlight) {
+        Timer blockedTimer{};
+        wait_for_frame(m_frameNumber - m_framesInFlight);
+        m_blockedTime += blockedTimer.get_elapsed_time();
+    }
+    update_frame_timings(m_currentFrameIdx);
+    // Later frames may be done too, their retired resources can be destroyed as well
+    uint64_t completedFrames{ m_timeline.get_completed_value() };
+    if (completedFrames > 0) {
+        m_deletionQueue.flush(completedFrames - 1);
+    }
+    if (m_readback) {
+        m_readback->collect(m_currentFrameIdx, m_readbackCallback);
+    }
 
-    // TODO: Resize swapchain and window if result is not VK_SUCCESS
-    m_acquiredSwapchainImage
-        = m_swapchain->acquire_next_image(m_frames[m_currentFrameIdx].imageAvailableSemaphore);
+    if (m_recordAhead) {
+        // Still recreated here, so the frame is recorded with the right extent
+        if (m_swapchain->is_out_of_date() && !recreate_swapchain()) {
+            m_skippedFrame = true;
+            return false;
+        }
+    } else if (!acquire_swapchain_image()) {
+        m_skippedFrame = true;
+        return false;
+    }
+    // The interval after a skipped frame includes e.g. the wait while minimized
+    if (!m_skippedFrame) {
+        add_latency_sample();
+    }
+    m_skippedFrame = false;
+
+    // The GPU is done with this frame slot, its constants can be overwritten
+    if (m_uniformRing) {
+        m_uniformRing->begin_frame(m_currentFrameIdx);
+    }
+    m_pipelineManager.update(m_deletionQueue, m_frameNumber);
 
     m_device.resetCommandPool(m_frames[m_currentFrameIdx].commandPool);
 
+    auto& commandBuffer{ m_frames[m_currentFrameIdx].commandBuffers[0] };
+
+    commandBuffer.begin(vk::CommandBufferBeginInfo{
+        .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+    });
+    if (m_timestampQueryPool) {
+        commandBuffer.resetQueryPool(m_timestampQueryPool, 2 * m_currentFrameIdx, 2);
+        commandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eTopOfPipe,
+                                      m_timestampQueryPool,
+                                      2 * m_currentFrameIdx);
+    }
+
+    if (m_mode == Mode::dynamicRendering) {
+        begin_dynamic_rendering(commandBuffer);
+    } else {
+        begin_render_pass(commandBuffer);
+    }
+
+    vk::Extent2D extent{ m_swapchain->get_extent() };
+    set_viewport(vk::Viewport{
+        .width    = static_cast<float>(extent.width),
+        .height   = static_cast<float>(extent.height),
+        .minDepth = 0.f,
+        .maxDepth = 1.f,
+    });
+    set_scissor(vk::Rect2D{ .extent = extent });
+    return true;
+}
+
+void GraphicsContext::end_rendering()
+{
+    auto& commandBuffer{ m_frames[m_currentFrameIdx].commandBuffers[0] };
+    if (m_mode == Mode::dynamicRendering) {
+        end_dynamic_rendering(commandBuffer);
+    } else {
+        commandBuffer.endRenderPass();
+    }
+    if (m_readbackActive) {
+        const auto& swapchainAttachment{ m_renderPassInfo.attachments[m_swapchainAttachmentIndex] };
+        const Image& image{
+            get_attachment_image(get_render_target_index(), m_swapchainAttachmentIndex)
+        };
+        m_readback->record_copy(commandBuffer,
+                                image.get_image(),
+                                get_final_layout(swapchainAttachment),
+                                m_swapchain->get_extent(),
+                                m_swapchain->get_format(),
+                                m_currentFrameIdx,
+                                m_frameNumber);
+    }
+    if (m_timestampQueryPool) {
+        commandBuffer.writeTimestamp2(vk::PipelineStageFlagBits2::eBottomOfPipe,
+                                      m_timestampQueryPool,
+                                      2 * m_currentFrameIdx + 1);
+        m_frames[m_currentFrameIdx].timestampsWritten = true;
+    }
+    commandBuffer.end();
+
+    if (m_recordAhead) {
+        submit_and_present_ahead(m_currentFrameIdx);
+    } else {
+        submit_command_buffer(m_currentFrameIdx);
+        present(m_currentFrameIdx, m_acquiredSwapchainImage);
+    }
+
+    m_currentFrameIdx = (m_currentFrameIdx + 1) % MAX_RENDERING_FRAMES;
+    ++m_frameNumber;
+}
+
+void GraphicsContext::begin_render_pass(vk::CommandBuffer commandBuffer)
+{
     std::vector<VkClearValue> clearValues(m_renderPassInfo.attachments.size());
     for (size_t i = 0; i < clearValues.size(); ++i) {
         clearValues[i] = m_renderPassInfo.attachments[i].clearValue;
@@ -259,39 +521,274 @@ void GraphicsContext::begin_rendering()
     VkRenderPassBeginInfo renderPassBeginInfo
     {
         .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO, .renderPass = m_renderPass,
-        .framebuffer = m_framebuffers[m_acquiredSwapchainImage],
+        .framebuffer = m_framebuffers[get_render_target_index()],
         .renderArea  = vk::Rect2D{.offset = { 0, 0 }, .extent = m_swapchain->get_extent(), },
         .clearValueCount = static_cast<uint32_t>(clearValues.size()),
         .pClearValues = clearValues.data(),
     };
 
-    auto& commandBuffer{ m_frames[m_currentFrameIdx].commandBuffers[0] };
+    // C-style because vk::ClearValue doesn't want to work for some reason
+    vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+}
 
-    commandBuffer.begin(vk::CommandBufferBeginInfo{
-        .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+void GraphicsContext::begin_dynamic_rendering(vk::CommandBuffer commandBuffer)
+{
+    std::vector<vk::ImageMemoryBarrier2> barriers{};
+    std::vector<vk::RenderingAttachmentInfo> colorAttachments{};
+    vk::RenderingAttachmentInfo depthAttachment{};
+    bool hasDepth{}, hasStencil{};
+
+    for (uint32_t i = 0; i < m_renderPassInfo.attachments.size(); ++i) {
+        const auto& attachment{ m_renderPassInfo.attachments[i] };
+        const Image& image{ get_attachment_image(get_render_target_index(), i) };
+        bool isColor{ i < m_numColorAttachments };
+        vk::ImageLayout layout{ isColor ? vk::ImageLayout::eColorAttachmentOptimal
+                                        : vk::ImageLayout::eDepthStencilAttachmentOptimal };
+
+        barriers.push_back(layout_transition_barrier(
+            image.get_image(),
+            attachment.initialLayout,
+            layout,
+            { .aspectMask = attachment.aspect, .levelCount = 1, .layerCount = 1 }));
+
+        vk::RenderingAttachmentInfo attachmentInfo{
+            .imageView   = image.get_image_view(),
+            .imageLayout = layout,
+            .loadOp      = attachment.loadOp,
+            .storeOp     = attachment.storeOp,
+            .clearValue  = std::bit_cast<vk::ClearValue>(attachment.clearValue),
+        };
+        if (isColor) {
+            colorAttachments.push_back(attachmentInfo);
+        } else {
+            depthAttachment = attachmentInfo;
+            hasDepth        = true;
+            hasStencil      = static_cast<bool>(attachment.aspect
+                                           & vk::ImageAspectFlagBits::eStencil);
+        }
+    }
+
+    commandBuffer.pipelineBarrier2(vk::DependencyInfo{
+        .imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size()),
+        .pImageMemoryBarriers    = barriers.data(),
     });
 
-    // C-style because vk::ClearValue doesn't want to work for some reason
-    vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vk::RenderingInfo renderingInfo{
+        .renderArea           = vk::Rect2D{ .extent = m_swapchain->get_extent() },
+        .layerCount           = 1,
+        .colorAttachmentCount = static_cast<uint32_t>(colorAttachments.size()),
+        .pColorAttachments    = colorAttachments.data(),
+        .pDepthAttachment     = hasDepth ? &depthAttachment : nullptr,
+        .pStencilAttachment   = hasStencil ? &depthAttachment : nullptr,
+    };
+    commandBuffer.beginRendering(renderingInfo);
 }
 
-void GraphicsContext::end_rendering()
+void GraphicsContext::end_dynamic_rendering(vk::CommandBuffer commandBuffer)
 {
-    auto& commandBuffer{ m_frames[m_currentFrameIdx].commandBuffers[0] };
-    commandBuffer.endRenderPass();
-    commandBuffer.end();
+    commandBuffer.endRendering();
 
-    submit_command_buffer(m_currentFrameIdx);
-    present(m_currentFrameIdx, m_acquiredSwapchainImage);
+    std::vector<vk::ImageMemoryBarrier2> barriers{};
+    for (uint32_t i = 0; i < m_renderPassInfo.attachments.size(); ++i) {
+        const auto& attachment{ m_renderPassInfo.attachments[i] };
+        vk::ImageLayout layout{ i < m_numColorAttachments
+                                    ? vk::ImageLayout::eColorAttachmentOptimal
+                                    : vk::ImageLayout::eDepthStencilAttachmentOptimal };
+        vk::ImageLayout finalLayout{ get_final_layout(attachment) };
+        if (finalLayout == vk::ImageLayout::eUndefined || finalLayout == layout) {
+            continue;
+        }
+        barriers.push_back(layout_transition_barrier(
+            get_attachment_image(get_render_target_index(), i).get_image(),
+            layout,
+            finalLayout,
+            { .aspectMask = attachment.aspect, .levelCount = 1, .layerCount = 1 }));
+    }
 
-    m_currentFrameIdx = (m_currentFrameIdx + 1) % MAX_RENDERING_FRAMES;
+    commandBuffer.pipelineBarrier2(vk::DependencyInfo{
+        .imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size()),
+        .pImageMemoryBarriers    = barriers.data(),
+    });
+}
+
+const Image& GraphicsContext::get_attachment_image(uint32_t renderTargetIndex,
+                                                   uint32_t attachmentIndex) const
+{
+    if (!owns_attachment_image(attachmentIndex)) {
+        return m_swapchain->get_image(renderTargetIndex).image;
+    }
+    return m_framebufferImages[renderTargetIndex][attachmentIndex];
+}
+
+vk::ImageLayout GraphicsContext::get_final_layout(const AttachmentInfo& attachment) const
+{
+    // Offscreen and record-ahead images are never presented, they are left ready to be copied
+    if (attachment.finalLayout == vk::ImageLayout::ePresentSrcKHR
+        && (m_swapchain->is_headless() || m_recordAhead)) {
+        return vk::ImageLayout::eTransferSrcOptimal;
+    }
+    return attachment.finalLayout;
+}
+
+void GraphicsContext::set_viewport(const vk::Viewport& viewport)
+{
+    // Shader objects also need the viewport count, which is baked into pipelines
+    if (m_pipelineManager.uses_shader_objects()) {
+        m_frames[m_currentFrameIdx].commandBuffers[0].setViewportWithCount(viewport);
+    } else {
+        m_frames[m_currentFrameIdx].commandBuffers[0].setViewport(0, viewport);
+    }
+}
+
+void GraphicsContext::set_scissor(const vk::Rect2D& scissor)
+{
+    if (m_pipelineManager.uses_shader_objects()) {
+        m_frames[m_currentFrameIdx].commandBuffers[0].setScissorWithCount(scissor);
+    } else {
+        m_frames[m_currentFrameIdx].commandBuffers[0].setScissor(0, scissor);
+    }
+}
+
+void GraphicsContext::set_cull_mode(vk::CullModeFlags cullMode)
+{
+    EC_ASSERT(m_pipelineManager.has_extended_dynamic_state());
+    m_frames[m_currentFrameIdx].commandBuffers[0].setCullMode(cullMode);
+}
+
+void GraphicsContext::set_front_face(vk::FrontFace frontFace)
+{
+    EC_ASSERT(m_pipelineManager.has_extended_dynamic_state());
+    m_frames[m_currentFrameIdx].commandBuffers[0].setFrontFace(frontFace);
+}
+
+void GraphicsContext::set_primitive_topology(vk::PrimitiveTopology topology)
+{
+    EC_ASSERT(m_pipelineManager.has_extended_dynamic_state());
+    m_frames[m_currentFrameIdx].commandBuffers[0].setPrimitiveTopology(topology);
+}
+
+void GraphicsContext::set_depth_test(vk::Bool32 testEnable,
+                                     vk::Bool32 writeEnable,
+                                     vk::CompareOp compareOp)
+{
+    EC_ASSERT(m_pipelineManager.has_extended_dynamic_state());
+    auto& commandBuffer{ m_frames[m_currentFrameIdx].commandBuffers[0] };
+    commandBuffer.setDepthTestEnable(testEnable);
+    commandBuffer.setDepthWriteEnable(writeEnable);
+    commandBuffer.setDepthCompareOp(compareOp);
 }
 
 void GraphicsContext::bind_pipeline(uint32_t pipelineIndex)
 {
-    m_frames[m_currentFrameIdx].commandBuffers[0].bindPipeline(
-        vk::PipelineBindPoint::eGraphics,
-        m_pipelineManager.get_pipeline(pipelineIndex));
+    if (m_pipelineManager.uses_shader_objects()) {
+        bind_shader_objects(pipelineIndex);
+    } else {
+        m_frames[m_currentFrameIdx].commandBuffers[0].bindPipeline(
+            vk::PipelineBindPoint::eGraphics,
+            m_pipelineManager.get_pipeline(pipelineIndex));
+    }
+
+    if (m_pipelineManager.has_extended_dynamic_state()) {
+        const auto& info{ m_pipelineManager.get_pipeline_info(pipelineIndex) };
+        set_cull_mode(info.cullMode);
+        set_front_face(info.frontFace);
+        set_primitive_topology(info.primitiveTopology);
+        set_depth_test(info.depthTestEnable, info.depthWriteEnable, info.depthCompareOp);
+    }
+}
+
+void GraphicsContext::bind_shader_objects(uint32_t pipelineIndex)
+{
+    auto& commandBuffer{ m_frames[m_currentFrameIdx].commandBuffers[0] };
+    const auto& info{ m_pipelineManager.get_pipeline_info(pipelineIndex) };
+    const auto& shaderObjects{ m_pipelineManager.get_shader_objects(pipelineIndex) };
+
+    // Only vertex and fragment stages are used. A missing fragment shader is bound as null
+    std::array<vk::ShaderStageFlagBits, 2> stages{ vk::ShaderStageFlagBits::eVertex,
+                                                   vk::ShaderStageFlagBits::eFragment };
+    std::array<vk::ShaderEXT, 2> boundShaders{};
+    for (size_t i = 0; i < info.shaders.size(); ++i) {
+        bool isVertex{ info.shaders[i].stage == vk::ShaderStageFlagBits::eVertex };
+        boundShaders[isVertex ? 0 : 1] = shaderObjects[i];
+    }
+    commandBuffer.bindShadersEXT(stages, boundShaders);
+    bool hasFragmentShader{ static_cast<bool>(boundShaders[1]) };
+
+    // -- Vertex Input --
+    std::vector<vk::VertexInputBindingDescription2EXT> bindings(info.bindingStrides.size());
+    for (size_t i = 0; i < bindings.size(); ++i) {
+        bindings[i] = {
+            .binding   = static_cast<uint32_t>(i),
+            .stride    = info.bindingStrides[i],
+            .inputRate = vk::VertexInputRate::eVertex,
+            .divisor   = 1,
+        };
+    }
+    std::vector<vk::VertexInputAttributeDescription2EXT> attributes(
+        info.attributeDescriptions.size());
+    for (size_t i = 0; i < attributes.size(); ++i) {
+        attributes[i] = {
+            .location = static_cast<uint32_t>(i),
+            .binding  = info.attributeDescriptions[i].binding,
+            .format   = info.attributeDescriptions[i].format,
+            .offset   = info.attributeDescriptions[i].offset,
+        };
+    }
+    commandBuffer.setVertexInputEXT(bindings, attributes);
+    commandBuffer.setPrimitiveRestartEnable(info.primitiveRestartEnable);
+
+    // -- Rasterization and multisampling --
+    // Depth clamp and logic op would also need to be set if their device features were enabled
+    commandBuffer.setRasterizerDiscardEnable(!hasFragmentShader);
+    commandBuffer.setPolygonModeEXT(vk::PolygonMode::eFill);
+    commandBuffer.setDepthBiasEnable(VK_FALSE);
+    commandBuffer.setRasterizationSamplesEXT(info.rasterizationSamples);
+    vk::SampleMask sampleMask{ ~0u };
+    commandBuffer.setSampleMaskEXT(info.rasterizationSamples, sampleMask);
+    commandBuffer.setAlphaToCoverageEnableEXT(VK_FALSE);
+
+    // -- Depth Stencil --
+    commandBuffer.setDepthBoundsTestEnable(VK_FALSE);
+    commandBuffer.setStencilTestEnable(info.stencilTestEnable);
+    if (info.stencilTestEnable) {
+        auto setStencilState{ [&](vk::StencilFaceFlags face, const vk::StencilOpState& state) {
+            commandBuffer.setStencilOp(face,
+                                       state.failOp,
+                                       state.passOp,
+                                       state.depthFailOp,
+                                       state.compareOp);
+            commandBuffer.setStencilCompareMask(face, state.compareMask);
+            commandBuffer.setStencilWriteMask(face, state.writeMask);
+            commandBuffer.setStencilReference(face, state.reference);
+        } };
+        setStencilState(vk::StencilFaceFlagBits::eFront, info.stencilStateFront);
+        setStencilState(vk::StencilFaceFlagBits::eBack, info.stencilStateBack);
+    }
+
+    // -- Blending --
+    // Set for every color attachment, the ones missing in blendEnableInAttachments don't blend
+    size_t numAttachments{ info.colorAttachmentFormats.size() };
+    if (hasFragmentShader && numAttachments > 0) {
+        const auto& base{ PipelineManager::BASE_BLEND_ATTACHMENT_STATE };
+        std::vector<vk::Bool32> blendEnables(numAttachments, VK_FALSE);
+        std::copy_n(info.blendEnableInAttachments.begin(),
+                    std::min(numAttachments, info.blendEnableInAttachments.size()),
+                    blendEnables.begin());
+        std::vector<vk::ColorBlendEquationEXT> blendEquations(
+            numAttachments,
+            vk::ColorBlendEquationEXT{
+                .srcColorBlendFactor = base.srcColorBlendFactor,
+                .dstColorBlendFactor = base.dstColorBlendFactor,
+                .colorBlendOp        = base.colorBlendOp,
+                .srcAlphaBlendFactor = base.srcAlphaBlendFactor,
+                .dstAlphaBlendFactor = base.dstAlphaBlendFactor,
+                .alphaBlendOp        = base.alphaBlendOp,
+            });
+        std::vector<vk::ColorComponentFlags> writeMasks(numAttachments, base.colorWriteMask);
+        commandBuffer.setColorBlendEnableEXT(0, blendEnables);
+        commandBuffer.setColorBlendEquationEXT(0, blendEquations);
+        commandBuffer.setColorWriteMaskEXT(0, writeMasks);
+    }
 }
 
 void GraphicsContext::bind_vertex_buffers(const std::vector<Buffer>& buffers)
@@ -305,56 +802,180 @@ void GraphicsContext::bind_vertex_buffers(const std::vector<Buffer>& buffers)
 }
 
 void GraphicsContext::bind_index_buffer(const Buffer& buffer)
+{
+    bind_index_buffer(buffer, buffer.get_index_type());
+}
+
+void GraphicsContext::bind_index_buffer(const Buffer& buffer, vk::IndexType indexType)
 {
     m_frames[m_currentFrameIdx].commandBuffers[0].bindIndexBuffer(buffer.get_handle(),
                                                                   0,
-                                                                  buffer.get_index_type());
+                                                                  indexType);
 }
 
-void GraphicsContext::draw_indexed(uint32_t indexCount)
+void GraphicsContext::bind_descriptor_set(uint32_t pipelineIndex,
+                                          uint32_t setIndex,
+                                          vk::DescriptorSet descriptorSet,
+                                          const std::vector<uint32_t>& dynamicOffsets)
 {
-    m_frames[m_currentFrameIdx].commandBuffers[0].drawIndexed(indexCount, 1, 0, 0, 0);
+    m_frames[m_currentFrameIdx].commandBuffers[0].bindDescriptorSets(
+        vk::PipelineBindPoint::eGraphics,
+        m_pipelineManager.get_pipeline_layout(pipelineIndex),
+        setIndex,
+        descriptorSet,
+        dynamicOffsets);
 }
 
-void GraphicsContext::create_framebuffer_image(vk::Format format,
-                                               vk::ImageUsageFlags usage,
-                                               vk::SampleCountFlagBits samples,
-                                               vk::ImageLayout layout,
-                                               vk::ImageAspectFlags aspect)
+void GraphicsContext::push_constants(uint32_t pipelineIndex,
+                                     vk::ShaderStageFlags stages,
+                                     uint32_t offset,
+                                     uint32_t size,
+                                     const void* data)
+{
+    m_frames[m_currentFrameIdx].commandBuffers[0].pushConstants(
+        m_pipelineManager.get_pipeline_layout(pipelineIndex),
+        stages,
+        offset,
+        size,
+        data);
+}
+
+void GraphicsContext::draw_indexed(uint32_t indexCount, uint32_t firstIndex, int32_t vertexOffset)
+{
+    m_frames[m_currentFrameIdx].commandBuffers[0].drawIndexed(indexCount,
+                                                              1,
+                                                              firstIndex,
+                                                              vertexOffset,
+                                                              0);
+}
+
+void GraphicsContext::wait_idle()
+{
+    m_timeline.wait_all();
+}
+
+Image GraphicsContext::create_framebuffer_image(const FramebufferImageInfo& info)
 {
     vk::Extent2D swapchainExtent{ m_swapchain->get_extent() };
     Image::Info imageInfo{
         .width                  = swapchainExtent.width,
         .height                 = swapchainExtent.height,
-        .format                 = format,
-        .usage                  = usage,
-        .samples                = samples,
-        .layout                 = layout,
+        .format                 = info.format,
+        .usage                  = info.usage,
+        .samples                = info.samples,
+        .layout                 = info.initialLayout,
         .memoryProperties       = vk::MemoryPropertyFlagBits::eDeviceLocal,
         .deviceMemoryProperties = *m_deviceMemoryProperties,
     };
 
-    for (size_t i = 0; i < m_framebufferImages.size(); ++i) {
-        Image framebufferImage{ m_device, imageInfo };
-        framebufferImage.create_view(format, aspect);
-        m_framebufferImages[i].push_back(std::move(framebufferImage));
+    Image framebufferImage{ m_device, imageInfo };
+    framebufferImage.create_view(info.format, info.aspect);
+    return framebufferImage;
+}
+
+void GraphicsContext::create_size_dependent_resources()
+{
+    m_framebufferImages.resize(get_num_render_targets());
+    for (auto& swapchainFramebuffer : m_framebufferImages) {
+        for (auto& imgInfo : m_framebufferImageInfos) {
+            if (imgInfo.isSwapchainImage && !m_recordAhead) {
+                swapchainFramebuffer.push_back({});  // Dummy, swapchain image already exists
+                continue;
+            }
+            if (imgInfo.isSwapchainImage) {
+                // Rendered instead of the swapchain image, and copied to it after acquiring
+                FramebufferImageInfo renderTargetInfo{ imgInfo };
+                renderTargetInfo.usage |= vk::ImageUsageFlagBits::eTransferSrc;
+                swapchainFramebuffer.push_back(create_framebuffer_image(renderTargetInfo));
+                continue;
+            }
+            swapchainFramebuffer.push_back(create_framebuffer_image(imgInfo));
+        }
+    }
+    if (m_renderPass) {
+        create_framebuffers();
+    }
+}
+
+void GraphicsContext::retire_size_dependent_resources()
+{
+    for (auto& framebuffer : m_framebuffers) {
+        m_deletionQueue.retire(framebuffer, m_frameNumber);
+    }
+    m_framebuffers.clear();
+    for (auto& swapchainFramebuffer : m_framebufferImages) {
+        for (size_t j = 0; j < swapchainFramebuffer.size(); ++j) {
+            if (owns_attachment_image(j)) {
+                m_deletionQueue.retire(std::move(swapchainFramebuffer[j]), m_frameNumber);
+            }
+        }
+    }
+    m_framebufferImages.clear();
+}
+
+bool GraphicsContext::recreate_swapchain()
+{
+    auto retired{ m_swapchain->recreate() };
+    if (!retired.has_value()) {
+        return false;
+    }
+    // Frames in flight may still use the old handles, they are destroyed once done
+    for (auto& view : retired->imageViews) {
+        m_deletionQueue.retire(view, m_frameNumber);
+    }
+    if (retired->swapchain) {
+        m_deletionQueue.retire(retired->swapchain, m_frameNumber);
+    }
+    for (auto& image : retired->offscreenImages) {
+        m_deletionQueue.retire(std::move(image), m_frameNumber);
+    }
+
+    retire_size_dependent_resources();
+    create_size_dependent_resources();
+
+    vk::Extent2D extent{ m_swapchain->get_extent() };
+    EC_LOG_INFO("Swapchain recreated with extent {}x{}, {} images and {} present mode",
+                extent.width,
+                extent.height,
+                m_swapchain->get_num_images(),
+                vk::to_string(m_swapchain->get_present_mode()));
+    return true;
+}
+
+bool GraphicsContext::acquire_swapchain_image()
+{
+    Timer blockedTimer{};
+    auto& imageAvailableSemaphore{ m_frames[m_currentFrameIdx].imageAvailableSemaphore };
+    if (m_swapchain->is_out_of_date() && !recreate_swapchain()) {
+        return false;
+    }
+    vk::Result acquireResult{
+        m_swapchain->acquire_next_image(imageAvailableSemaphore, m_acquiredSwapchainImage)
+    };
+    if (acquireResult == vk::Result::eErrorOutOfDateKHR) {
+        // Nothing was signaled, so the semaphore can be used again after recreating
+        if (!recreate_swapchain()
+            || m_swapchain->acquire_next_image(imageAvailableSemaphore, m_acquiredSwapchainImage)
+                   == vk::Result::eErrorOutOfDateKHR) {
+            return false;
+        }
     }
+    m_blockedTime += blockedTimer.get_elapsed_time();
+    return true;
 }
 
 void GraphicsContext::create_framebuffers()
 {
-    m_framebuffers.resize(m_swapchain->get_num_images());
-    // i = image idx in swapchain
+    m_framebuffers.resize(get_num_render_targets());
+    // i = render target idx (swapchain image, or frame in flight with record-ahead)
     // j = attachment idx in the framebuffer
     for (size_t i = 0; i < m_framebuffers.size(); ++i) {
         std::vector<vk::ImageView> attachments(m_framebufferImages[i].size());
         for (size_t j = 0; j < attachments.size(); ++j) {
-            if (j == m_swapchainAttachmentIndex) {
-                attachments[j]
-                    = m_swapchain->get_image(static_cast<uint32_t>(i)).image.get_image_view();
-            } else {
-                attachments[j] = m_framebufferImages[i][j].get_image_view();
-            }
+            const Image& image{
+                get_attachment_image(static_cast<uint32_t>(i), static_cast<uint32_t>(j))
+            };
+            attachments[j] = image.get_image_view();
         }
 
         vk::Extent2D swapchainExtent{ (*m_swapchain).get_extent() };
@@ -389,7 +1010,7 @@ void GraphicsContext::create_command_buffers()
         vk::CommandBufferAllocateInfo commandBufferAllocateInfo{
             .commandPool        = frame.commandPool,
             .level              = vk::CommandBufferLevel::ePrimary,
-            .commandBufferCount = 1,
+            .commandBufferCount = m_recordAhead ? 2u : 1u,
         };
         frame.commandBuffers = m_device.allocateCommandBuffers(commandBufferAllocateInfo);
     }
@@ -400,9 +1021,76 @@ void GraphicsContext::create_frame_synchronization()
     for (auto& frame : m_frames) {
         frame.imageAvailableSemaphore = m_device.createSemaphore({});
         frame.imageRenderedSemaphore  = m_device.createSemaphore({});
-        frame.imageRenderedFence      = m_device.createFence(vk::FenceCreateInfo{
-                 .flags = vk::FenceCreateFlagBits::eSignaled,
-        });
+    }
+    m_timeline = QueueTimeline{ m_device };
+}
+
+void GraphicsContext::create_timestamp_query_pool()
+{
+    if (m_timestampPeriod <= 0.f) {
+        return;
+    }
+    m_timestampQueryPool = m_device.createQueryPool(vk::QueryPoolCreateInfo{
+        .queryType  = vk::QueryType::eTimestamp,
+        .queryCount = 2 * MAX_RENDERING_FRAMES,
+    });
+}
+
+void GraphicsContext::set_frames_in_flight(uint32_t framesInFlight)
+{
+    m_framesInFlight = std::clamp(framesInFlight, 1u, MAX_RENDERING_FRAMES);
+}
+
+void GraphicsContext::enable_adaptive_latency(float targetFrameRate)
+{
+    if (targetFrameRate <= 0.f) {
+        throw std::runtime_error("The target frame rate must be positive!");
+    }
+    m_latencyController.emplace(
+        LatencyController::Info{
+            .targetFrameTime    = 1.f / targetFrameRate,
+            .maxFramesInFlight  = MAX_RENDERING_FRAMES,
+            .maxSwapchainImages = MAX_RENDERING_FRAMES + 1,
+        },
+        m_framesInFlight);
+}
+
+void GraphicsContext::update_frame_timings(uint32_t frameIndex)
+{
+    auto& frame{ m_frames[frameIndex] };
+    if (frame.timestampsWritten) {
+        // The frame is done, so the results are available without waiting
+        auto queryResults{ m_device.getQueryPoolResults<uint64_t>(m_timestampQueryPool,
+                                                                  2 * frameIndex,
+                                                                  2,
+                                                                  2 * sizeof(uint64_t),
+                                                                  sizeof(uint64_t),
+                                                                  vk::QueryResultFlagBits::e64) };
+        const auto& timestamps{ queryResults.value };
+        if (queryResults.result == vk::Result::eSuccess && timestamps[1] >= timestamps[0]) {
+            m_frameTimings.gpuTime
+                = static_cast<float>(static_cast<double>(timestamps[1] - timestamps[0])
+                                     * m_timestampPeriod * 1e-9);
+        }
+        frame.timestampsWritten = false;
+    }
+}
+
+void GraphicsContext::add_latency_sample()
+{
+    if (!m_latencyController || m_frameNumber == 0) {
+        return;
+    }
+    auto depth{ m_latencyController->add_sample(m_frameTimings.cpuTime, m_frameTimings.gpuTime) };
+    if (depth) {
+        set_frames_in_flight(depth->framesInFlight);
+        set_swapchain_image_count(depth->swapchainImages);
+        EC_LOG_INFO("Adaptive latency: {} frames in flight, {} swapchain images (CPU {:.2f} ms, "
+                    "GPU {:.2f} ms)",
+                    depth->framesInFlight,
+                    depth->swapchainImages,
+                    m_frameTimings.cpuTime * 1000.f,
+                    m_frameTimings.gpuTime * 1000.f);
     }
 }
 
@@ -413,28 +1101,43 @@ void GraphicsContext::submit_command_buffer(uint32_t frameIndex)
         .stageMask = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
     };
 
-    vk::SemaphoreSubmitInfo signalSemaphoreInfo{
-        .semaphore = m_frames[frameIndex].imageRenderedSemaphore,
-        .stageMask = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+    uint64_t timelineValue{ m_timeline.next_value() };
+    EC_ASSERT(timelineValue == m_frameNumber + 1);
+    // Present waits for the readback copy and its layout transitions too
+    using Stage = vk::PipelineStageFlagBits2;
+    vk::PipelineStageFlags2 renderedStages{ m_readbackActive ? Stage::eAllCommands
+                                                             : Stage::eColorAttachmentOutput };
+    std::array<vk::SemaphoreSubmitInfo, 2> signalSemaphoreInfos{
+        // All commands, the readback copy is recorded after rendering
+        m_timeline.signal_info(timelineValue),
+        vk::SemaphoreSubmitInfo{
+            .semaphore = m_frames[frameIndex].imageRenderedSemaphore,
+            .stageMask = renderedStages,
+        },
     };
 
     vk::CommandBufferSubmitInfo commandBufferInfo{
         .commandBuffer = m_frames[frameIndex].commandBuffers[0],
     };
 
+    // Headless swapchains neither signal on acquire nor wait on present
+    uint32_t binarySemaphoreCount{ m_swapchain->is_headless() ? 0u : 1u };
     vk::SubmitInfo2 submitInfo{
-        .waitSemaphoreInfoCount   = 1,
+        .waitSemaphoreInfoCount   = binarySemaphoreCount,
         .pWaitSemaphoreInfos      = &waitSemaphoreInfo,
         .commandBufferInfoCount   = 1,
         .pCommandBufferInfos      = &commandBufferInfo,
-        .signalSemaphoreInfoCount = 1,
-        .pSignalSemaphoreInfos    = &signalSemaphoreInfo,
+        .signalSemaphoreInfoCount = 1 + binarySemaphoreCount,
+        .pSignalSemaphoreInfos    = signalSemaphoreInfos.data(),
     };
-    m_graphicsQueue.submit2(submitInfo, m_frames[frameIndex].imageRenderedFence);
+    m_graphicsQueue.submit2(submitInfo);
 }
 
 void GraphicsContext::present(uint32_t frameIndex, uint32_t imageIndex)
 {
+    if (m_swapchain->is_headless()) {
+        return;
+    }
     vk::SwapchainKHR swapchain{ m_swapchain->get_handle() };
     vk::PresentInfoKHR presentInfo{
         .waitSemaphoreCount = 1,
@@ -444,8 +1147,166 @@ void GraphicsContext::present(uint32_t frameIndex, uint32_t imageIndex)
         .pImageIndices      = &imageIndex,
     };
 
-    // TODO: Use return value to resize window
-    std::ignore = m_graphicsQueue.presentKHR(presentInfo);
+    // Recreated at the beginning of the next frame. The wait on the semaphore still happens when
+    // presentation fails, so it can be signaled again
+    try {
+        if (m_graphicsQueue.presentKHR(presentInfo) == vk::Result::eSuboptimalKHR) {
+            m_swapchain->mark_out_of_date();
+        }
+    }
+    catch (const vk::OutOfDateKHRError&) {
+        m_swapchain->mark_out_of_date();
+    }
+}
+
+void GraphicsContext::submit_and_present_ahead(uint32_t frameIndex)
+{
+    auto& frame{ m_frames[frameIndex] };
+
+    // The GPU starts on the frame while the CPU waits for the swapchain image
+    vk::CommandBufferSubmitInfo frameCommandBufferInfo{
+        .commandBuffer = frame.commandBuffers[0],
+    };
+    m_graphicsQueue.submit2(vk::SubmitInfo2{
+        .commandBufferInfoCount = 1,
+        .pCommandBufferInfos    = &frameCommandBufferInfo,
+    });
+
+    // Taken before acquiring, recreating the swapchain replaces the render targets
+    vk::Image renderTarget{
+        get_attachment_image(get_render_target_index(), m_swapchainAttachmentIndex).get_image()
+    };
+    vk::Extent2D renderTargetExtent{ m_swapchain->get_extent() };
+
+    bool acquired{ acquire_swapchain_image() };
+    auto& copyCommandBuffer{ frame.commandBuffers[1] };
+    if (acquired) {
+        copyCommandBuffer.begin(vk::CommandBufferBeginInfo{
+            .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+        });
+        record_swapchain_copy(copyCommandBuffer, renderTarget, renderTargetExtent);
+        copyCommandBuffer.end();
+    }
+
+    // The timeline value is signaled even if nothing can be presented (e.g. minimized window)
+    uint64_t timelineValue{ m_timeline.next_value() };
+    EC_ASSERT(timelineValue == m_frameNumber + 1);
+    vk::SemaphoreSubmitInfo waitSemaphoreInfo{
+        .semaphore = frame.imageAvailableSemaphore,
+        .stageMask = vk::PipelineStageFlagBits2::eTransfer,
+    };
+    std::array<vk::SemaphoreSubmitInfo, 2> signalSemaphoreInfos{
+        m_timeline.signal_info(timelineValue),
+        vk::SemaphoreSubmitInfo{
+            .semaphore = frame.imageRenderedSemaphore,
+            .stageMask = vk::PipelineStageFlagBits2::eTransfer,
+        },
+    };
+    vk::CommandBufferSubmitInfo copyCommandBufferInfo{
+        .commandBuffer = copyCommandBuffer,
+    };
+    uint32_t copyCount{ acquired ? 1u : 0u };
+    m_graphicsQueue.submit2(vk::SubmitInfo2{
+        .waitSemaphoreInfoCount   = copyCount,
+        .pWaitSemaphoreInfos      = &waitSemaphoreInfo,
+        .commandBufferInfoCount   = copyCount,
+        .pCommandBufferInfos      = &copyCommandBufferInfo,
+        .signalSemaphoreInfoCount = 1 + copyCount,
+        .pSignalSemaphoreInfos    = signalSemaphoreInfos.data(),
+    });
+
+    if (acquired) {
+        present(frameIndex, m_acquiredSwapchainImage);
+    }
+}
+
+void GraphicsContext::record_swapchain_copy(vk::CommandBuffer commandBuffer,
+                                            vk::Image sourceImage,
+                                            vk::Extent2D sourceExtent)
+{
+    vk::ImageSubresourceRange colorRange{
+        .aspectMask = vk::ImageAspectFlagBits::eColor,
+        .levelCount = 1,
+        .layerCount = 1,
+    };
+    vk::Image swapchainImage{ m_swapchain->get_image(m_acquiredSwapchainImage).image.get_image() };
+    vk::Extent2D swapchainExtent{ m_swapchain->get_extent() };
+
+    std::array<vk::ImageMemoryBarrier2, 2> toTransfer{
+        // Already in the layout, but render passes may not make the writes visible to transfers
+        vk::ImageMemoryBarrier2{
+            .srcStageMask        = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+            .srcAccessMask       = vk::AccessFlagBits2::eColorAttachmentWrite,
+            .dstStageMask        = vk::PipelineStageFlagBits2::eTransfer,
+            .dstAccessMask       = vk::AccessFlagBits2::eTransferRead,
+            .oldLayout           = vk::ImageLayout::eTransferSrcOptimal,
+            .newLayout           = vk::ImageLayout::eTransferSrcOptimal,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image               = sourceImage,
+            .subresourceRange    = colorRange,
+        },
+        layout_transition_barrier(swapchainImage,
+                                  vk::ImageLayout::eUndefined,
+                                  vk::ImageLayout::eTransferDstOptimal,
+                                  colorRange),
+    };
+    commandBuffer.pipelineBarrier2(vk::DependencyInfo{
+        .imageMemoryBarrierCount = static_cast<uint32_t>(toTransfer.size()),
+        .pImageMemoryBarriers    = toTransfer.data(),
+    });
+
+    vk::ImageSubresourceLayers colorLayers{
+        .aspectMask = vk::ImageAspectFlagBits::eColor,
+        .layerCount = 1,
+    };
+    // Same format, so a plain copy unless the swapchain was resized after recording
+    if (sourceExtent == swapchainExtent) {
+        vk::ImageCopy region{
+            .srcSubresource = colorLayers,
+            .dstSubresource = colorLayers,
+            .extent         = { swapchainExtent.width, swapchainExtent.height, 1 },
+        };
+        commandBuffer.copyImage(sourceImage,
+                                vk::ImageLayout::eTransferSrcOptimal,
+                                swapchainImage,
+                                vk::ImageLayout::eTransferDstOptimal,
+                                region);
+    } else {
+        vk::ImageBlit region{
+            .srcSubresource = colorLayers,
+            .srcOffsets     = std::array<vk::Offset3D, 2>{
+                vk::Offset3D{},
+                vk::Offset3D{ static_cast<int32_t>(sourceExtent.width),
+                              static_cast<int32_t>(sourceExtent.height),
+                              1 },
+            },
+            .dstSubresource = colorLayers,
+            .dstOffsets     = std::array<vk::Offset3D, 2>{
+                vk::Offset3D{},
+                vk::Offset3D{ static_cast<int32_t>(swapchainExtent.width),
+                              static_cast<int32_t>(swapchainExtent.height),
+                              1 },
+            },
+        };
+        commandBuffer.blitImage(sourceImage,
+                                vk::ImageLayout::eTransferSrcOptimal,
+                                swapchainImage,
+                                vk::ImageLayout::eTransferDstOptimal,
+                                region,
+                                vk::Filter::eLinear);
+    }
+
+    vk::ImageMemoryBarrier2 toPresent{
+        layout_transition_barrier(swapchainImage,
+                                  vk::ImageLayout::eTransferDstOptimal,
+                                  vk::ImageLayout::ePresentSrcKHR,
+                                  colorRange),
+    };
+    commandBuffer.pipelineBarrier2(vk::DependencyInfo{
+        .imageMemoryBarrierCount = 1,
+        .pImageMemoryBarriers    = &toPresent,
+    });
 }
 
 bool GraphicsContext::is_swapchain_compatible(const vk::AttachmentDescription& attachment)
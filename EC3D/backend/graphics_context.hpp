@@ -5,6 +5,12 @@
 #include "swapchain.hpp"
 #include "pipeline.hpp"
 #include "buffer.hpp"
+#include "uniform_ring.hpp"
+#include "deletion_queue.hpp"
+#include "frame_readback.hpp"
+#include "queue_timeline.hpp"
+#include "latency_controller.hpp"
+#include "misc/timer.hpp"
 
 namespace ec::vulkan
 {
@@ -44,18 +50,47 @@ struct RenderPassInfo {
     std::vector<DependencyInfo> dependencies;
 };
 
+// Attachments for dynamic rendering (no VkRenderPass/VkFramebuffer). The swapchain attachment is
+// the color attachment with finalLayout ePresentSrcKHR. Layout transitions from initialLayout and
+// to finalLayout are recorded by the context. With a headless swapchain, ePresentSrcKHR is
+// replaced by eTransferSrcOptimal (in render passes too)
+struct RenderingInfo {
+    std::vector<AttachmentInfo> colorAttachments;
+    std::optional<AttachmentInfo> depthAttachment;
+};
+
 class GraphicsContext
 {
 public:
 
-    constexpr static uint32_t MAX_RENDERING_FRAMES{ 2 };
+    // Upper bound of the frames in flight, there is a set of per-frame resources for each
+    constexpr static uint32_t MAX_RENDERING_FRAMES{ 3 };
+    constexpr static uint32_t DEFAULT_FRAMES_IN_FLIGHT{ 2 };
+
+    // Of the last frames measured, in seconds. The CPU time leaves out the time blocked waiting for
+    // the GPU or the swapchain. The GPU time is 0 if timestamps are not supported
+    struct FrameTimings {
+        float cpuTime{};
+        float gpuTime{};
+    };
 
     struct Info {
         vk::Device device;
-        vk::PhysicalDeviceMemoryProperties deviceMemoryProperties;
-        const Swapchain& swapchain;
+        const vk::PhysicalDeviceMemoryProperties& deviceMemoryProperties;
+        Swapchain& swapchain;
         vk::Queue queue;
         uint32_t queueFamilyIndex;
+        vk::DeviceSize minBufferOffsetAlignment;
+        bool bufferDeviceAddress;
+        bool extendedDynamicState;
+        bool dynamicRendering;
+        bool graphicsPipelineLibrary;
+        bool shaderObject;
+        // Record the frame into an intermediate image before acquiring the swapchain image, which
+        // is then only written by a copy. Ignored if headless or if swapchain images can't be
+        // copied to
+        bool recordAhead;
+        float timestampPeriod;  // Nanoseconds per timestamp tick, 0 to disable GPU timings
     };
 
     GraphicsContext() = default;
@@ -67,73 +102,258 @@ public:
 
     void free();
 
+    // Only one of these can be used in a context
     void create_render_pass(const RenderPassInfo& info);
+    void create_dynamic_rendering(const RenderingInfo& info);
 
     // TODO: Create context struct to avoid having unnecessary fields when calling this function
     uint32_t create_pipeline(GraphicsPipelineInfo& info);
+    inline uint32_t get_pipeline_variant(uint32_t baseIndex, const PipelineVariantInfo& info)
+    {
+        return m_pipelineManager.get_pipeline_variant(baseIndex, info);
+    }
+
+    // Per-frame constant data, reset at the beginning of each frame. Allocations can be bound with
+    // dynamic offsets or read through buffer device addresses
+    UniformRing& create_uniform_ring(vk::DeviceSize bytesPerFrame);
+    UniformRing& get_uniform_ring() { return m_uniformRing.value(); }
+
+    // Copies the presented (or headless offscreen) image of every following frame to host memory.
+    // callback is called from begin_rendering MAX_RENDERING_FRAMES frames later, when the copy is
+    // done, so the GPU never waits. The pixels are only valid during the call
+    void start_readback(ReadbackCallback callback);
+    // Waits for the frames in flight and delivers their pixels before returning
+    void stop_readback();
 
     inline void set_clear_value(uint32_t attachmentIndex, VkClearValue& clearValue)
     {
         m_renderPassInfo.attachments[attachmentIndex].clearValue = clearValue;
     };
 
-    // Rendering commands
-    void begin_rendering();
+    // Rendering commands. begin_rendering recreates the swapchain if it is out of date, and
+    // returns false if there is nothing to render to (e.g. minimized window). In that case the
+    // frame must be skipped, without calling end_rendering. With record-ahead, the swapchain image
+    // is acquired in end_rendering, after the frame has been submitted
+    bool begin_rendering();
     void end_rendering();
 
+    // Viewport and scissor are reset to the whole render area at the beginning of each frame
+    void set_viewport(const vk::Viewport& viewport);
+    void set_scissor(const vk::Rect2D& scissor);
+
+    // Extended dynamic state, only available if supported by the device. Binding a pipeline
+    // resets these to the values in its GraphicsPipelineInfo
+    void set_cull_mode(vk::CullModeFlags cullMode);
+    void set_front_face(vk::FrontFace frontFace);
+    void set_primitive_topology(vk::PrimitiveTopology topology);
+    void set_depth_test(vk::Bool32 testEnable, vk::Bool32 writeEnable, vk::CompareOp compareOp);
+
     void bind_pipeline(uint32_t pipelineIndex);
     void bind_vertex_buffers(const std::vector<Buffer>& buffers);
     void bind_index_buffer(const Buffer& buffer);
-    void bind_descriptor_set();
-    void draw_indexed(uint32_t vertexCount);
+    // Reads the buffer as indices of indexType instead of its own, e.g. for index pools
+    void bind_index_buffer(const Buffer& buffer, vk::IndexType indexType);
+    // dynamicOffsets must contain one offset per dynamic binding in the set, in binding order
+    void bind_descriptor_set(uint32_t pipelineIndex,
+                             uint32_t setIndex,
+                             vk::DescriptorSet descriptorSet,
+                             const std::vector<uint32_t>& dynamicOffsets = {});
+    // The range must match one reflected from the shaders of the pipeline
+    void push_constants(uint32_t pipelineIndex,
+                        vk::ShaderStageFlags stages,
+                        uint32_t offset,
+                        uint32_t size,
+                        const void* data);
+    // firstIndex and vertexOffset select a range of the bound index and vertex buffers
+    void draw_indexed(uint32_t indexCount, uint32_t firstIndex = 0, int32_t vertexOffset = 0);
+
+    // Size of the attachments, which changes when the swapchain is recreated
+    vk::Extent2D get_render_extent() const { return m_swapchain->get_extent(); }
+
+    // Blocks until all the submitted work is done
+    void wait_idle();
+
+    // Frames the CPU can record before waiting for the GPU, including the one being recorded.
+    // Fewer frames mean less latency, but less overlap between CPU and GPU work
+    void set_frames_in_flight(uint32_t framesInFlight);
+    uint32_t get_frames_in_flight() const { return m_framesInFlight; }
+    // The swapchain is recreated at the beginning of the next frame
+    void set_swapchain_image_count(uint32_t imageCount)
+    {
+        m_swapchain->set_image_count(imageCount);
+    }
+    // Also recreates the swapchain at the beginning of the next frame, FIFO if not supported
+    void set_present_mode(vk::PresentModeKHR presentMode)
+    {
+        m_swapchain->set_present_mode(presentMode);
+    }
+    std::vector<vk::PresentModeKHR> get_supported_present_modes() const
+    {
+        return m_swapchain->get_supported_present_modes();
+    }
+    vk::PresentModeKHR get_present_mode() const { return m_swapchain->get_present_mode(); }
+
+    // Every few frames, picks the frames in flight and swapchain images with the least latency
+    // that still reach targetFrameRate, from the measured frame timings
+    void enable_adaptive_latency(float targetFrameRate);
+    void disable_adaptive_latency() { m_latencyController.reset(); }
+
+    const FrameTimings& get_frame_timings() const { return m_frameTimings; }
+
+    // Frames are numbered from 0 in the order they are begun. Frame n is done on the GPU once the
+    // graphics queue timeline reaches n + 1
+    uint64_t get_frame_number() const { return m_frameNumber; }
+    bool is_frame_complete(uint64_t frameNumber) { return m_timeline.is_complete(frameNumber + 1); }
+    void wait_for_frame(uint64_t frameNumber) { m_timeline.wait(frameNumber + 1); }
+    // Destroys the image once the frames begun so far are done with it, e.g. a replaced texture
+    void retire_image(Image&& image) { m_deletionQueue.retire(std::move(image), m_frameNumber); }
+    // For submissions to other queues that consume the results of a frame
+    vk::SemaphoreSubmitInfo get_frame_wait_info(uint64_t frameNumber,
+                                                vk::PipelineStageFlags2 stage) const
+    {
+        return m_timeline.wait_info(frameNumber + 1, stage);
+    }
+
+    bool uses_shader_objects() const { return m_pipelineManager.uses_shader_objects(); }
+    bool samples_images(uint32_t pipelineIndex) const
+    {
+        return m_pipelineManager.samples_images(pipelineIndex);
+    }
+    // If false, set_cull_mode and the other extended dynamic state setters can't be used
+    bool has_extended_dynamic_state() const
+    {
+        return m_pipelineManager.has_extended_dynamic_state();
+    }
 
 private:
 
-    void create_framebuffer_image(vk::Format format,
-                                  vk::ImageUsageFlags usage,
-                                  vk::SampleCountFlagBits samples,
-                                  vk::ImageLayout layout,
-                                  vk::ImageAspectFlags aspect);
+    struct FramebufferImageInfo {
+        vk::Format format{};
+        vk::SampleCountFlagBits samples{};
+        vk::ImageLayout initialLayout{};
+        vk::ImageUsageFlags usage{};
+        vk::ImageAspectFlags aspect{};
+        bool isSwapchainImage{};
+    };
+
+    Image create_framebuffer_image(const FramebufferImageInfo& info);
     void create_framebuffers();
 
+    // Attachment images and framebuffers, sized like the swapchain
+    void create_size_dependent_resources();
+    void retire_size_dependent_resources();
+    bool recreate_swapchain();
+    // Recreates the swapchain if needed. False if no image could be acquired
+    bool acquire_swapchain_image();
+
+    // Render targets are the swapchain images, or the frames in flight with record-ahead
+    uint32_t get_render_target_index() const
+    {
+        return m_recordAhead ? m_currentFrameIdx : m_acquiredSwapchainImage;
+    }
+    size_t get_num_render_targets() const
+    {
+        return m_recordAhead ? MAX_RENDERING_FRAMES : m_swapchain->get_num_images();
+    }
+    // The swapchain attachment is a swapchain image unless recording ahead
+    bool owns_attachment_image(size_t attachmentIndex) const
+    {
+        return attachmentIndex != m_swapchainAttachmentIndex || m_recordAhead;
+    }
+
+    void create_frame_resources();
     void create_frame_synchronization();
+    void create_timestamp_query_pool();
     void create_command_pool();
     void create_command_buffers();
 
+    // Shader objects have no baked state, everything in the GraphicsPipelineInfo is set here
+    void bind_shader_objects(uint32_t pipelineIndex);
+
+    void begin_render_pass(vk::CommandBuffer commandBuffer);
+    void begin_dynamic_rendering(vk::CommandBuffer commandBuffer);
+    void end_dynamic_rendering(vk::CommandBuffer commandBuffer);
+    const Image& get_attachment_image(uint32_t renderTargetIndex, uint32_t attachmentIndex) const;
+    vk::ImageLayout get_final_layout(const AttachmentInfo& attachment) const;
+
+    // Called once the frame that last used the slot is done
+    void update_frame_timings(uint32_t frameIndex);
+    // Feeds the current timings to the latency controller, only for frames that are rendered
+    void add_latency_sample();
+
     void submit_command_buffer(uint32_t frameIndex);
     void present(uint32_t frameIndex, uint32_t imageIndex);
 
+    // Record-ahead: submits the recorded frame, then acquires and copies to the swapchain image
+    void submit_and_present_ahead(uint32_t frameIndex);
+    void record_swapchain_copy(vk::CommandBuffer commandBuffer,
+                               vk::Image sourceImage,
+                               vk::Extent2D sourceExtent);
+
 private:
 
     // External
     vk::Device m_device;
     const vk::PhysicalDeviceMemoryProperties* m_deviceMemoryProperties;
-    const Swapchain* m_swapchain;
+    Swapchain* m_swapchain;
 
     vk::Queue m_graphicsQueue;
     uint32_t m_graphicsQueueIndex;
 
+    enum class Mode {
+        renderPass,
+        dynamicRendering,
+    } m_mode{};
+    bool m_dynamicRendering{};  // Supported by the device
+    bool m_recordAhead{};
+
     // Render pass
     vk::RenderPass m_renderPass{};
-    RenderPassInfo m_renderPassInfo{};
+    RenderPassInfo m_renderPassInfo{};  // With dynamic rendering, only attachments {color, depth}
+    uint32_t m_numColorAttachments{};   // Dynamic rendering only
 
-    std::vector<std::vector<Image>> m_framebufferImages{};  // {color, depth, ...} * swapchain img
+    std::vector<FramebufferImageInfo> m_framebufferImageInfos{};  // Kept for swapchain recreation
+    std::vector<std::vector<Image>> m_framebufferImages{};  // {color, depth, ...} * render target
     uint32_t m_swapchainAttachmentIndex{};  // Index of the attachment in m_framebufferImages
     std::vector<vk::Framebuffer> m_framebuffers{};
 
     // Pipeline
     PipelineManager m_pipelineManager{};
 
+    // Per-frame data
+    vk::DeviceSize m_minBufferOffsetAlignment{};
+    bool m_bufferDeviceAddress{};
+    std::optional<UniformRing> m_uniformRing{};
+
     // Per frame-in-flight
-    uint32_t m_currentFrameIdx{};
+    uint32_t m_currentFrameIdx{};  // Cycles through all the MAX_RENDERING_FRAMES slots
+    uint32_t m_framesInFlight{ DEFAULT_FRAMES_IN_FLIGHT };
+    uint64_t m_frameNumber{};  // Frames begun so far, for deferred destruction
+    QueueTimeline m_timeline{};  // Only signaled by frame submissions, frame n signals n + 1
+
+    DeletionQueue m_deletionQueue{};
+
+    std::optional<FrameReadback> m_readback{};
+    ReadbackCallback m_readbackCallback{};
+    bool m_readbackActive{};
+
+    // Frame timings
+    float m_timestampPeriod{};
+    vk::QueryPool m_timestampQueryPool{};  // {begin, end} * frame slot
+    Timer m_frameTimer{};
+    float m_blockedTime{};  // Waiting for the GPU or the swapchain in the current frame
+    bool m_skippedFrame{};  // The previous begin_rendering returned false
+    FrameTimings m_frameTimings{};
+    std::optional<LatencyController> m_latencyController{};
 
     struct FrameData {
+        // Binary, presentation can't use timeline semaphores
         vk::Semaphore imageAvailableSemaphore{};
         vk::Semaphore imageRenderedSemaphore{};
-        vk::Fence imageRenderedFence{};
 
         vk::CommandPool commandPool{};
-        std::vector<vk::CommandBuffer> commandBuffers{};
+        std::vector<vk::CommandBuffer> commandBuffers{};  // {frame, swapchain copy (record-ahead)}
+        bool timestampsWritten{};
     };
 
     std::array<FrameData, MAX_RENDERING_FRAMES> m_frames{};
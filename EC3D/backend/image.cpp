@@ -2,6 +2,9 @@
 #include "image.hpp"
 #include "utils.hpp"
 
+#include <algorithm>
+#include <bit>
+
 namespace ec::vulkan
 {
 
@@ -27,9 +30,16 @@ Image::Image(const vk::Device device, const Image::Info& info) :
 vk::ImageView Image::create_view(vk::Format format, vk::ImageAspectFlags aspectFlags)
 {
     EC_ASSERT(m_image);
+    vk::ImageViewType viewType{ m_arrayLayers > 1 ? vk::ImageViewType::e2DArray
+                                                  : vk::ImageViewType::e2D };
+    if (m_type == Image::Type::image3D) {
+        viewType = vk::ImageViewType::e3D;
+    } else if (m_type == Image::Type::imageCube) {
+        viewType = m_arrayLayers > 6 ? vk::ImageViewType::eCubeArray : vk::ImageViewType::eCube;
+    }
     vk::ImageViewCreateInfo imageViewCreateInfo{
         .image    = m_image,
-        .viewType = vk::ImageViewType::e2D,
+        .viewType = viewType,
         .format   = format,
         .components{
                     .r = vk::ComponentSwizzle::eR,
@@ -40,9 +50,9 @@ vk::ImageView Image::create_view(vk::Format format, vk::ImageAspectFlags aspectF
         .subresourceRange{
                     .aspectMask     = aspectFlags,
                     .baseMipLevel   = 0,
-                    .levelCount     = 1,
+                    .levelCount     = m_mipLevels,
                     .baseArrayLayer = 0,
-                    .layerCount     = 1,
+                    .layerCount     = m_arrayLayers,
                     },
     };
     try {
@@ -63,6 +73,98 @@ void Image::delete_view()
     }
 }
 
+void Image::record_mipmap_generation(vk::CommandBuffer commandBuffer,
+                                     vk::ImageLayout oldLayout,
+                                     vk::ImageLayout newLayout,
+                                     vk::Filter filter) const
+{
+    EC_ASSERT(m_image);
+    auto levelRange{ [&](uint32_t baseLevel, uint32_t levelCount) {
+        return vk::ImageSubresourceRange{
+            .aspectMask     = vk::ImageAspectFlagBits::eColor,
+            .baseMipLevel   = baseLevel,
+            .levelCount     = levelCount,
+            .baseArrayLayer = 0,
+            .layerCount     = m_arrayLayers,
+        };
+    } };
+    auto pipelineBarrier{ [&](const std::vector<vk::ImageMemoryBarrier2>& barriers) {
+        commandBuffer.pipelineBarrier2(vk::DependencyInfo{
+            .imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size()),
+            .pImageMemoryBarriers    = barriers.data(),
+        });
+    } };
+
+    if (m_mipLevels == 1) {
+        if (oldLayout != newLayout) {
+            pipelineBarrier(
+                { layout_transition_barrier(m_image, oldLayout, newLayout, levelRange(0, 1)) });
+        }
+        return;
+    }
+
+    // Level 0 is only read, the rest are written once and then read by the next blit
+    pipelineBarrier({
+        layout_transition_barrier(m_image,
+                                  oldLayout,
+                                  vk::ImageLayout::eTransferSrcOptimal,
+                                  levelRange(0, 1)),
+        layout_transition_barrier(m_image,
+                                  vk::ImageLayout::eUndefined,
+                                  vk::ImageLayout::eTransferDstOptimal,
+                                  levelRange(1, m_mipLevels - 1)),
+    });
+
+    auto levelOffset{ [&](uint32_t level) {
+        vk::Extent3D levelExtent{ mip_level_extent(m_extent, level) };
+        return vk::Offset3D{
+            .x = static_cast<int32_t>(levelExtent.width),
+            .y = static_cast<int32_t>(levelExtent.height),
+            .z = static_cast<int32_t>(levelExtent.depth),
+        };
+    } };
+    for (uint32_t level = 1; level < m_mipLevels; ++level) {
+        auto layers{ [&](uint32_t mipLevel) {
+            return vk::ImageSubresourceLayers{
+                .aspectMask     = vk::ImageAspectFlagBits::eColor,
+                .mipLevel       = mipLevel,
+                .baseArrayLayer = 0,
+                .layerCount     = m_arrayLayers,
+            };
+        } };
+        vk::ImageBlit2 blitRegion{
+            .srcSubresource = layers(level - 1),
+            .srcOffsets     = std::array{ vk::Offset3D{}, levelOffset(level - 1) },
+            .dstSubresource = layers(level),
+            .dstOffsets     = std::array{ vk::Offset3D{}, levelOffset(level) },
+        };
+        commandBuffer.blitImage2(vk::BlitImageInfo2{
+            .srcImage       = m_image,
+            .srcImageLayout = vk::ImageLayout::eTransferSrcOptimal,
+            .dstImage       = m_image,
+            .dstImageLayout = vk::ImageLayout::eTransferDstOptimal,
+            .regionCount    = 1,
+            .pRegions       = &blitRegion,
+            .filter         = filter,
+        });
+        // The next blit reads this level
+        pipelineBarrier({ layout_transition_barrier(m_image,
+                                                    vk::ImageLayout::eTransferDstOptimal,
+                                                    vk::ImageLayout::eTransferSrcOptimal,
+                                                    levelRange(level, 1)) });
+    }
+
+    pipelineBarrier({ layout_transition_barrier(m_image,
+                                                vk::ImageLayout::eTransferSrcOptimal,
+                                                newLayout,
+                                                levelRange(0, m_mipLevels)) });
+}
+
+uint32_t Image::get_max_mip_levels(uint32_t width, uint32_t height, uint32_t depth)
+{
+    return static_cast<uint32_t>(std::bit_width(std::max({ width, height, depth, 1u })));
+}
+
 void Image::free()
 {
     delete_view();
@@ -78,17 +180,27 @@ void Image::free()
 
 void Image::create(const Image::Info& info)
 {
-    // TODO: Fix hard-coded parameters
+    EC_ASSERT(info.mipLevels >= 1
+              && info.mipLevels <= get_max_mip_levels(info.width, info.height, info.depth));
+    EC_ASSERT(info.type == Image::Type::image3D ? info.arrayLayers == 1 : info.depth == 1);
+    EC_ASSERT(info.type != Image::Type::imageCube
+              || (info.width == info.height && info.arrayLayers % 6 == 0));
+    m_format      = info.format;
+    m_usage       = info.usage;
+    m_extent      = vk::Extent3D{ .width = info.width, .height = info.height, .depth = info.depth };
+    m_mipLevels   = info.mipLevels;
+    m_arrayLayers = info.arrayLayers;
+    m_type        = info.type;
+
+    bool cube{ info.type == Image::Type::imageCube };
+    bool volume{ info.type == Image::Type::image3D };
     vk::ImageCreateInfo imageCreateInfo{
-        .imageType = vk::ImageType::e2D,
-        .format    = info.format,
-        .extent{
-                .width  = info.width,
-                .height = info.height,
-                .depth  = 1,
-                },
-        .mipLevels     = 1,
-        .arrayLayers   = 1,
+        .flags         = cube ? vk::ImageCreateFlagBits::eCubeCompatible : vk::ImageCreateFlags{},
+        .imageType     = volume ? vk::ImageType::e3D : vk::ImageType::e2D,
+        .format        = info.format,
+        .extent        = m_extent,
+        .mipLevels     = m_mipLevels,
+        .arrayLayers   = m_arrayLayers,
         .samples       = info.samples,
         .tiling        = vk::ImageTiling::eOptimal,
         .usage         = info.usage,
@@ -3,6 +3,9 @@
 #include <vulkan/vulkan.hpp>
 #include <vma/vk_mem_alloc.h>
 
+#include <span>
+#include <vector>
+
 namespace ec::vulkan
 {
 
@@ -10,9 +13,19 @@ class Image
 {
 public:
 
+    enum class Type {
+        image2D,
+        imageCube,  // 2D layers grouped in sixes, viewed as cubes
+        image3D,
+    };
+
     struct Info {
         uint32_t width;
         uint32_t height;
+        uint32_t depth{ 1 };        // Only for 3D images
+        uint32_t mipLevels{ 1 };    // Use get_max_mip_levels for a full chain
+        uint32_t arrayLayers{ 1 };  // Multiple of 6 for cube maps
+        Image::Type type{ Image::Type::image2D };
         vk::Format format;
         vk::ImageUsageFlags usage;
         vk::SampleCountFlagBits samples;
@@ -30,11 +43,29 @@ public:
     Image& operator=(const Image&) = default;
     Image& operator=(Image&&)      = default;
 
+    // Covers every mip level and layer, as a cube, array or 3D view depending on the image type
     vk::ImageView create_view(vk::Format format, vk::ImageAspectFlags aspectFlags);
     void delete_view();
 
+    // Fills mip levels 1 and up by blitting each level into the next one. Level 0 of every layer
+    // must be in oldLayout and the rest may be undefined, the whole image ends in newLayout.
+    // Needs a graphics queue, the format must support blits (and linear filtering for eLinear)
+    void record_mipmap_generation(vk::CommandBuffer commandBuffer,
+                                  vk::ImageLayout oldLayout,
+                                  vk::ImageLayout newLayout,
+                                  vk::Filter filter = vk::Filter::eLinear) const;
+
+    // Number of levels down to 1x1x1
+    static uint32_t get_max_mip_levels(uint32_t width, uint32_t height, uint32_t depth = 1);
+
     inline vk::Image get_image() const { return m_image; }
     inline vk::ImageView get_image_view() const { return m_imageView; }
+    inline vk::Format get_format() const { return m_format; }
+    inline vk::ImageUsageFlags get_usage() const { return m_usage; }
+    inline vk::Extent3D get_extent() const { return m_extent; }
+    inline uint32_t get_mip_levels() const { return m_mipLevels; }
+    inline uint32_t get_array_layers() const { return m_arrayLayers; }
+    inline Image::Type get_type() const { return m_type; }
 
     void free();
 
@@ -50,6 +81,24 @@ private:
     vk::DeviceMemory m_imageMemory{};
 
     vk::ImageView m_imageView{};
+
+    vk::Format m_format{};
+    vk::ImageUsageFlags m_usage{};
+    vk::Extent3D m_extent{};
+    uint32_t m_mipLevels{ 1 };
+    uint32_t m_arrayLayers{ 1 };
+    Image::Type m_type{ Image::Type::image2D };
+};
+
+// Pixels of a whole image, as stored in texture files. Levels go from the largest, each with all
+// its layers (or cube faces) tightly packed, as buffer to image copies read them
+struct ImageData {
+    vk::Format format;
+    Image::Type type{ Image::Type::image2D };
+    vk::Extent3D extent;
+    uint32_t mipLevels{ 1 };  // Of the image. With a single level in levels the rest are generated
+    uint32_t arrayLayers{ 1 };
+    std::vector<std::span<const std::byte>> levels{};  // Only read during the transfer
 };
 
 }  // namespace ec::vulkan
@@ -0,0 +1,79 @@
+#include "pch.hpp"
+#include "latency_controller.hpp"
+
+#include <algorithm>
+
+namespace ec::vulkan
+{
+
+LatencyController::LatencyController(const LatencyController::Info& info,
+                                     uint32_t initialFramesInFlight) :
+  m_info{ info }
+{
+    EC_ASSERT(m_info.maxFramesInFlight > 0 && m_info.windowSize > 0);
+    m_depth = get_depth_for(std::clamp(initialFramesInFlight, 1u, m_info.maxFramesInFlight));
+    m_cpuTimes.reserve(m_info.windowSize);
+    m_gpuTimes.reserve(m_info.windowSize);
+}
+
+std::optional<LatencyController::Depth> LatencyController::add_sample(float cpuTime,
+                                                                      float gpuTime)
+{
+    m_cpuTimes.push_back(cpuTime);
+    m_gpuTimes.push_back(gpuTime);
+    if (m_cpuTimes.size() < m_info.windowSize) {
+        return std::nullopt;
+    }
+
+    // Shallowest queue that fits in the target with some headroom, deepest if none does
+    uint32_t framesInFlight{ m_info.maxFramesInFlight };
+    for (uint32_t i = 1; i < m_info.maxFramesInFlight; ++i) {
+        if (predict_frame_time(i) <= m_info.targetFrameTime * m_info.headroom) {
+            framesInFlight = i;
+            break;
+        }
+    }
+    // Only deepen the queue once the current one misses the target, to avoid oscillating
+    if (framesInFlight > m_depth.framesInFlight
+        && predict_frame_time(m_depth.framesInFlight) <= m_info.targetFrameTime) {
+        framesInFlight = m_depth.framesInFlight;
+    }
+
+    m_cpuTimes.clear();
+    m_gpuTimes.clear();
+
+    Depth depth{ get_depth_for(framesInFlight) };
+    if (depth == m_depth) {
+        return std::nullopt;
+    }
+    m_depth = depth;
+    return depth;
+}
+
+LatencyController::Depth LatencyController::get_depth_for(uint32_t framesInFlight) const
+{
+    // One more image than frames in flight, so one can be presented while the others are rendered
+    return Depth{
+        .framesInFlight  = framesInFlight,
+        .swapchainImages = std::clamp(framesInFlight + 1, 2u, m_info.maxSwapchainImages),
+    };
+}
+
+float LatencyController::predict_frame_time(uint32_t framesInFlight)
+{
+    m_scratch.resize(m_cpuTimes.size());
+    for (size_t i = 0; i < m_cpuTimes.size(); ++i) {
+        // Serialized with one frame in flight, overlapped with more
+        m_scratch[i] = framesInFlight == 1 ? m_cpuTimes[i] + m_gpuTimes[i]
+                                           : std::max(m_cpuTimes[i], m_gpuTimes[i]);
+    }
+
+    // Each extra frame in flight absorbs more of the spikes, so a lower percentile is enough
+    float percentile{ framesInFlight <= 2 ? 0.95f : 0.5f };
+    auto nth{ m_scratch.begin()
+              + static_cast<ptrdiff_t>(percentile * static_cast<float>(m_scratch.size() - 1)) };
+    std::nth_element(m_scratch.begin(), nth, m_scratch.end());
+    return *nth;
+}
+
+}  // namespace ec::vulkan
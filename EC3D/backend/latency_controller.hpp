@@ -0,0 +1,56 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+
+namespace ec::vulkan
+{
+
+// Picks the shallowest frame queue (frames in flight and swapchain images) that still sustains a
+// target frame time. With one frame in flight, CPU and GPU work serialize and latency is lowest;
+// deeper queues let them overlap, and absorb spikes, at the cost of latency
+class LatencyController
+{
+public:
+
+    struct Info {
+        float targetFrameTime;  // Seconds
+        uint32_t maxFramesInFlight;
+        uint32_t maxSwapchainImages;
+        uint32_t windowSize{ 120 };  // Frames measured before each decision
+        float headroom{ 0.9f };      // Fraction of the target a shallower queue must fit in
+    };
+
+    struct Depth {
+        uint32_t framesInFlight{};
+        uint32_t swapchainImages{};
+
+        bool operator==(const Depth&) const = default;
+    };
+
+    LatencyController() = default;
+    LatencyController(const LatencyController::Info& info, uint32_t initialFramesInFlight);
+
+    // Times in seconds, gpuTime is 0 if unknown. Returns the new depth when it changes, at most
+    // once per window
+    std::optional<Depth> add_sample(float cpuTime, float gpuTime);
+
+    const Depth& get_depth() const { return m_depth; }
+
+private:
+
+    Depth get_depth_for(uint32_t framesInFlight) const;
+    // Predicted frame time (a high percentile, spikes matter) with framesInFlight
+    float predict_frame_time(uint32_t framesInFlight);
+
+private:
+
+    LatencyController::Info m_info{};
+    Depth m_depth{};
+
+    std::vector<float> m_cpuTimes{};
+    std::vector<float> m_gpuTimes{};
+    std::vector<float> m_scratch{};
+};
+
+}  // namespace ec::vulkan
@@ -1,30 +1,513 @@
 #include "pch.hpp"
 #include "pipeline.hpp"
+#include "utils.hpp"
+#include "deletion_queue.hpp"
+#include <map>
 #include <set>
 
 namespace ec::vulkan
 {
 
+// -- Pipeline library keys --
+// Each library part is keyed by the state it owns, so permutations that only differ in other
+// parts reuse it. The state is flattened to integers and compared in full on lookup, lists are
+// prefixed by their size so different states can't flatten to the same key
+using LibraryKey = std::vector<uint64_t>;
+
+template<typename T>
+static void add_to_key(LibraryKey& key, const T& value)
+{
+    if constexpr (vk::isVulkanHandleType<T>::value) {
+        key.push_back(reinterpret_cast<uint64_t>(static_cast<typename T::CType>(value)));
+    } else {
+        key.push_back(static_cast<uint64_t>(value));
+    }
+}
+
+template<typename Flags>
+static uint64_t flags_value(Flags flags)
+{
+    return static_cast<uint64_t>(static_cast<typename Flags::MaskType>(flags));
+}
+
+// Only the fragment shader, or only the other stages
+static void add_shaders_to_key(LibraryKey& key, const GraphicsPipelineInfo& info, bool fragment)
+{
+    auto inPart{ [&](const ShaderInfo& shader)
+                 { return (shader.stage == vk::ShaderStageFlagBits::eFragment) == fragment; } };
+    add_to_key(key, std::ranges::count_if(info.shaders, inPart));
+    for (auto& shader : info.shaders) {
+        if (!inPart(shader)) {
+            continue;
+        }
+        add_to_key(key, shader.filePath.size());
+        for (char c : shader.filePath) {
+            add_to_key(key, c);
+        }
+        add_to_key(key, flags_value(vk::ShaderStageFlags(shader.stage)));
+        add_to_key(key, shader.specializationConstants.size());
+        for (auto& constant : shader.specializationConstants) {
+            add_to_key(key, constant.id);
+            add_to_key(key, constant.value);
+        }
+    }
+}
+
+static void add_render_targets_to_key(LibraryKey& key,
+                                      const GraphicsPipelineInfo& info)
+{
+    add_to_key(key, info.renderPass);
+    add_to_key(key, info.subpassIdx);
+    add_to_key(key, info.colorAttachmentFormats.size());
+    for (auto format : info.colorAttachmentFormats) {
+        add_to_key(key, format);
+    }
+    add_to_key(key, info.depthAttachmentFormat);
+}
+
+// Dynamic topology must stay in the class of the baked one, without the unrestricted property
+static uint32_t topology_class(vk::PrimitiveTopology topology)
+{
+    switch (topology) {
+        case vk::PrimitiveTopology::ePointList: return 0;
+        case vk::PrimitiveTopology::eLineList:
+        case vk::PrimitiveTopology::eLineStrip:
+        case vk::PrimitiveTopology::eLineListWithAdjacency:
+        case vk::PrimitiveTopology::eLineStripWithAdjacency: return 1;
+        case vk::PrimitiveTopology::ePatchList: return 3;
+        default: return 2;
+    }
+}
+
+static LibraryKey vertex_input_key(const GraphicsPipelineInfo& info, bool dynamicTopology)
+{
+    LibraryKey key{};
+    add_to_key(key, info.bindingStrides.size());
+    for (auto stride : info.bindingStrides) {
+        add_to_key(key, stride);
+    }
+    add_to_key(key, info.attributeDescriptions.size());
+    for (auto& attribute : info.attributeDescriptions) {
+        add_to_key(key, attribute.format);
+        add_to_key(key, attribute.binding);
+        add_to_key(key, attribute.offset);
+    }
+    if (dynamicTopology) {
+        add_to_key(key, topology_class(info.primitiveTopology));
+    } else {
+        add_to_key(key, info.primitiveTopology);
+    }
+    add_to_key(key, info.primitiveRestartEnable);
+    return key;
+}
+
+static LibraryKey pre_rasterization_key(const GraphicsPipelineInfo& info,
+                                                         vk::PipelineLayout layout)
+{
+    LibraryKey key{};
+    add_shaders_to_key(key, info, false);
+    add_to_key(key, info.depthClampEnable);
+    add_to_key(key, flags_value(info.cullMode));
+    add_to_key(key, info.frontFace);
+    add_to_key(key, layout);
+    // Rasterizer discard depends on the presence of a fragment shader
+    add_to_key(key,
+               std::ranges::any_of(info.shaders,
+                                   [](const ShaderInfo& shader)
+                                   { return shader.stage == vk::ShaderStageFlagBits::eFragment; }));
+    add_render_targets_to_key(key, info);
+    return key;
+}
+
+static LibraryKey fragment_key(const GraphicsPipelineInfo& info,
+                                                vk::PipelineLayout layout)
+{
+    LibraryKey key{};
+    add_shaders_to_key(key, info, true);
+    add_to_key(key, info.rasterizationSamples);
+    add_to_key(key, info.depthTestEnable);
+    add_to_key(key, info.depthWriteEnable);
+    add_to_key(key, info.depthCompareOp);
+    add_to_key(key, info.stencilTestEnable);
+    for (auto& stencil : { info.stencilStateFront, info.stencilStateBack }) {
+        add_to_key(key, stencil.failOp);
+        add_to_key(key, stencil.passOp);
+        add_to_key(key, stencil.depthFailOp);
+        add_to_key(key, stencil.compareOp);
+        add_to_key(key, stencil.compareMask);
+        add_to_key(key, stencil.writeMask);
+        add_to_key(key, stencil.reference);
+    }
+    add_to_key(key, layout);
+    add_render_targets_to_key(key, info);
+    return key;
+}
+
+static LibraryKey fragment_output_key(const GraphicsPipelineInfo& info)
+{
+    LibraryKey key{};
+    add_to_key(key, info.rasterizationSamples);
+    add_to_key(key, info.blendEnableInAttachments.size());
+    for (auto blendEnable : info.blendEnableInAttachments) {
+        add_to_key(key, blendEnable);
+    }
+    add_render_targets_to_key(key, info);
+    return key;
+}
+
+// Library part that owns each of the dynamic states used by the manager
+static vk::GraphicsPipelineLibraryFlagBitsEXT dynamic_state_part(vk::DynamicState state)
+{
+    using Part = vk::GraphicsPipelineLibraryFlagBitsEXT;
+    switch (state) {
+        case vk::DynamicState::ePrimitiveTopology: return Part::eVertexInputInterface;
+        case vk::DynamicState::eDepthTestEnable:
+        case vk::DynamicState::eDepthWriteEnable:
+        case vk::DynamicState::eDepthCompareOp: return Part::eFragmentShader;
+        default: return Part::ePreRasterizationShaders;
+    }
+}
+
+// Specialization constants are packed as consecutive 32-bit values. Returns nullptr if the shader
+// has no constants
+struct SpecializationData {
+    std::vector<vk::SpecializationMapEntry> entries{};
+    std::vector<uint32_t> data{};
+    vk::SpecializationInfo info{};
+};
+
+static const vk::SpecializationInfo* fill_specialization(const ShaderInfo& shader,
+                                                         SpecializationData& specialization)
+{
+    const auto& constants{ shader.specializationConstants };
+    if (constants.empty()) {
+        return nullptr;
+    }
+    for (size_t i = 0; i < constants.size(); ++i) {
+        specialization.entries.push_back({
+            .constantID = constants[i].id,
+            .offset     = static_cast<uint32_t>(i * sizeof(uint32_t)),
+            .size       = sizeof(uint32_t),
+        });
+        specialization.data.push_back(constants[i].value);
+    }
+    specialization.info = {
+        .mapEntryCount = static_cast<uint32_t>(specialization.entries.size()),
+        .pMapEntries   = specialization.entries.data(),
+        .dataSize      = specialization.data.size() * sizeof(uint32_t),
+        .pData         = specialization.data.data(),
+    };
+    return &specialization.info;
+}
+
 PipelineManager::PipelineManager(const PipelineManager::Info& info) :
-  m_device{ info.device }
+  m_device{ info.device },
+  m_extendedDynamicState{ info.extendedDynamicState },
+  m_graphicsPipelineLibrary{ info.graphicsPipelineLibrary },
+  m_shaderObject{ info.shaderObject }
 {
+    // Shader objects do not use libraries, all state is set dynamically by the context
+    EC_ASSERT(!m_shaderObject || (m_extendedDynamicState && !m_graphicsPipelineLibrary));
 }
 
 uint32_t PipelineManager::create_basic_graphics_pipeline(const GraphicsPipelineInfo& info)
 {
-    // -- Shader Creation --
     // TODO: Maybe separate shaders from pipelines if many pipelines are created with same shaders
+    std::vector<Shader> shaders(info.shaders.size());
+    for (size_t i = 0; i < info.shaders.size(); ++i) {
+        shaders[i].init_from_spirv(info.shaders[i].filePath);
+    }
+
+    uint32_t layoutIdx{ create_pipeline_layout(info, shaders) };
+    return add_pipeline(info, std::move(shaders), layoutIdx);
+}
+
+uint32_t PipelineManager::get_pipeline_variant(uint32_t baseIndex, const PipelineVariantInfo& info)
+{
+    EC_ASSERT(baseIndex < m_pipelines.size());
+    EC_ASSERT(info.featureMask < (1u << MAX_FEATURE_BITS));
+    const auto& base{ m_pipelines[baseIndex] };
+    EC_ASSERT(base.shaders.size() == base.info.shaders.size());
+
+    // Only the feature bits some stage declares change the pipeline
+    uint32_t declaredMask{};
+    for (const auto& shader : base.shaders) {
+        for (uint32_t id : shader.get_specialization_constant_ids()) {
+            if (id < MAX_FEATURE_BITS) {
+                declaredMask |= 1u << id;
+            }
+        }
+    }
+    uint32_t featureMask{ info.featureMask & declaredMask };
+    vk::CullModeFlags cullMode{ base.info.cullMode };
+    if (!m_extendedDynamicState) {
+        cullMode = info.cullMode.value_or(cullMode);
+    }
+    auto variantKey{ std::make_tuple(baseIndex,
+                                     featureMask,
+                                     info.blendEnable,
+                                     static_cast<uint32_t>(cullMode)) };
+    if (auto it{ m_variants.find(variantKey) }; it != m_variants.end()) {
+        return it->second;
+    }
+
+    // Specialization does not change the resources used by the shaders, so the layout is shared
+    GraphicsPipelineInfo variantInfo{ base.info };
+    variantInfo.cullMode = cullMode;
+    for (size_t i = 0; i < variantInfo.shaders.size(); ++i) {
+        auto& shaderInfo{ variantInfo.shaders[i] };
+        for (const auto& constant : shaderInfo.specializationConstants) {
+            if (constant.id < MAX_FEATURE_BITS) {
+                throw std::runtime_error(std::format(
+                    "Specialization constant {} of {} collides with the variant feature bits",
+                    constant.id,
+                    shaderInfo.filePath));
+            }
+        }
+        for (uint32_t id : base.shaders[i].get_specialization_constant_ids()) {
+            if (id < MAX_FEATURE_BITS) {
+                shaderInfo.specializationConstants.push_back({
+                    .id    = id,
+                    .value = (featureMask >> id) & 1u,
+                });
+            }
+        }
+    }
+    if (info.blendEnable) {
+        size_t numAttachments{ std::max(variantInfo.blendEnableInAttachments.size(),
+                                        variantInfo.colorAttachmentFormats.size()) };
+        variantInfo.blendEnableInAttachments.assign(numAttachments, info.blendEnable.value());
+    }
+
+    // The code was already loaded and reflected for the base pipeline
+    uint32_t variantIdx{ add_pipeline(variantInfo,
+                                      m_pipelines[baseIndex].shaders,
+                                      m_pipelines[baseIndex].layoutIndex) };
+    m_variants.emplace(variantKey, variantIdx);
+    return variantIdx;
+}
+
+bool PipelineManager::samples_images(uint32_t index) const
+{
+    for (const auto& shader : m_pipelines[index].shaders) {
+        for (const auto& [set, bindings] : shader.get_descriptor_set_bindings()) {
+            for (const auto& binding : bindings) {
+                if (binding.descriptorType == vk::DescriptorType::eCombinedImageSampler
+                    || binding.descriptorType == vk::DescriptorType::eSampledImage) {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+uint32_t PipelineManager::add_pipeline(const GraphicsPipelineInfo& info,
+                                       std::vector<Shader> shaders,
+                                       uint32_t layoutIndex)
+{
+    PipelineData data{
+        .layoutIndex = layoutIndex,
+        .info        = info,
+    };
+    uint32_t pipelineIndex{ static_cast<uint32_t>(m_pipelines.size()) };
+    if (m_shaderObject) {
+        data.shaderObjects = build_shader_objects(info, shaders, m_pipelineLayouts[layoutIndex]);
+    } else {
+        data.pipeline = build_graphics_pipeline(info,
+                                                shaders,
+                                                m_pipelineLayouts[layoutIndex].layout,
+                                                pipelineIndex);
+    }
+    for (auto& shader : shaders) {
+        shader.free_module(m_device);
+    }
+    data.shaders = std::move(shaders);
+
+    m_pipelines.push_back(std::move(data));
+    return pipelineIndex;
+}
+
+// A buffer is dynamic in every stage if any stage makes it dynamic (e.g. by its name). Empty if
+// the types are otherwise different
+static std::optional<vk::DescriptorType> merge_descriptor_types(vk::DescriptorType a,
+                                                                vk::DescriptorType b)
+{
+    using Type = vk::DescriptorType;
+    if (a == b) {
+        return a;
+    }
+    constexpr std::array<std::pair<Type, Type>, 2> dynamicTypes{ {
+        { Type::eUniformBuffer, Type::eUniformBufferDynamic },
+        { Type::eStorageBuffer, Type::eStorageBufferDynamic },
+    } };
+    for (auto [type, dynamicType] : dynamicTypes) {
+        if ((a == type || a == dynamicType) && (b == type || b == dynamicType)) {
+            return dynamicType;
+        }
+    }
+    return std::nullopt;
+}
+
+uint32_t PipelineManager::create_pipeline_layout(const GraphicsPipelineInfo& info,
+                                                std::vector<Shader>& shaders)
+{
+    // Bindings of all the stages merged by set and binding number
+    std::map<uint32_t, std::map<uint32_t, vk::DescriptorSetLayoutBinding>> pipelineSets{};
+    for (size_t i = 0; i < shaders.size(); ++i) {
+        shaders[i].init_resources(info.dynamicBuffers);
+        for (const auto& [setIdx, bindings] : shaders[i].get_descriptor_set_bindings()) {
+            for (const auto& binding : bindings) {
+                auto [it, inserted]{ pipelineSets[setIdx].try_emplace(binding.binding, binding) };
+                auto& merged{ it->second };
+                if (!inserted && merged.descriptorType != binding.descriptorType) {
+                    auto type{ merge_descriptor_types(merged.descriptorType,
+                                                      binding.descriptorType) };
+                    if (!type) {
+                        throw std::runtime_error(std::format(
+                            "Shader stages disagree on the descriptor type of set {} binding {}",
+                            setIdx,
+                            binding.binding));
+                    }
+                    merged.descriptorType = type.value();
+                }
+                merged.stageFlags |= info.shaders[i].stage;
+            }
+        }
+    }
+    uint32_t maxSetIdx{ pipelineSets.empty() ? 0 : pipelineSets.rbegin()->first };
+
+    std::map<uint32_t, std::vector<vk::DescriptorSetLayoutBinding>> pipelineSetBindings{};
+    for (const auto& [setIdx, bindings] : pipelineSets) {
+        for (const auto& binding : bindings) {
+            pipelineSetBindings[setIdx].push_back(binding.second);
+        }
+    }
+
+    // Create final descriptor set layouts and check for support
+    std::vector<vk::DescriptorSetLayout> setLayouts{};
+    if (pipelineSetBindings.size() > 0) {
+        setLayouts.resize(maxSetIdx + 1, VK_NULL_HANDLE);
+    }
+    for (auto& set : pipelineSetBindings) {
+        vk::DescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{
+            .bindingCount = static_cast<uint32_t>(set.second.size()),
+            .pBindings    = set.second.data(),
+        };
+        if (!m_device.getDescriptorSetLayoutSupport(descriptorSetLayoutCreateInfo).supported) {
+            throw std::runtime_error("Descriptor set not supported!");
+        }
+        setLayouts[set.first] = m_device.createDescriptorSetLayout(descriptorSetLayoutCreateInfo);
+        m_descriptorSetLayouts.push_back(setLayouts[set.first]);
+    }
+
+    std::set<vk::PushConstantRange> uniquePushConstantRanges{};
+    for (auto& shader : shaders) {
+        if (shader.get_push_constant_range().has_value()) {
+            uniquePushConstantRanges.insert(shader.get_push_constant_range().value());
+        }
+    }
+    std::vector<vk::PushConstantRange> pushConstantRanges{ std::vector<vk::PushConstantRange>(
+        uniquePushConstantRanges.begin(),
+        uniquePushConstantRanges.end()) };
+
+    for (size_t i = 0; i < shaders.size(); ++i) {
+        auto& optRange{ shaders[i].get_push_constant_range() };
+        if (!optRange.has_value()) {
+            continue;
+        }
+        auto& shaderRange{ optRange.value() };
+        for (auto& pushConstantRange : pushConstantRanges) {
+            if (pushConstantRange.size == shaderRange.size
+                && pushConstantRange.offset == shaderRange.offset) {
+                pushConstantRange.stageFlags |= info.shaders[i].stage;
+            }
+        }
+    }
+
+    vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{
+        .setLayoutCount         = static_cast<uint32_t>(setLayouts.size()),
+        .pSetLayouts            = setLayouts.data(),
+        .pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size()),
+        .pPushConstantRanges    = pushConstantRanges.data(),
+    };
+    m_pipelineLayouts.push_back({
+        .layout             = m_device.createPipelineLayout(pipelineLayoutCreateInfo),
+        .setLayouts         = std::move(setLayouts),
+        .pushConstantRanges = std::move(pushConstantRanges),
+    });
+    return static_cast<uint32_t>(m_pipelineLayouts.size() - 1);
+}
+
+std::vector<vk::ShaderEXT> PipelineManager::build_shader_objects(const GraphicsPipelineInfo& info,
+                                                                 std::vector<Shader>& shaders,
+                                                                 const LayoutData& layout)
+{
+    // All the stages are created in one call and linked, which lets the implementation
+    // optimize across stages like a monolithic pipeline would
+    vk::ShaderCreateFlagsEXT flags{};
+    if (shaders.size() > 1) {
+        flags |= vk::ShaderCreateFlagBitsEXT::eLinkStage;
+    }
+    std::vector<SpecializationData> specializations(info.shaders.size());
+    std::vector<vk::ShaderCreateInfoEXT> createInfos(info.shaders.size());
+    for (size_t i = 0; i < info.shaders.size(); ++i) {
+        // Only vertex and fragment stages are used, so the vertex stage is always followed by
+        // the fragment one if present
+        vk::ShaderStageFlags nextStage{};
+        if (info.shaders[i].stage == vk::ShaderStageFlagBits::eVertex
+            && std::ranges::any_of(info.shaders,
+                                   [](const ShaderInfo& shader)
+                                   { return shader.stage == vk::ShaderStageFlagBits::eFragment; })) {
+            nextStage = vk::ShaderStageFlagBits::eFragment;
+        }
+        const auto& code{ shaders[i].get_code() };
+        createInfos[i] = {
+            .flags                  = flags,
+            .stage                  = info.shaders[i].stage,
+            .nextStage              = nextStage,
+            .codeType               = vk::ShaderCodeTypeEXT::eSpirv,
+            .codeSize               = code.size() * sizeof(uint32_t),
+            .pCode                  = code.data(),
+            .pName                  = "main",
+            .setLayoutCount         = static_cast<uint32_t>(layout.setLayouts.size()),
+            .pSetLayouts            = layout.setLayouts.data(),
+            .pushConstantRangeCount = static_cast<uint32_t>(layout.pushConstantRanges.size()),
+            .pPushConstantRanges    = layout.pushConstantRanges.data(),
+            .pSpecializationInfo    = fill_specialization(info.shaders[i], specializations[i]),
+        };
+    }
+
+    auto [result, shaderObjects]{ m_device.createShadersEXT(createInfos) };
+    if (result != vk::Result::eSuccess) {
+        for (auto& shaderObject : shaderObjects) {
+            m_device.destroyShaderEXT(shaderObject);
+        }
+        throw std::runtime_error(
+            std::format("Failed to create shader objects! Result: {}", vk::to_string(result)));
+    }
+    return shaderObjects;
+}
+
+vk::Pipeline PipelineManager::build_graphics_pipeline(const GraphicsPipelineInfo& info,
+                                                      std::vector<Shader>& shaders,
+                                                      vk::PipelineLayout layout,
+                                                      uint32_t pipelineIndex)
+{
+    // -- Shader Creation --
     std::vector<vk::PipelineShaderStageCreateInfo> shaderStages(info.shaders.size());
-    std::vector<Shader> shaders(2);
+    // Kept alive until the pipeline is created
+    std::vector<SpecializationData> specializations(info.shaders.size());
 
     int fragmentShaderIdx{ -1 };
     for (size_t i = 0; i < info.shaders.size(); ++i) {
-        shaders[i].init_from_spirv(info.shaders[i].filePath);
         vk::ShaderModule shaderModule{ shaders[i].create_shader_module(m_device) };
+
         shaderStages[i] = {
-            .stage  = info.shaders[i].stage,
-            .module = shaderModule,
-            .pName  = "main",
+            .stage               = info.shaders[i].stage,
+            .module              = shaderModule,
+            .pName               = "main",
+            .pSpecializationInfo = fill_specialization(info.shaders[i], specializations[i]),
         };
         if (info.shaders[i].stage == vk::ShaderStageFlagBits::eFragment) {
             fragmentShaderIdx = static_cast<int>(i);
@@ -73,25 +556,10 @@ uint32_t PipelineManager::create_basic_graphics_pipeline(const GraphicsPipelineI
     // vk::PipelineTessellationStateCreateInfo tessellationState{};
 
     // -- Viewport --
-    // TODO: Make viewport dynamic, on window resize
-    std::array<vk::Viewport, 1> viewports{};
-    viewports[0] = {
-        .width    = static_cast<float>(info.viewportExtent.width),
-        .height   = static_cast<float>(info.viewportExtent.height),
-        .minDepth = 0.f,
-        .maxDepth = 1.f,
-    };
-
-    std::array<vk::Rect2D, 1> scissors{};
-    scissors[0] = {
-        .extent = info.viewportExtent,
-    };
-
+    // Viewport and scissor are always dynamic, set by the context to the render area
     vk::PipelineViewportStateCreateInfo viewportState{
-        .viewportCount = static_cast<uint32_t>(viewports.size()),
-        .pViewports    = viewports.data(),
-        .scissorCount  = static_cast<uint32_t>(scissors.size()),
-        .pScissors     = scissors.data(),
+        .viewportCount = 1,
+        .scissorCount  = 1,
     };
 
     // -- Rasterization --
@@ -100,7 +568,7 @@ uint32_t PipelineManager::create_basic_graphics_pipeline(const GraphicsPipelineI
         .rasterizerDiscardEnable = fragmentShaderIdx == -1,  // Discard if no fragment shader
         .polygonMode             = vk::PolygonMode::eFill,
         .cullMode                = info.cullMode,
-        .frontFace               = vk::FrontFace::eCounterClockwise,
+        .frontFace               = info.frontFace,
         .depthBiasEnable         = VK_FALSE,
         .lineWidth               = 1.f,
     };
@@ -114,8 +582,8 @@ uint32_t PipelineManager::create_basic_graphics_pipeline(const GraphicsPipelineI
     // -- Depth Stencil --
     vk::PipelineDepthStencilStateCreateInfo depthStencilState{
         .depthTestEnable       = info.depthTestEnable,
-        .depthWriteEnable      = VK_TRUE,
-        .depthCompareOp        = vk::CompareOp::eLess,
+        .depthWriteEnable      = info.depthWriteEnable,
+        .depthCompareOp        = info.depthCompareOp,
         .depthBoundsTestEnable = VK_FALSE,
         .stencilTestEnable     = info.stencilTestEnable,
         .front                 = info.stencilStateFront,
@@ -123,22 +591,10 @@ uint32_t PipelineManager::create_basic_graphics_pipeline(const GraphicsPipelineI
     };
 
     // -- Blending --
-    // Basic blend formula
-    vk::PipelineColorBlendAttachmentState baseBlendAttachmentState{
-        .blendEnable         = VK_TRUE,
-        .srcColorBlendFactor = vk::BlendFactor::eSrcAlpha,
-        .dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha,
-        .colorBlendOp        = vk::BlendOp::eAdd,
-        .srcAlphaBlendFactor = vk::BlendFactor::eOne,
-        .dstAlphaBlendFactor = vk::BlendFactor::eZero,
-        .alphaBlendOp        = vk::BlendOp::eAdd,
-        .colorWriteMask      = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG
-                          | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA,
-    };
     // Set blending enabled per color attachment
     std::vector<vk::PipelineColorBlendAttachmentState> blendAttachments(
         info.blendEnableInAttachments.size(),
-        baseBlendAttachmentState);
+        BASE_BLEND_ATTACHMENT_STATE);
     for (size_t i = 0; i < blendAttachments.size(); ++i) {
         blendAttachments[i].blendEnable = info.blendEnableInAttachments[i];
     }
@@ -149,96 +605,32 @@ uint32_t PipelineManager::create_basic_graphics_pipeline(const GraphicsPipelineI
         .pAttachments    = blendAttachments.data(),
     };
 
-    // -- Dynamic State -- (TODO)
-    // vk::PipelineDynamicStateCreateInfo dynamicState{};
-
-    // -- Layout --
-    uint32_t maxSetIdx{};  // Store biggest set index to later create big enough array
-    std::unordered_map<uint32_t, std::set<vk::DescriptorSetLayoutBinding>>
-        pipelineSetUniqueBindings{};
-    // Add bindings to a unique set, to eliminate duplicates
-    for (size_t i = 0; i < shaders.size(); ++i) {
-        shaders[i].init_resources();
-        for (auto& set : shaders[i].get_descriptor_set_bindings()) {
-            // Find highest set idx
-            if (set.first > maxSetIdx) {
-                maxSetIdx = set.first;
-            }
-            pipelineSetUniqueBindings[set.first].insert(set.second.begin(), set.second.end());
-        }
-    }
-
-    // Convert set to vector to pass to createInfo
-    std::unordered_map<uint32_t, std::vector<vk::DescriptorSetLayoutBinding>> pipelineSetBindings{};
-    for (auto& set : pipelineSetUniqueBindings) {
-        pipelineSetBindings[set.first]
-            = std::vector<vk::DescriptorSetLayoutBinding>(set.second.begin(), set.second.end());
-    }
-
-    // For all the common bindings, find, for each shader, if they are used and update flags
-    for (size_t i = 0; i < shaders.size(); ++i) {
-        for (auto& shaderSet : shaders[i].get_descriptor_set_bindings()) {
-            auto& commonBindings{ pipelineSetBindings[shaderSet.first] };
-            for (auto& shaderBinding : shaderSet.second) {
-                for (size_t j = 0; j < commonBindings.size(); ++j) {
-                    if (commonBindings[j].binding == shaderBinding.binding) {
-                        commonBindings[j].stageFlags |= info.shaders[i].stage;
-                    }
-                }
-            }
-        }
-    }
-
-    // Create final descriptor set layouts and check for support
-    std::vector<vk::DescriptorSetLayout> setLayouts{};
-    if (pipelineSetBindings.size() > 0) {
-        setLayouts.resize(maxSetIdx + 1, VK_NULL_HANDLE);
-    }
-    for (auto& set : pipelineSetBindings) {
-        vk::DescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{
-            .bindingCount = static_cast<uint32_t>(set.second.size()),
-            .pBindings    = set.second.data(),
-        };
-        if (!m_device.getDescriptorSetLayoutSupport(descriptorSetLayoutCreateInfo).supported) {
-            throw std::runtime_error("Descriptor set not supported!");
-        }
-        setLayouts[set.first] = m_device.createDescriptorSetLayout(descriptorSetLayoutCreateInfo);
-    }
-
-    std::set<vk::PushConstantRange> uniquePushConstantRanges{};
-    for (auto& shader : shaders) {
-        if (shader.get_push_constant_range().has_value()) {
-            uniquePushConstantRanges.insert(shader.get_push_constant_range().value());
-        }
-    }
-    std::vector<vk::PushConstantRange> pushConstantRanges{ std::vector<vk::PushConstantRange>(
-        uniquePushConstantRanges.begin(),
-        uniquePushConstantRanges.end()) };
-
-    for (size_t i = 0; i < shaders.size(); ++i) {
-        auto& optRange{ shaders[i].get_push_constant_range() };
-        if (!optRange.has_value()) {
-            continue;
-        }
-        auto& shaderRange{ optRange.value() };
-        for (auto& pushConstantRange : pushConstantRanges) {
-            if (pushConstantRange.size == shaderRange.size
-                && pushConstantRange.offset == shaderRange.offset) {
-                pushConstantRange.stageFlags |= info.shaders[i].stage;
-            }
-        }
+    // -- Dynamic State --
+    std::vector<vk::DynamicState> dynamicStates{ vk::DynamicState::eViewport,
+                                                 vk::DynamicState::eScissor };
+    if (m_extendedDynamicState) {
+        dynamicStates.insert(dynamicStates.end(),
+                             EXTENDED_DYNAMIC_STATES.begin(),
+                             EXTENDED_DYNAMIC_STATES.end());
     }
+    vk::PipelineDynamicStateCreateInfo dynamicState{
+        .dynamicStateCount = static_cast<uint32_t>(dynamicStates.size()),
+        .pDynamicStates    = dynamicStates.data(),
+    };
 
-    vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{
-        .setLayoutCount         = static_cast<uint32_t>(setLayouts.size()),
-        .pSetLayouts            = setLayouts.data(),
-        .pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size()),
-        .pPushConstantRanges    = pushConstantRanges.data(),
+    // -- Dynamic Rendering --
+    vk::PipelineRenderingCreateInfo renderingCreateInfo{
+        .colorAttachmentCount    = static_cast<uint32_t>(info.colorAttachmentFormats.size()),
+        .pColorAttachmentFormats = info.colorAttachmentFormats.data(),
+        .depthAttachmentFormat   = info.depthAttachmentFormat,
+        .stencilAttachmentFormat = format_has_stencil(info.depthAttachmentFormat)
+                                       ? info.depthAttachmentFormat
+                                       : vk::Format::eUndefined,
     };
-    m_pipelineLayout = m_device.createPipelineLayout(pipelineLayoutCreateInfo);
 
     // -- Pipeline --
     vk::GraphicsPipelineCreateInfo pipelineCreateInfo{
+        .pNext               = info.renderPass ? nullptr : &renderingCreateInfo,
         .stageCount          = static_cast<uint32_t>(shaderStages.size()),
         .pStages             = shaderStages.data(),
         .pVertexInputState   = &vertexInputState,
@@ -248,28 +640,260 @@ uint32_t PipelineManager::create_basic_graphics_pipeline(const GraphicsPipelineI
         .pMultisampleState   = &multisampleState,
         .pDepthStencilState  = &depthStencilState,
         .pColorBlendState    = &colorBlendState,
-        .layout              = m_pipelineLayout,
+        .pDynamicState       = &dynamicState,
+        .layout              = layout,
         .renderPass          = info.renderPass,
         .subpass             = info.subpassIdx,
     };
 
-    m_pipeline = m_device.createGraphicsPipeline(VK_NULL_HANDLE, pipelineCreateInfo).value;
-    for (auto& shader : shaders) {
-        shader.free(m_device);
+    if (m_graphicsPipelineLibrary) {
+        return link_pipeline_libraries(info, pipelineCreateInfo, pipelineIndex);
     }
-    return 0;
+    return m_device.createGraphicsPipeline(VK_NULL_HANDLE, pipelineCreateInfo).value;
+}
+
+vk::Pipeline PipelineManager::link_pipeline_libraries(
+    const GraphicsPipelineInfo& info,
+    const vk::GraphicsPipelineCreateInfo& fullInfo,
+    uint32_t pipelineIndex)
+{
+    using Part = vk::GraphicsPipelineLibraryFlagBitsEXT;
+
+    // Split shader stages between pre-rasterization and fragment parts
+    std::vector<vk::PipelineShaderStageCreateInfo> preRasterStages{};
+    std::vector<vk::PipelineShaderStageCreateInfo> fragmentStages{};
+    for (uint32_t i = 0; i < fullInfo.stageCount; ++i) {
+        if (fullInfo.pStages[i].stage == vk::ShaderStageFlagBits::eFragment) {
+            fragmentStages.push_back(fullInfo.pStages[i]);
+        } else {
+            preRasterStages.push_back(fullInfo.pStages[i]);
+        }
+    }
+
+    // Each part only keeps the state it owns, so it can be shared between permutations
+    vk::GraphicsPipelineCreateInfo vertexInputInfo{
+        .pVertexInputState   = fullInfo.pVertexInputState,
+        .pInputAssemblyState = fullInfo.pInputAssemblyState,
+        .pDynamicState       = fullInfo.pDynamicState,
+    };
+    LibraryKey vertexInputKey{ vertex_input_key(info, m_extendedDynamicState) };
+
+    vk::GraphicsPipelineCreateInfo preRasterInfo{
+        .stageCount          = static_cast<uint32_t>(preRasterStages.size()),
+        .pStages             = preRasterStages.data(),
+        .pTessellationState  = fullInfo.pTessellationState,
+        .pViewportState      = fullInfo.pViewportState,
+        .pRasterizationState = fullInfo.pRasterizationState,
+        .pDynamicState       = fullInfo.pDynamicState,
+        .layout              = fullInfo.layout,
+        .renderPass          = fullInfo.renderPass,
+        .subpass             = fullInfo.subpass,
+    };
+    LibraryKey preRasterKey{ pre_rasterization_key(info, fullInfo.layout) };
+
+    vk::GraphicsPipelineCreateInfo fragmentInfo{
+        .stageCount         = static_cast<uint32_t>(fragmentStages.size()),
+        .pStages            = fragmentStages.data(),
+        .pMultisampleState  = fullInfo.pMultisampleState,
+        .pDepthStencilState = fullInfo.pDepthStencilState,
+        .pDynamicState      = fullInfo.pDynamicState,
+        .layout             = fullInfo.layout,
+        .renderPass         = fullInfo.renderPass,
+        .subpass            = fullInfo.subpass,
+    };
+    LibraryKey fragmentKey{ fragment_key(info, fullInfo.layout) };
+
+    vk::GraphicsPipelineCreateInfo outputInfo{
+        .pMultisampleState = fullInfo.pMultisampleState,
+        .pColorBlendState  = fullInfo.pColorBlendState,
+        .pDynamicState     = fullInfo.pDynamicState,
+        .renderPass        = fullInfo.renderPass,
+        .subpass           = fullInfo.subpass,
+    };
+    LibraryKey outputKey{ fragment_output_key(info) };
+
+    // Rendering formats (dynamic rendering) are chained after the library info
+    std::array<vk::Pipeline, 4> libraries{
+        get_pipeline_library(vertexInputKey, Part::eVertexInputInterface, vertexInputInfo, nullptr),
+        get_pipeline_library(preRasterKey,
+                             Part::ePreRasterizationShaders,
+                             preRasterInfo,
+                             fullInfo.pNext),
+        get_pipeline_library(fragmentKey, Part::eFragmentShader, fragmentInfo, fullInfo.pNext),
+        get_pipeline_library(outputKey, Part::eFragmentOutputInterface, outputInfo, fullInfo.pNext),
+    };
+
+    // Fast link now, the optimized pipeline replaces it once the optimizer thread is done
+    vk::PipelineLibraryCreateInfoKHR libraryInfo{
+        .libraryCount = static_cast<uint32_t>(libraries.size()),
+        .pLibraries   = libraries.data(),
+    };
+    vk::GraphicsPipelineCreateInfo linkInfo{
+        .pNext  = &libraryInfo,
+        .layout = fullInfo.layout,
+    };
+    vk::Pipeline pipeline{ m_device.createGraphicsPipeline(VK_NULL_HANDLE, linkInfo).value };
+
+    enqueue_optimization(pipelineIndex, libraries, fullInfo.layout);
+    return pipeline;
+}
+
+vk::Pipeline PipelineManager::get_pipeline_library(std::vector<uint64_t> key,
+                                                   vk::GraphicsPipelineLibraryFlagsEXT part,
+                                                   vk::GraphicsPipelineCreateInfo partInfo,
+                                                   const void* partNext)
+{
+    add_to_key(key, flags_value(part));
+    if (auto it{ m_pipelineLibraries.find(key) }; it != m_pipelineLibraries.end()) {
+        return it->second;
+    }
+
+    std::vector<vk::DynamicState> partDynamicStates{};
+    for (uint32_t i = 0; i < partInfo.pDynamicState->dynamicStateCount; ++i) {
+        vk::DynamicState state{ partInfo.pDynamicState->pDynamicStates[i] };
+        if (part & dynamic_state_part(state)) {
+            partDynamicStates.push_back(state);
+        }
+    }
+    vk::PipelineDynamicStateCreateInfo partDynamicState{
+        .dynamicStateCount = static_cast<uint32_t>(partDynamicStates.size()),
+        .pDynamicStates    = partDynamicStates.data(),
+    };
+
+    vk::GraphicsPipelineLibraryCreateInfoEXT libraryCreateInfo{
+        .pNext = partNext,
+        .flags = part,
+    };
+    partInfo.pNext         = &libraryCreateInfo;
+    partInfo.pDynamicState = &partDynamicState;
+    partInfo.flags = vk::PipelineCreateFlagBits::eLibraryKHR
+                     | vk::PipelineCreateFlagBits::eRetainLinkTimeOptimizationInfoEXT;
+
+    vk::Pipeline library{ m_device.createGraphicsPipeline(VK_NULL_HANDLE, partInfo).value };
+    m_pipelineLibraries.emplace(std::move(key), library);
+    return library;
+}
+
+void PipelineManager::enqueue_optimization(uint32_t pipelineIndex,
+                                           const std::array<vk::Pipeline, 4>& libraries,
+                                           vk::PipelineLayout layout)
+{
+    if (!m_optimizer) {
+        m_optimizer = std::make_unique<Optimizer>();
+    }
+    auto& optimizer{ *m_optimizer };
+    {
+        std::scoped_lock lock{ optimizer.mutex };
+        optimizer.jobs.push_back({
+            .pipelineIndex = pipelineIndex,
+            .libraries     = libraries,
+            .layout        = layout,
+        });
+    }
+    if (!optimizer.thread.joinable()) {
+        optimizer.thread = std::thread(&PipelineManager::optimizer_loop, m_device, &optimizer);
+    }
+    optimizer.condition.notify_one();
+}
+
+void PipelineManager::optimizer_loop(vk::Device device, Optimizer* optimizer)
+{
+    while (true) {
+        Optimizer::Job job{};
+        {
+            std::unique_lock lock{ optimizer->mutex };
+            optimizer->condition.wait(lock,
+                                      [&]() { return optimizer->stop || !optimizer->jobs.empty(); });
+            if (optimizer->stop) {
+                return;
+            }
+            job = optimizer->jobs.front();
+            optimizer->jobs.pop_front();
+        }
+
+        vk::PipelineLibraryCreateInfoKHR libraryInfo{
+            .libraryCount = static_cast<uint32_t>(job.libraries.size()),
+            .pLibraries   = job.libraries.data(),
+        };
+        vk::GraphicsPipelineCreateInfo linkInfo{
+            .pNext  = &libraryInfo,
+            .flags  = vk::PipelineCreateFlagBits::eLinkTimeOptimizationEXT,
+            .layout = job.layout,
+        };
+
+        vk::Pipeline optimized{};
+        try {
+            optimized = device.createGraphicsPipeline(VK_NULL_HANDLE, linkInfo).value;
+        }
+        catch (const std::exception& e) {
+            EC_LOG_WARN("Failed to optimize pipeline {}, keeping the fast-linked one. Reason: {}",
+                        job.pipelineIndex,
+                        e.what());
+        }
+
+        std::scoped_lock lock{ optimizer->mutex };
+        if (optimized) {
+            optimizer->finished.push_back({ job.pipelineIndex, optimized });
+        }
+    }
+}
+
+void PipelineManager::update(DeletionQueue& deletionQueue, uint64_t frameNumber)
+{
+    if (!m_optimizer) {
+        return;
+    }
+    std::scoped_lock lock{ m_optimizer->mutex };
+    for (auto& [pipelineIndex, optimized] : m_optimizer->finished) {
+        deletionQueue.retire(m_pipelines[pipelineIndex].pipeline, frameNumber);
+        m_pipelines[pipelineIndex].pipeline = optimized;
+    }
+    m_optimizer->finished.clear();
+}
+
+void PipelineManager::stop_optimizer()
+{
+    if (!m_optimizer) {
+        return;
+    }
+    {
+        std::scoped_lock lock{ m_optimizer->mutex };
+        m_optimizer->stop = true;
+        m_optimizer->jobs.clear();
+    }
+    m_optimizer->condition.notify_all();
+    if (m_optimizer->thread.joinable()) {
+        m_optimizer->thread.join();
+    }
+    for (auto& [pipelineIndex, optimized] : m_optimizer->finished) {
+        m_device.destroyPipeline(optimized);
+    }
+    m_optimizer->finished.clear();
 }
 
 void PipelineManager::free()
 {
-    if (m_pipeline) {
-        m_device.destroyPipeline(m_pipeline);
-        m_pipeline = nullptr;
+    stop_optimizer();
+    for (auto& pipeline : m_pipelines) {
+        m_device.destroyPipeline(pipeline.pipeline);
+        for (auto& shaderObject : pipeline.shaderObjects) {
+            m_device.destroyShaderEXT(shaderObject);
+        }
+    }
+    for (auto& [key, library] : m_pipelineLibraries) {
+        m_device.destroyPipeline(library);
+    }
+    m_pipelineLibraries.clear();
+    m_pipelines.clear();
+    m_variants.clear();
+    for (auto& pipelineLayout : m_pipelineLayouts) {
+        m_device.destroyPipelineLayout(pipelineLayout.layout);
     }
-    if (m_pipelineLayout) {
-        m_device.destroyPipelineLayout(m_pipelineLayout);
-        m_pipelineLayout = nullptr;
+    m_pipelineLayouts.clear();
+    for (auto& setLayout : m_descriptorSetLayouts) {
+        m_device.destroyDescriptorSetLayout(setLayout);
     }
+    m_descriptorSetLayouts.clear();
 }
 
 }  // namespace ec::vulkan
@@ -4,12 +4,42 @@
 #include <glm/glm.hpp>
 #include "backend/shader.hpp"
 
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+
 namespace ec::vulkan
 {
 
+class DeletionQueue;
+
+// Specialization constants are always 32 bits wide (bool, int, uint or bit-casted float)
+struct SpecializationConstant {
+    uint32_t id{};
+    uint32_t value{};
+};
+
 struct ShaderInfo {
-    std::string_view filePath{};
+    std::string filePath{};
     vk::ShaderStageFlagBits stage{};
+    // Constant ids below PipelineManager::MAX_FEATURE_BITS are reserved for pipeline variants
+    std::vector<SpecializationConstant> specializationConstants{};
+};
+
+// Changes from a base pipeline (see PipelineManager::get_pipeline_variant)
+struct PipelineVariantInfo {
+    // Bit i sets the specialization constant with id i. Bits no stage declares are dropped, so
+    // they don't create identical pipelines
+    uint32_t featureMask{};
+    // Every color attachment blends with BASE_BLEND_ATTACHMENT_STATE, or none does, if set
+    std::optional<vk::Bool32> blendEnable{};
+    // Baked into the variant if set. With extended dynamic state the cull mode is not baked, and
+    // variants differing only in it are shared, so it has to be set after binding
+    std::optional<vk::CullModeFlags> cullMode{};
 };
 
 struct VertexAttributeDescription {
@@ -20,29 +50,73 @@ struct VertexAttributeDescription {
 
 struct GraphicsPipelineInfo {
     std::vector<ShaderInfo> shaders{};
+    // {set, binding} of uniform/storage buffers that should use dynamic offsets, in addition to
+    // the ones following the Shader::DYNAMIC_BUFFER_SUFFIX naming convention. Applies to every
+    // stage, like the convention does when any stage follows it
+    std::vector<std::pair<uint32_t, uint32_t>> dynamicBuffers{};
     std::vector<uint32_t> bindingStrides{};
     std::vector<VertexAttributeDescription> attributeDescriptions{};
     vk::PrimitiveTopology primitiveTopology{ vk::PrimitiveTopology::eTriangleList };
     vk::Bool32 primitiveRestartEnable{ VK_FALSE };
     vk::Bool32 depthClampEnable{ VK_FALSE };
-    vk::Extent2D viewportExtent{};
     vk::CullModeFlags cullMode{ vk::CullModeFlagBits::eBack };
+    vk::FrontFace frontFace{ vk::FrontFace::eCounterClockwise };
     vk::SampleCountFlagBits rasterizationSamples{ vk::SampleCountFlagBits::e1 };
     vk::Bool32 depthTestEnable{};
+    vk::Bool32 depthWriteEnable{ VK_TRUE };
+    vk::CompareOp depthCompareOp{ vk::CompareOp::eLess };
     vk::Bool32 stencilTestEnable{};
     vk::StencilOpState stencilStateFront{};
     vk::StencilOpState stencilStateBack{};
     std::vector<vk::Bool32> blendEnableInAttachments{};
     vk::RenderPass renderPass{};
     uint32_t subpassIdx{};
+    // Used instead of renderPass/subpassIdx with dynamic rendering (renderPass null)
+    std::vector<vk::Format> colorAttachmentFormats{};
+    vk::Format depthAttachmentFormat{ vk::Format::eUndefined };
 };
 
 class PipelineManager
 {
 public:
 
+    // Bit i of a variant feature mask is set as the 32-bit specialization constant with id i in
+    // every stage of the variant declaring it (e.g. layout(constant_id = 0) const bool HAS_COLOR)
+    constexpr static uint32_t MAX_FEATURE_BITS{ 16 };
+
+    // With extended dynamic state, these are not baked into pipelines. The values in
+    // GraphicsPipelineInfo are set when the pipeline is bound and can be changed afterwards
+    constexpr static std::array<vk::DynamicState, 6> EXTENDED_DYNAMIC_STATES{
+        vk::DynamicState::eCullMode,
+        vk::DynamicState::eFrontFace,
+        vk::DynamicState::ePrimitiveTopology,
+        vk::DynamicState::eDepthTestEnable,
+        vk::DynamicState::eDepthWriteEnable,
+        vk::DynamicState::eDepthCompareOp,
+    };
+
+    // Basic blend formula, enabled per color attachment with blendEnableInAttachments
+    constexpr static vk::PipelineColorBlendAttachmentState BASE_BLEND_ATTACHMENT_STATE{
+        .blendEnable         = VK_TRUE,
+        .srcColorBlendFactor = vk::BlendFactor::eSrcAlpha,
+        .dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha,
+        .colorBlendOp        = vk::BlendOp::eAdd,
+        .srcAlphaBlendFactor = vk::BlendFactor::eOne,
+        .dstAlphaBlendFactor = vk::BlendFactor::eZero,
+        .alphaBlendOp        = vk::BlendOp::eAdd,
+        .colorWriteMask      = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG
+                          | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA,
+    };
+
     struct Info {
         vk::Device device;
+        bool extendedDynamicState;
+        // Build pipelines from cached parts (vertex input, pre-rasterization, fragment, output),
+        // fast-linked on creation and replaced by link-time optimized ones in the background
+        bool graphicsPipelineLibrary;
+        // Create linked shader objects (VK_EXT_shader_object) instead of pipelines. The context
+        // binds them and sets all the state in GraphicsPipelineInfo dynamically
+        bool shaderObject;
     };
 
     PipelineManager() = default;
@@ -50,16 +124,116 @@ public:
 
     uint32_t create_basic_graphics_pipeline(const GraphicsPipelineInfo& info);
 
-    vk::Pipeline get_pipeline([[maybe_unused]] uint32_t index) const { return m_pipeline; }
+    // Returns the pipeline specialized for info, creating it on first use. Variants share the
+    // pipeline layout of their base pipeline
+    uint32_t get_pipeline_variant(uint32_t baseIndex, const PipelineVariantInfo& info);
+
+    vk::Pipeline get_pipeline(uint32_t index) const { return m_pipelines[index].pipeline; }
+    vk::PipelineLayout get_pipeline_layout(uint32_t index) const
+    {
+        return m_pipelineLayouts[m_pipelines[index].layoutIndex].layout;
+    }
+    // Same order as the shaders in the GraphicsPipelineInfo. Empty if not using shader objects
+    const std::vector<vk::ShaderEXT>& get_shader_objects(uint32_t index) const
+    {
+        return m_pipelines[index].shaderObjects;
+    }
+    const GraphicsPipelineInfo& get_pipeline_info(uint32_t index) const
+    {
+        return m_pipelines[index].info;
+    }
+    bool has_extended_dynamic_state() const { return m_extendedDynamicState; }
+    bool uses_shader_objects() const { return m_shaderObject; }
+    // Any stage of the pipeline declares a sampled image
+    bool samples_images(uint32_t index) const;
+
+    // Swaps in the pipelines optimized in the background. Call once per frame, before recording
+    // frameNumber. The replaced ones are retired to deletionQueue, frames in flight may use them
+    void update(DeletionQueue& deletionQueue, uint64_t frameNumber);
 
     void free();
 
+private:
+
+    struct LayoutData {
+        vk::PipelineLayout layout{};
+        // Also needed to create shader objects
+        std::vector<vk::DescriptorSetLayout> setLayouts{};
+        std::vector<vk::PushConstantRange> pushConstantRanges{};
+    };
+
+    uint32_t create_pipeline_layout(const GraphicsPipelineInfo& info, std::vector<Shader>& shaders);
+    // Builds a pipeline (or shader objects) with an existing layout. The shader modules are
+    // freed, their code is kept in the pipeline data
+    uint32_t add_pipeline(const GraphicsPipelineInfo& info,
+                          std::vector<Shader> shaders,
+                          uint32_t layoutIndex);
+    vk::Pipeline build_graphics_pipeline(const GraphicsPipelineInfo& info,
+                                         std::vector<Shader>& shaders,
+                                         vk::PipelineLayout layout,
+                                         uint32_t pipelineIndex);
+    std::vector<vk::ShaderEXT> build_shader_objects(const GraphicsPipelineInfo& info,
+                                                    std::vector<Shader>& shaders,
+                                                    const LayoutData& layout);
+
+    // Graphics pipeline library
+    vk::Pipeline link_pipeline_libraries(const GraphicsPipelineInfo& info,
+                                         const vk::GraphicsPipelineCreateInfo& fullInfo,
+                                         uint32_t pipelineIndex);
+    vk::Pipeline get_pipeline_library(std::vector<uint64_t> key,
+                                      vk::GraphicsPipelineLibraryFlagsEXT part,
+                                      vk::GraphicsPipelineCreateInfo partInfo,
+                                      const void* partNext);
+
+    struct Optimizer;
+    void enqueue_optimization(uint32_t pipelineIndex,
+                              const std::array<vk::Pipeline, 4>& libraries,
+                              vk::PipelineLayout layout);
+    static void optimizer_loop(vk::Device device, Optimizer* optimizer);
+    void stop_optimizer();
+
 private:
 
     vk::Device m_device{};
+    bool m_extendedDynamicState{};
+    bool m_graphicsPipelineLibrary{};
+    bool m_shaderObject{};
 
-    vk::Pipeline m_pipeline{};
-    vk::PipelineLayout m_pipelineLayout{};
+    struct PipelineData {
+        vk::Pipeline pipeline{};
+        std::vector<vk::ShaderEXT> shaderObjects{};
+        uint32_t layoutIndex{};
+        GraphicsPipelineInfo info{};  // Kept to create variants
+        std::vector<Shader> shaders{};  // Reflected code of info.shaders, also for variants
+    };
+
+    std::vector<PipelineData> m_pipelines{};
+    std::vector<LayoutData> m_pipelineLayouts{};
+    std::vector<vk::DescriptorSetLayout> m_descriptorSetLayouts{};
+
+    // {base index, declared feature bits, blend enable, baked cull mode} -> pipeline index
+    std::map<std::tuple<uint32_t, uint32_t, std::optional<vk::Bool32>, uint32_t>, uint32_t>
+        m_variants{};
+
+    // Graphics pipeline library
+    // Flattened state of the part (see pipeline.cpp) -> library
+    std::map<std::vector<uint64_t>, vk::Pipeline> m_pipelineLibraries{};
+
+    struct Optimizer {
+        struct Job {
+            uint32_t pipelineIndex{};
+            std::array<vk::Pipeline, 4> libraries{};
+            vk::PipelineLayout layout{};
+        };
+
+        std::thread thread{};
+        std::mutex mutex{};
+        std::condition_variable condition{};
+        std::deque<Job> jobs{};
+        std::vector<std::pair<uint32_t, vk::Pipeline>> finished{};
+        bool stop{};
+    };
+    std::unique_ptr<Optimizer> m_optimizer{};  // Behind a pointer to keep the manager movable
 };
 
 }  // namespace ec::vulkan
@@ -0,0 +1,74 @@
+#include "pch.hpp"
+#include "queue_timeline.hpp"
+
+namespace ec::vulkan
+{
+
+QueueTimeline::QueueTimeline(vk::Device device) :
+  m_device{ device }
+{
+    vk::SemaphoreTypeCreateInfo typeInfo{
+        .semaphoreType = vk::SemaphoreType::eTimeline,
+        .initialValue  = 0,
+    };
+    m_semaphore = m_device.createSemaphore(vk::SemaphoreCreateInfo{ .pNext = &typeInfo });
+}
+
+void QueueTimeline::free()
+{
+    if (m_semaphore) {
+        m_device.destroySemaphore(m_semaphore);
+        m_semaphore = nullptr;
+    }
+    m_lastSubmitted = 0;
+    m_completed     = 0;
+}
+
+vk::SemaphoreSubmitInfo QueueTimeline::signal_info(uint64_t value,
+                                                   vk::PipelineStageFlags2 stage) const
+{
+    EC_ASSERT(value <= m_lastSubmitted);
+    return vk::SemaphoreSubmitInfo{
+        .semaphore = m_semaphore,
+        .value     = value,
+        .stageMask = stage,
+    };
+}
+
+vk::SemaphoreSubmitInfo QueueTimeline::wait_info(uint64_t value,
+                                                 vk::PipelineStageFlags2 stage) const
+{
+    return vk::SemaphoreSubmitInfo{
+        .semaphore = m_semaphore,
+        .value     = value,
+        .stageMask = stage,
+    };
+}
+
+bool QueueTimeline::is_complete(uint64_t value)
+{
+    return value <= m_completed || value <= get_completed_value();
+}
+
+uint64_t QueueTimeline::get_completed_value()
+{
+    m_completed = m_device.getSemaphoreCounterValue(m_semaphore);
+    return m_completed;
+}
+
+void QueueTimeline::wait(uint64_t value)
+{
+    if (value <= m_completed) {
+        return;
+    }
+    std::ignore = m_device.waitSemaphores(
+        vk::SemaphoreWaitInfo{
+            .semaphoreCount = 1,
+            .pSemaphores    = &m_semaphore,
+            .pValues        = &value,
+        },
+        std::numeric_limits<uint64_t>::max());
+    m_completed = std::max(m_completed, value);
+}
+
+}  // namespace ec::vulkan
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+namespace ec::vulkan
+{
+
+// One timeline semaphore per queue. Every submission signals the next value, so the work of any
+// submission can be waited on or queried with a single number, without fences
+class QueueTimeline
+{
+public:
+
+    QueueTimeline() = default;
+    explicit QueueTimeline(vk::Device device);
+    QueueTimeline(QueueTimeline&&) = default;
+
+    QueueTimeline& operator=(QueueTimeline&&) = default;
+
+    void free();
+
+    // Reserves the value signaled by the next submission to the queue
+    uint64_t next_value() { return ++m_lastSubmitted; }
+    vk::SemaphoreSubmitInfo signal_info(
+        uint64_t value,
+        vk::PipelineStageFlags2 stage = vk::PipelineStageFlagBits2::eAllCommands) const;
+    // For submissions to other queues that depend on the work up to value
+    vk::SemaphoreSubmitInfo wait_info(
+        uint64_t value,
+        vk::PipelineStageFlags2 stage = vk::PipelineStageFlagBits2::eAllCommands) const;
+
+    // Only queries the device if the last known value is not enough
+    bool is_complete(uint64_t value);
+    uint64_t get_completed_value();
+    void wait(uint64_t value);
+    // Waits for everything submitted so far
+    void wait_all() { wait(m_lastSubmitted); }
+
+    uint64_t get_last_submitted() const { return m_lastSubmitted; }
+    vk::Semaphore get_handle() const { return m_semaphore; }
+
+private:
+
+    vk::Device m_device{};
+    vk::Semaphore m_semaphore{};
+    uint64_t m_lastSubmitted{};
+    uint64_t m_completed{};  // Last value read from the device
+};
+
+}  // namespace ec::vulkan
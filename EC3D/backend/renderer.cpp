@@ -12,7 +12,7 @@ namespace ec::vulkan
 {
 
 Renderer::Renderer(const Renderer::Info& info) :
-  m_window{ info.windowCreateInfo }
+  m_headless{ info.headless }
 {
     try {
         init(info);
@@ -27,16 +27,41 @@ Renderer::Renderer(const Renderer::Info& info) :
 
 Renderer::~Renderer() noexcept { }
 
+void Renderer::poll_events()
+{
+    if (m_headless) {
+        return;
+    }
+    m_window.poll_events();
+    if (m_window.consume_resize()) {
+        m_device.set_framebuffer_size(m_window.get_framebuffer_size());
+    }
+}
+
+void Renderer::wait_events()
+{
+    if (m_headless) {
+        return;
+    }
+    m_window.wait_events();
+    poll_events();
+}
+
 Buffer Renderer::create_buffer(const Buffer::Info& info)
 {
     return m_device.create_buffer(info);
 }
 
-void Renderer::transfer_data(Buffer& dstBuffer, size_t size, void* data)
+void Renderer::transfer_data(Buffer& dstBuffer, size_t size, const void* data)
 {
     m_device.transfer_to_buffer(dstBuffer, static_cast<vk::DeviceSize>(size), data);
 }
 
+void Renderer::transfer_data(const std::vector<BufferTransfer>& transfers)
+{
+    m_device.transfer_to_buffers(transfers);
+}
+
 void Renderer::init(const Renderer::Info& info)
 {
     // Get instance independent function pointers with the default dynamic loader
@@ -44,12 +69,17 @@ void Renderer::init(const Renderer::Info& info)
         = m_dynamicLoader.getProcAddress<PFN_vkGetInstanceProcAddr>("vkGetInstanceProcAddr");
     VULKAN_HPP_DEFAULT_DISPATCHER.init(vkGetInstanceProcAddr);
 
+    if (!m_headless) {
+        m_window = Window{ info.windowCreateInfo };
+    }
     create_instance(info.validationLayers, info.instanceExtensions);
     if (info.validationLayers) {
         create_debug_messenger();
     }
-    m_window.create_surface(m_instance);
-    create_device(info.deviceExtensions, info.verticalSync);
+    if (!m_headless) {
+        m_window.create_surface(m_instance);
+    }
+    create_device(info);
 }
 
 void Renderer::free()
@@ -89,7 +119,10 @@ void Renderer::create_instance(bool validationLayersEnabled,
         }
     }
 
-    auto extToEnable{ m_window.get_required_extensions() };
+    std::vector<const char*> extToEnable{};
+    if (!m_headless) {
+        extToEnable = m_window.get_required_extensions();
+    }
     extToEnable.insert(extToEnable.end(), requestedExtensions.begin(), requestedExtensions.end());
     if (validationLayersEnabled) {
         extToEnable.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -128,17 +161,21 @@ void Renderer::create_debug_messenger()
     m_debugMessenger = m_instance.createDebugUtilsMessengerEXT(debugMessengerCreateInfo);
 }
 
-void Renderer::create_device(const std::vector<const char*>& requestedExtensions,
-                             bool verticalSyncEnabled)
+void Renderer::create_device(const Renderer::Info& info)
 {
     std::vector<vk::PhysicalDevice> physDevices{ m_instance.enumeratePhysicalDevices() };
 
     Device::Info deviceInfo{
         .availablePhysicalDevices = physDevices,
-        .extensionsToEnable       = requestedExtensions,
-        .surface                  = m_window.get_surface(),
-        .framebufferSize          = m_window.get_framebuffer_size(),
-        .verticalSync             = verticalSyncEnabled,
+        .extensionsToEnable       = info.deviceExtensions,
+        .surface                  = m_window.get_surface(),  // Null if headless
+        .framebufferSize          = m_headless ? std::make_tuple(info.windowCreateInfo.width,
+                                                                 info.windowCreateInfo.height)
+                                               : m_window.get_framebuffer_size(),
+        .verticalSync             = info.verticalSync,
+        .swapchainImages          = info.swapchainImages,
+        .shaderObjects            = info.shaderObjects,
+        .recordAhead              = info.recordAhead,
     };
 
     m_device = Device(deviceInfo);
@@ -16,6 +16,13 @@ public:
     struct Info {
         bool validationLayers{};
         bool verticalSync{};
+        uint32_t swapchainImages{ 3 };  // Clamped to what the surface supports
+        bool shaderObjects{};  // Requires dynamic rendering, falls back to pipelines if unsupported
+        // No window or surface. Frames are rendered to an offscreen image ring sized like the
+        // window in windowCreateInfo, and never presented
+        bool headless{};
+        // Render to an intermediate image and only acquire the swapchain image to copy it
+        bool recordAhead{};
         std::vector<const char*> instanceExtensions{};
         std::vector<const char*> deviceExtensions{};
         Window::Info windowCreateInfo{};
@@ -32,8 +39,14 @@ public:
 
     void free();
 
-    inline bool close_signalled() const { return m_window.close_signalled(); };
-    inline void poll_events() { m_window.poll_events(); };
+    inline bool close_signalled() const { return !m_headless && m_window.close_signalled(); };
+    inline bool is_headless() const { return m_headless; }
+    // Also forwards framebuffer resizes to the swapchain
+    void poll_events();
+    // Blocks until there is a window event. Returns immediately if headless
+    void wait_events();
+    // Minimized or not shown. Never for headless rendering
+    inline bool is_window_hidden() const { return !m_headless && m_window.is_hidden(); }
     inline const vk::Format get_presentable_image_format()
     {
         return m_device.get_swapchain_image_format();
@@ -45,7 +58,29 @@ public:
     };
 
     Buffer create_buffer(const Buffer::Info& info);
-    void transfer_data(Buffer& dstBuffer, size_t size, void* data);
+    void free_buffer(Buffer& buffer) { m_device.free_buffer(buffer); }
+    void transfer_data(Buffer& dstBuffer, size_t size, const void* data);
+    // Batched, prefer it to several transfer_data calls
+    void transfer_data(const std::vector<BufferTransfer>& transfers);
+
+    Image create_texture(const ImageData& data) { return m_device.create_texture(data); }
+    void free_image(Image& image) { m_device.free_image(image); }
+    // Each image ends in the final layout of its transfer, with all its mip levels filled
+    void transfer_data(const std::vector<ImageTransfer>& transfers)
+    {
+        m_device.transfer_to_images(transfers);
+    }
+    // Doesn't wait, see Device::transfer_to_images_async
+    uint64_t transfer_data_async(const std::vector<ImageTransfer>& transfers)
+    {
+        return m_device.transfer_to_images_async(transfers);
+    }
+    bool is_transfer_complete(uint64_t transferValue)
+    {
+        return m_device.is_transfer_complete(transferValue);
+    }
+    MemoryBudget get_memory_budget() const { return m_device.get_memory_budget(); }
+    bool supports_uint8_indices() const { return m_device.supports_uint8_indices(); }
 
 private:
 
@@ -53,11 +88,11 @@ private:
     void create_instance(const bool validationLayersEnabled,
                          const std::vector<const char*>& instExtensions);
     void create_debug_messenger();
-    void create_device(const std::vector<const char*>& requestedExtensions,
-                       bool verticalSyncEnabled);
+    void create_device(const Renderer::Info& info);
 
 private:
 
+    bool m_headless{};
     Window m_window;
 
     vk::Instance m_instance;
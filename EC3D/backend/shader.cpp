@@ -26,12 +26,17 @@ vk::ShaderModule Shader::create_shader_module(vk::Device device)
     return m_shaderModule;
 }
 
-void Shader::free(vk::Device device)
+void Shader::free_module(vk::Device device)
 {
     if (m_shaderModule) {
         device.destroyShaderModule(m_shaderModule);
         m_shaderModule = nullptr;
     }
+}
+
+void Shader::free(vk::Device device)
+{
+    free_module(device);
     m_code.clear();
 }
 
@@ -50,9 +55,25 @@ void Shader::insert_binding(const spirv_cross::Compiler& comp,
     });
 }
 
-void Shader::init_resources()
+bool Shader::is_dynamic_buffer(
+    const spirv_cross::Compiler& comp,
+    const spirv_cross::Resource& resource,
+    const std::vector<std::pair<uint32_t, uint32_t>>& dynamicBuffers) const
+{
+    uint32_t set{ comp.get_decoration(resource.id, spv::DecorationDescriptorSet) };
+    uint32_t binding{ comp.get_decoration(resource.id, spv::DecorationBinding) };
+    if (std::ranges::find(dynamicBuffers, std::make_pair(set, binding)) != dynamicBuffers.end()) {
+        return true;
+    }
+
+    // Naming convention, checked on both the block name and the instance name
+    const std::string& instanceName{ comp.get_name(resource.id) };
+    return resource.name.ends_with(DYNAMIC_BUFFER_SUFFIX)
+           || instanceName.ends_with(DYNAMIC_BUFFER_SUFFIX);
+}
+
+void Shader::init_resources(const std::vector<std::pair<uint32_t, uint32_t>>& dynamicBuffers)
 {
-    // TODO: Remove std::move if the shader is to be used many times
     spirv_cross::Compiler comp(m_code);
     auto resources = comp.get_shader_resources();
 
@@ -80,16 +101,27 @@ void Shader::init_resources()
     for (const auto& resource : resources.separate_samplers) {
         insert_binding(comp, resource, vk::DescriptorType::eSampler);
     }
-    // TODO: Dynamic uniform buffers
     for (const auto& resource : resources.uniform_buffers) {
-        insert_binding(comp, resource, vk::DescriptorType::eUniformBuffer);
+        insert_binding(comp,
+                       resource,
+                       is_dynamic_buffer(comp, resource, dynamicBuffers)
+                           ? vk::DescriptorType::eUniformBufferDynamic
+                           : vk::DescriptorType::eUniformBuffer);
     }
     for (const auto& resource : resources.subpass_inputs) {
         insert_binding(comp, resource, vk::DescriptorType::eInputAttachment);
     }
-    // TODO: Dynamic storage buffers
     for (const auto& resource : resources.storage_buffers) {
-        insert_binding(comp, resource, vk::DescriptorType::eStorageBuffer);
+        insert_binding(comp,
+                       resource,
+                       is_dynamic_buffer(comp, resource, dynamicBuffers)
+                           ? vk::DescriptorType::eStorageBufferDynamic
+                           : vk::DescriptorType::eStorageBuffer);
+    }
+
+    m_specializationConstantIds.clear();
+    for (const auto& constant : comp.get_specialization_constants()) {
+        m_specializationConstantIds.push_back(constant.constant_id);
     }
 
     for (const auto& resource : resources.push_constant_buffers) {
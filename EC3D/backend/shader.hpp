@@ -11,6 +11,8 @@ class Shader
 {
 public:
 
+    constexpr static std::string_view DYNAMIC_BUFFER_SUFFIX{ "Dynamic" };
+
     Shader() = default;
 
     void init_from_spirv(std::string_view filePath);
@@ -20,11 +22,22 @@ public:
 
     inline const auto& get_descriptor_set_bindings() const { return m_setBindings; }
     inline const auto& get_push_constant_range() const { return m_pushConstantRange; }
+    // constant_id of every specialization constant the code declares
+    inline const auto& get_specialization_constant_ids() const
+    {
+        return m_specializationConstantIds;
+    }
+    // SPIR-V words, used to create shader objects (VK_EXT_shader_object) instead of modules
+    inline const auto& get_code() const { return m_code; }
 
     // Initializes descriptor set layout create infos and push constant ranges with reflection API
     // ShaderModule should be created before this call
-    void init_resources();
+    // Uniform/storage buffers are reflected as dynamic if their block or instance name ends with
+    // DYNAMIC_BUFFER_SUFFIX, or if their {set, binding} is in dynamicBuffers
+    void init_resources(const std::vector<std::pair<uint32_t, uint32_t>>& dynamicBuffers = {});
 
+    // Keeps the code and the reflected resources, to create other modules from them
+    void free_module(vk::Device device);
     void free(vk::Device device);
 
 private:
@@ -32,6 +45,9 @@ private:
     void insert_binding(const spirv_cross::Compiler& comp,
                         const spirv_cross::Resource& resource,
                         vk::DescriptorType descriptorType);
+    bool is_dynamic_buffer(const spirv_cross::Compiler& comp,
+                           const spirv_cross::Resource& resource,
+                           const std::vector<std::pair<uint32_t, uint32_t>>& dynamicBuffers) const;
 
 private:
 
@@ -41,6 +57,7 @@ private:
     // setBindings[i] contains the bindings of set i, to facilitate pipeline layout creation
     std::unordered_map<uint32_t, std::set<vk::DescriptorSetLayoutBinding>> m_setBindings{};
     std::optional<vk::PushConstantRange> m_pushConstantRange{};
+    std::vector<uint32_t> m_specializationConstantIds{};
 };
 
 }  // namespace ec::vulkan
@@ -9,10 +9,25 @@ namespace ec::vulkan
 {
 
 Swapchain::Swapchain(const Swapchain::Info& info) :
-  m_device(info.device)
+  m_device(info.device),
+  m_physDevice(info.physDevice),
+  m_surface(info.surface),
+  m_framebufferSize(info.framebufferSize),
+  m_verticalSync(info.verticalSync),
+  m_requestedImageCount(info.imageCount),
+  m_minOffscreenImages(info.minOffscreenImages)
 {
+    // Prefer mailbox without vertical sync (uses newest image to display instead of first to
+    // arrive, not limited to refresh rate of the monitor)
+    m_requestedPresentMode = m_verticalSync ? vk::PresentModeKHR::eFifo
+                                            : vk::PresentModeKHR::eMailbox;
     try {
-        create(info);
+        if (is_headless()) {
+            create_offscreen_images();
+        } else {
+            create(VK_NULL_HANDLE);
+            create_image_views();
+        }
     }
     catch (const std::exception& e) {
         EC_LOG_CRITICAL("Unable to create a swapchain. Reason: {}", e.what());
@@ -21,22 +36,20 @@ Swapchain::Swapchain(const Swapchain::Info& info) :
     }
 }
 
-void Swapchain::create(const Swapchain::Info& info)
+void Swapchain::create(vk::SwapchainKHR oldSwapchain)
 {
-    auto& surface{ info.surface };
-    auto& physDevice{ info.physDevice };
+    auto& surface{ m_surface };
+    auto& physDevice{ m_physDevice };
 
     auto surfaceCapabilities{ physDevice.getSurfaceCapabilitiesKHR(surface) };
-    uint32_t imageCount = (surfaceCapabilities.minImageCount + 1 > 3)
-                              ? surfaceCapabilities.minImageCount + 1
-                              : 3;  // We want triple buffering
+    uint32_t imageCount{ std::max(m_requestedImageCount, surfaceCapabilities.minImageCount) };
     if (surfaceCapabilities.maxImageCount > 0 && surfaceCapabilities.maxImageCount < imageCount) {
         imageCount = surfaceCapabilities.maxImageCount;
     }
 
     auto surfaceFormats{ physDevice.getSurfaceFormatsKHR(surface) };
     vk::SurfaceFormatKHR swapchainFormat{ select_format(surfaceFormats) };
-    vk::Extent2D swapchainExtent{ select_extent(surfaceCapabilities, info.framebufferSize) };
+    vk::Extent2D swapchainExtent{ select_extent(surfaceCapabilities, m_framebufferSize) };
     std::array<vk::CompositeAlphaFlagBitsKHR, 4> compositeAlphaValues{
         vk::CompositeAlphaFlagBitsKHR::eOpaque,
         vk::CompositeAlphaFlagBitsKHR::ePreMultiplied,
@@ -51,17 +64,22 @@ void Swapchain::create(const Swapchain::Info& info)
         }
     }
 
-    auto swapchainPresentMode{ vk::PresentModeKHR::eFifo };  // By default (should be available)
-    // Prefer mailbox (uses newest image to display instead of first to arrive, not limited to
-    // refresh rate of the monitor)
-    if (!info.verticalSync) {
-        auto surfacePresentModes{ physDevice.getSurfacePresentModesKHR(surface) };
-        for (auto& presentMode : surfacePresentModes) {
-            if (presentMode == vk::PresentModeKHR::eMailbox) {
-                swapchainPresentMode = vk::PresentModeKHR::eMailbox;
-                break;
-            }
-        }
+    // FIFO is always supported, used if the requested mode is not
+    auto swapchainPresentMode{ vk::PresentModeKHR::eFifo };
+    if (is_present_mode_supported(m_requestedPresentMode)) {
+        swapchainPresentMode = m_requestedPresentMode;
+    }
+
+    vk::ImageUsageFlags imageUsage{ vk::ImageUsageFlagBits::eColorAttachment };
+    m_supportsTransferSrc = static_cast<bool>(surfaceCapabilities.supportedUsageFlags
+                                              & vk::ImageUsageFlagBits::eTransferSrc);
+    if (m_supportsTransferSrc) {
+        imageUsage |= vk::ImageUsageFlagBits::eTransferSrc;
+    }
+    m_supportsTransferDst = static_cast<bool>(surfaceCapabilities.supportedUsageFlags
+                                              & vk::ImageUsageFlagBits::eTransferDst);
+    if (m_supportsTransferDst) {
+        imageUsage |= vk::ImageUsageFlagBits::eTransferDst;
     }
 
     vk::SwapchainCreateInfoKHR swapchainCreateInfo{
@@ -71,21 +89,24 @@ void Swapchain::create(const Swapchain::Info& info)
         .imageColorSpace  = swapchainFormat.colorSpace,
         .imageExtent      = swapchainExtent,
         .imageArrayLayers = 1,
-        .imageUsage       = vk::ImageUsageFlagBits::eColorAttachment,
+        .imageUsage       = imageUsage,
         .imageSharingMode = vk::SharingMode::eExclusive,
         .preTransform     = surfaceCapabilities.currentTransform,
         .compositeAlpha   = selectedCompositeAlpha,
         .presentMode      = swapchainPresentMode,
         .clipped          = VK_TRUE,
-        .oldSwapchain     = VK_NULL_HANDLE,
+        .oldSwapchain     = oldSwapchain,
     };
 
-    // TODO: Check other usages (transfer src/dst)
     m_swapchain = m_device.createSwapchainKHR(swapchainCreateInfo);
 
     m_swapchainImageFormat = swapchainFormat;
     m_swapchainExtent      = swapchainExtent;
+    m_presentMode          = swapchainPresentMode;
+}
 
+void Swapchain::create_image_views()
+{
     auto swapchainImages{ m_device.getSwapchainImagesKHR(m_swapchain) };
     m_swapchainImages.resize(swapchainImages.size());
 
@@ -99,10 +120,46 @@ void Swapchain::create(const Swapchain::Info& info)
     }
 }
 
+void Swapchain::create_offscreen_images()
+{
+    auto [width, height]{ m_framebufferSize };
+    m_swapchainImageFormat = { vk::Format::eR8G8B8A8Unorm, vk::ColorSpaceKHR::eSrgbNonlinear };
+    m_swapchainExtent      = { static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
+
+    vk::PhysicalDeviceMemoryProperties memoryProperties{ m_physDevice.getMemoryProperties() };
+    Image::Info imageInfo{
+        .width                  = m_swapchainExtent.width,
+        .height                 = m_swapchainExtent.height,
+        .format                 = m_swapchainImageFormat.format,
+        .usage                  = vk::ImageUsageFlagBits::eColorAttachment
+                                  | vk::ImageUsageFlagBits::eTransferSrc,
+        .samples                = vk::SampleCountFlagBits::e1,
+        .layout                 = vk::ImageLayout::eUndefined,
+        .memoryProperties       = vk::MemoryPropertyFlagBits::eDeviceLocal,
+        .deviceMemoryProperties = memoryProperties,
+    };
+
+    m_supportsTransferSrc = true;
+    uint32_t imageCount{ std::max(m_requestedImageCount, m_minOffscreenImages) };
+    m_swapchainImages.resize(imageCount);
+    for (auto& swapchainImage : m_swapchainImages) {
+        Image offscreenImage{ m_device, imageInfo };
+        offscreenImage.create_view(m_swapchainImageFormat.format, vk::ImageAspectFlagBits::eColor);
+        swapchainImage = {
+            .image = std::move(offscreenImage),
+        };
+    }
+    m_nextOffscreenImage = 0;
+}
+
 void Swapchain::free(vk::Device device)
 {
     for (auto& img : m_swapchainImages) {
-        img.image.delete_view();
+        if (is_headless()) {
+            img.image.free();
+        } else {
+            img.image.delete_view();
+        }
     }
     m_swapchainImages.clear();
     if (m_swapchain) {
@@ -111,16 +168,103 @@ void Swapchain::free(vk::Device device)
     }
 }
 
-void Swapchain::recreate() { }
+std::optional<RetiredSwapchain> Swapchain::recreate()
+{
+    if (is_headless()) {
+        RetiredSwapchain retired{};
+        for (auto& img : m_swapchainImages) {
+            retired.offscreenImages.push_back(std::move(img.image));
+        }
+        m_swapchainImages.clear();
+        create_offscreen_images();
+        m_outOfDate = false;
+        return retired;
+    }
+
+    vk::Extent2D extent{ select_extent(m_physDevice.getSurfaceCapabilitiesKHR(m_surface),
+                                       m_framebufferSize) };
+    if (extent.width == 0 || extent.height == 0) {
+        return std::nullopt;
+    }
+
+    RetiredSwapchain retired{ .swapchain = m_swapchain };
+    for (auto& img : m_swapchainImages) {
+        retired.imageViews.push_back(img.image.get_image_view());
+    }
+    m_swapchainImages.clear();
+
+    // The old swapchain stays valid for the images already presented from it
+    create(retired.swapchain);
+    create_image_views();
+    m_outOfDate = false;
+
+    return retired;
+}
+
+void Swapchain::set_framebuffer_size(std::tuple<int, int> framebufferSize)
+{
+    m_framebufferSize = framebufferSize;
+    m_outOfDate       = true;
+}
+
+std::vector<vk::PresentModeKHR> Swapchain::get_supported_present_modes() const
+{
+    if (is_headless()) {
+        return {};
+    }
+    return m_physDevice.getSurfacePresentModesKHR(m_surface);
+}
+
+bool Swapchain::is_present_mode_supported(vk::PresentModeKHR presentMode) const
+{
+    auto supportedModes{ get_supported_present_modes() };
+    return std::ranges::find(supportedModes, presentMode) != supportedModes.end();
+}
+
+void Swapchain::set_present_mode(vk::PresentModeKHR presentMode)
+{
+    if (!is_headless() && !is_present_mode_supported(presentMode)) {
+        EC_LOG_WARN("Present mode {} is not supported, using FIFO", vk::to_string(presentMode));
+    }
+    if (presentMode != m_requestedPresentMode) {
+        m_requestedPresentMode = presentMode;
+        m_outOfDate            = !is_headless();
+    }
+}
 
-uint32_t Swapchain::acquire_next_image(vk::Semaphore& imageAvailableSemaphore) const
+void Swapchain::set_image_count(uint32_t imageCount)
 {
+    if (imageCount != m_requestedImageCount) {
+        m_requestedImageCount = imageCount;
+        m_outOfDate           = true;
+    }
+}
+
+vk::Result Swapchain::acquire_next_image(vk::Semaphore imageAvailableSemaphore,
+                                         uint32_t& imageIndex)
+{
+    if (is_headless()) {
+        // The ring has an image per frame that can be in flight, so the next one is never in use
+        imageIndex           = m_nextOffscreenImage;
+        m_nextOffscreenImage = (m_nextOffscreenImage + 1)
+                               % static_cast<uint32_t>(m_swapchainImages.size());
+        return vk::Result::eSuccess;
+    }
 #undef max
-    return m_device
-        .acquireNextImageKHR(m_swapchain,
-                             std::numeric_limits<uint64_t>::max(),
-                             imageAvailableSemaphore)
-        .value;
+    try {
+        auto [result, index]{ m_device.acquireNextImageKHR(m_swapchain,
+                                                           std::numeric_limits<uint64_t>::max(),
+                                                           imageAvailableSemaphore) };
+        if (result == vk::Result::eSuboptimalKHR) {
+            m_outOfDate = true;
+        }
+        imageIndex = index;
+        return result;
+    }
+    catch (const vk::OutOfDateKHRError&) {
+        m_outOfDate = true;
+        return vk::Result::eErrorOutOfDateKHR;
+    }
 }
 
 vk::SurfaceFormatKHR Swapchain::select_format(
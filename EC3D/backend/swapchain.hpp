@@ -3,6 +3,8 @@
 #include "window.hpp"
 #include "image.hpp"
 
+#include <optional>
+
 namespace ec::vulkan
 {
 
@@ -10,6 +12,16 @@ struct SwapchainImage {
     Image image;
 };
 
+// Handles replaced by a recreation, to be destroyed once the frames using them are done
+struct RetiredSwapchain {
+    vk::SwapchainKHR swapchain{};
+    std::vector<vk::ImageView> imageViews{};
+    std::vector<Image> offscreenImages{};  // Headless only, owned by the swapchain
+};
+
+// Presentation to a surface or, without one (headless), a ring of offscreen images that are
+// acquired in order and never presented
+
 class Swapchain
 {
 public:
@@ -17,9 +29,13 @@ public:
     struct Info {
         vk::PhysicalDevice physDevice;
         vk::Device device;
-        vk::SurfaceKHR surface;
+        vk::SurfaceKHR surface;  // Null for headless
         const std::tuple<int, int> framebufferSize;
         bool verticalSync;
+        uint32_t imageCount;  // Requested, at least the minimum of the surface
+        // Offscreen images are never fewer, e.g. the frames that can be in flight, see
+        // acquire_next_image
+        uint32_t minOffscreenImages;
     };
 
     Swapchain() = default;
@@ -29,9 +45,35 @@ public:
     Swapchain& operator=(Swapchain&&) = default;
 
     void free(vk::Device device);
-    void recreate();
 
-    uint32_t acquire_next_image(vk::Semaphore& imageAvailableSemaphore) const;
+    // Creates a new swapchain passing the current one as oldSwapchain. Returns nothing (and keeps
+    // the current swapchain) if the surface has no area, e.g. the window is minimized
+    std::optional<RetiredSwapchain> recreate();
+
+    // Marks the swapchain for recreation, e.g. when the window framebuffer is resized
+    void set_framebuffer_size(std::tuple<int, int> framebufferSize);
+    // Marks the swapchain for recreation with another number of images. Fewer images mean less
+    // latency, but rendering may block more often waiting for one
+    void set_image_count(uint32_t imageCount);
+    // Marks the swapchain for recreation with another present mode. Falls back to FIFO if the
+    // surface doesn't support it. Ignored if headless
+    void set_present_mode(vk::PresentModeKHR presentMode);
+    // Empty if headless
+    std::vector<vk::PresentModeKHR> get_supported_present_modes() const;
+    bool is_present_mode_supported(vk::PresentModeKHR presentMode) const;
+    vk::PresentModeKHR get_present_mode() const { return m_presentMode; }
+    void mark_out_of_date() { m_outOfDate = true; }
+    bool is_out_of_date() const { return m_outOfDate; }
+
+    // Returns eErrorOutOfDateKHR instead of throwing. Suboptimal images are returned as acquired,
+    // and the swapchain is marked out of date. Headless swapchains do not signal the semaphore
+    vk::Result acquire_next_image(vk::Semaphore imageAvailableSemaphore, uint32_t& imageIndex);
+
+    bool is_headless() const { return !m_surface; }
+    // Images can be copied from (e.g. to read them back)
+    bool supports_transfer_src() const { return m_supportsTransferSrc; }
+    // Images can be copied to (e.g. from an intermediate render target)
+    bool supports_transfer_dst() const { return m_supportsTransferDst; }
 
     inline vk::SwapchainKHR get_handle() const { return m_swapchain; }
     const SwapchainImage& get_image(uint32_t index) const { return m_swapchainImages[index]; }
@@ -41,7 +83,9 @@ public:
 
 private:
 
-    void create(const Swapchain::Info& info);
+    void create(vk::SwapchainKHR oldSwapchain);
+    void create_image_views();
+    void create_offscreen_images();
     vk::SurfaceFormatKHR select_format(
         const std::vector<vk::SurfaceFormatKHR>& availableFormats) const;
     vk::Extent2D select_extent(const vk::SurfaceCapabilitiesKHR& surfaceCapabilities,
@@ -50,6 +94,17 @@ private:
 private:
 
     vk::Device m_device;
+    vk::PhysicalDevice m_physDevice;
+    vk::SurfaceKHR m_surface;
+    std::tuple<int, int> m_framebufferSize{};
+    bool m_verticalSync{};
+    uint32_t m_requestedImageCount{};
+    uint32_t m_minOffscreenImages{};
+    vk::PresentModeKHR m_requestedPresentMode{};
+    vk::PresentModeKHR m_presentMode{};  // Of the current swapchain
+    bool m_outOfDate{};
+    bool m_supportsTransferSrc{};
+    bool m_supportsTransferDst{};
 
     vk::SwapchainKHR m_swapchain;
 
@@ -57,6 +112,7 @@ private:
     vk::Extent2D m_swapchainExtent;
 
     std::vector<SwapchainImage> m_swapchainImages{};
+    uint32_t m_nextOffscreenImage{};  // Headless only
 };
 
 }  // namespace ec::vulkan
@@ -0,0 +1,86 @@
+#include "pch.hpp"
+#include "uniform_ring.hpp"
+
+namespace ec::vulkan
+{
+
+static Buffer::Info ring_buffer_info(const UniformRing::Info& info)
+{
+    vk::BufferUsageFlags usage{ vk::BufferUsageFlagBits::eUniformBuffer
+                                | vk::BufferUsageFlagBits::eStorageBuffer };
+    if (info.deviceAddress) {
+        usage |= vk::BufferUsageFlagBits::eShaderDeviceAddress;
+    }
+    vk::DeviceSize alignedFrameSize{ (info.bytesPerFrame + info.alignment - 1)
+                                     & ~(info.alignment - 1) };
+    return Buffer::Info{
+        .count    = info.numFrames,
+        .elemSize = alignedFrameSize,
+        .usage    = usage,
+        .memoryProperties
+        = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+    };
+}
+
+UniformRing::UniformRing(vk::Device device,
+                         const vk::PhysicalDeviceMemoryProperties& deviceMemoryProperties,
+                         const std::vector<uint32_t>& queueFamilies,
+                         const UniformRing::Info& info) :
+  m_buffer{ device, deviceMemoryProperties, queueFamilies, ring_buffer_info(info) },
+  m_alignment{ info.alignment }
+{
+    EC_ASSERT(info.alignment > 0 && (info.alignment & (info.alignment - 1)) == 0);
+    try {
+        m_frameSize  = m_buffer.get_size() / info.numFrames;
+        m_mappedData = static_cast<std::byte*>(m_buffer.map());
+        if (info.deviceAddress) {
+            m_baseAddress = m_buffer.get_device_address();
+        }
+    }
+    catch (const std::exception& e) {
+        EC_LOG_ERROR("Failed to map the uniform ring. Reason: {}", e.what());
+        free();
+        throw;
+    }
+}
+
+void UniformRing::free()
+{
+    m_buffer.free();
+    m_mappedData = nullptr;
+}
+
+void UniformRing::begin_frame(uint32_t frameIndex)
+{
+    m_frameBegin = m_frameSize * frameIndex;
+    m_head       = m_frameBegin;
+}
+
+BufferAllocation UniformRing::allocate(vk::DeviceSize size)
+{
+    vk::DeviceSize offset{ m_head };
+    vk::DeviceSize alignedSize{ get_aligned_size(size) };
+    if (offset + alignedSize > m_frameBegin + m_frameSize) {
+        throw std::runtime_error(
+            std::format("Uniform ring out of memory! Frame size: {}, requested: {}, used: {}",
+                        m_frameSize,
+                        size,
+                        get_frame_usage()));
+    }
+    m_head += alignedSize;
+
+    return BufferAllocation{
+        .buffer        = m_buffer.get_handle(),
+        .offset        = offset,
+        .size          = size,
+        .deviceAddress = m_baseAddress ? m_baseAddress + offset : 0,
+        .data          = m_mappedData + offset,
+    };
+}
+
+BufferAllocation UniformRing::allocate_array(uint32_t count, vk::DeviceSize elemSize)
+{
+    return allocate(get_aligned_size(elemSize) * count);
+}
+
+}  // namespace ec::vulkan
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include "buffer.hpp"
+
+namespace ec::vulkan
+{
+
+// Sub-allocation of a UniformRing, valid until the same frame slot comes around again
+struct BufferAllocation {
+    vk::Buffer buffer{};
+    vk::DeviceSize offset{};
+    vk::DeviceSize size{};
+    vk::DeviceAddress deviceAddress{};  // 0 if device addresses are not enabled
+    void* data{};
+
+    uint32_t get_dynamic_offset() const { return static_cast<uint32_t>(offset); }
+};
+
+// Persistently mapped host-visible buffer split in one region per frame in flight. Allocations
+// are a bump of the head of the current frame region, so per-frame constants cost a memcpy
+class UniformRing
+{
+public:
+
+    struct Info {
+        vk::DeviceSize bytesPerFrame;
+        uint32_t numFrames;
+        vk::DeviceSize alignment;  // Max of the min uniform/storage buffer offset alignments
+        bool deviceAddress;
+    };
+
+    UniformRing(vk::Device device,
+                const vk::PhysicalDeviceMemoryProperties& deviceMemoryProperties,
+                const std::vector<uint32_t>& queueFamilies,
+                const UniformRing::Info& info);
+    UniformRing(UniformRing&&) = default;
+
+    UniformRing& operator=(UniformRing&&) = default;
+
+    void free();
+
+    // Resets the head of the region of frameIndex. Must only be called once the GPU is done
+    // with the frame that last used that region
+    void begin_frame(uint32_t frameIndex);
+
+    BufferAllocation allocate(vk::DeviceSize size);
+
+    // count elements, each one starting at an aligned offset (get_aligned_size(elemSize) apart),
+    // so each of them can be addressed with a dynamic offset
+    BufferAllocation allocate_array(uint32_t count, vk::DeviceSize elemSize);
+
+    template<typename T>
+    BufferAllocation push(const T& data)
+    {
+        BufferAllocation allocation{ allocate(sizeof(T)) };
+        memcpy(allocation.data, &data, sizeof(T));
+        return allocation;
+    }
+
+    vk::DeviceSize get_aligned_size(vk::DeviceSize size) const
+    {
+        return (size + m_alignment - 1) & ~(m_alignment - 1);
+    }
+
+    inline vk::Buffer get_handle() const { return m_buffer.get_handle(); }
+    vk::DeviceSize get_frame_size() const { return m_frameSize; }
+    vk::DeviceSize get_frame_usage() const { return m_head - m_frameBegin; }
+
+private:
+
+    Buffer m_buffer;
+    std::byte* m_mappedData{};
+    vk::DeviceAddress m_baseAddress{};
+
+    vk::DeviceSize m_alignment{};
+    vk::DeviceSize m_frameSize{};
+    vk::DeviceSize m_frameBegin{};
+    vk::DeviceSize m_head{};
+};
+
+}  // namespace ec::vulkan
@@ -2,6 +2,7 @@
 
 #include "utils.hpp"
 #include <fstream>
+#include <vulkan/vulkan_format_traits.hpp>
 #include <ranges>
 
 namespace ec::vulkan
@@ -53,4 +54,89 @@ std::vector<uint32_t> read_file(std::string_view filePath)
     return fileData;
 }
 
+bool format_has_stencil(vk::Format format)
+{
+    switch (format) {
+        case vk::Format::eS8Uint:
+        case vk::Format::eD16UnormS8Uint:
+        case vk::Format::eD24UnormS8Uint:
+        case vk::Format::eD32SfloatS8Uint: return true;
+        default: return false;
+    }
+}
+
+vk::Extent3D mip_level_extent(const vk::Extent3D& extent, uint32_t level)
+{
+    return vk::Extent3D{
+        .width  = std::max(extent.width >> level, 1u),
+        .height = std::max(extent.height >> level, 1u),
+        .depth  = std::max(extent.depth >> level, 1u),
+    };
+}
+
+vk::DeviceSize image_level_size(vk::Format format,
+                                const vk::Extent3D& extent,
+                                uint32_t level,
+                                uint32_t layers)
+{
+    // Partial blocks at the edges are stored whole
+    vk::Extent3D levelExtent{ mip_level_extent(extent, level) };
+    auto blockExtent{ vk::blockExtent(format) };
+    auto blocks{ [](uint32_t texels, uint32_t blockTexels) {
+        return static_cast<vk::DeviceSize>((texels + blockTexels - 1) / blockTexels);
+    } };
+    return blocks(levelExtent.width, blockExtent[0]) * blocks(levelExtent.height, blockExtent[1])
+           * blocks(levelExtent.depth, blockExtent[2]) * vk::blockSize(format) * layers;
+}
+
+std::pair<vk::PipelineStageFlags2, vk::AccessFlags2> layout_stage_access(vk::ImageLayout layout)
+{
+    using Stage  = vk::PipelineStageFlagBits2;
+    using Access = vk::AccessFlagBits2;
+    switch (layout) {
+        case vk::ImageLayout::eUndefined:
+            // Nothing to make visible, but still chain with semaphore waits (e.g. acquire)
+            return { Stage::eAllCommands, Access::eNone };
+        case vk::ImageLayout::eColorAttachmentOptimal:
+            return { Stage::eColorAttachmentOutput,
+                     Access::eColorAttachmentRead | Access::eColorAttachmentWrite };
+        case vk::ImageLayout::eDepthStencilAttachmentOptimal:
+        case vk::ImageLayout::eDepthAttachmentOptimal:
+            return { Stage::eEarlyFragmentTests | Stage::eLateFragmentTests,
+                     Access::eDepthStencilAttachmentRead | Access::eDepthStencilAttachmentWrite };
+        case vk::ImageLayout::eShaderReadOnlyOptimal:
+            return { Stage::eVertexShader | Stage::eFragmentShader | Stage::eComputeShader,
+                     Access::eShaderRead };
+        case vk::ImageLayout::eTransferSrcOptimal: return { Stage::eTransfer, Access::eTransferRead };
+        case vk::ImageLayout::eTransferDstOptimal:
+            return { Stage::eTransfer, Access::eTransferWrite };
+        case vk::ImageLayout::ePresentSrcKHR:
+            // Visibility to the presentation engine is handled by the present semaphore
+            return { Stage::eAllCommands, Access::eNone };
+        default:
+            return { Stage::eAllCommands, Access::eMemoryRead | Access::eMemoryWrite };
+    }
+}
+
+vk::ImageMemoryBarrier2 layout_transition_barrier(vk::Image image,
+                                                  vk::ImageLayout oldLayout,
+                                                  vk::ImageLayout newLayout,
+                                                  const vk::ImageSubresourceRange& range)
+{
+    auto [srcStage, srcAccess] = layout_stage_access(oldLayout);
+    auto [dstStage, dstAccess] = layout_stage_access(newLayout);
+    return vk::ImageMemoryBarrier2{
+        .srcStageMask        = srcStage,
+        .srcAccessMask       = srcAccess,
+        .dstStageMask        = dstStage,
+        .dstAccessMask       = dstAccess,
+        .oldLayout           = oldLayout,
+        .newLayout           = newLayout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image               = image,
+        .subresourceRange    = range,
+    };
+}
+
 }  // namespace ec::vulkan
\ No newline at end of file
@@ -16,4 +16,21 @@ uint32_t find_memory_type_index(vk::PhysicalDeviceMemoryProperties availableMemo
 
 std::vector<uint32_t> read_file(std::string_view filePath);
 
+bool format_has_stencil(vk::Format format);
+
+vk::Extent3D mip_level_extent(const vk::Extent3D& extent, uint32_t level);
+// Bytes of a mip level with all its layers tightly packed, block compressed formats included
+vk::DeviceSize image_level_size(vk::Format format,
+                                const vk::Extent3D& extent,
+                                uint32_t level,
+                                uint32_t layers);
+
+// Stages and accesses that may use an image in the given layout, to build layout transitions
+std::pair<vk::PipelineStageFlags2, vk::AccessFlags2> layout_stage_access(vk::ImageLayout layout);
+
+vk::ImageMemoryBarrier2 layout_transition_barrier(vk::Image image,
+                                                  vk::ImageLayout oldLayout,
+                                                  vk::ImageLayout newLayout,
+                                                  const vk::ImageSubresourceRange& range);
+
 }  // namespace ec::vulkan
\ No newline at end of file
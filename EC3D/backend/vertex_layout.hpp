@@ -0,0 +1,100 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <glm/glm.hpp>
+#include "pipeline.hpp"
+
+#include <algorithm>
+#include <array>
+#include <type_traits>
+
+namespace ec::vulkan
+{
+
+// Vertex attribute stored in a format with no matching glm type. Read as floats by the shaders
+template <vk::Format Format, typename T, size_t N>
+struct PackedAttribute {
+    std::array<T, N> components{};
+};
+
+using Snorm16x4 = PackedAttribute<vk::Format::eR16G16B16A16Snorm, int16_t, 4>;
+using Snorm16x2 = PackedAttribute<vk::Format::eR16G16Snorm, int16_t, 2>;
+using Half2     = PackedAttribute<vk::Format::eR16G16Sfloat, uint16_t, 2>;
+using Unorm8x4  = PackedAttribute<vk::Format::eR8G8B8A8Unorm, uint8_t, 4>;
+
+// Format of a vertex attribute of type T, undefined for types that can't be vertex attributes
+template <typename T>
+constexpr vk::Format VERTEX_FORMAT{ vk::Format::eUndefined };
+
+template <>
+constexpr vk::Format VERTEX_FORMAT<float>{ vk::Format::eR32Sfloat };
+template <>
+constexpr vk::Format VERTEX_FORMAT<glm::vec2>{ vk::Format::eR32G32Sfloat };
+template <>
+constexpr vk::Format VERTEX_FORMAT<glm::vec3>{ vk::Format::eR32G32B32Sfloat };
+template <>
+constexpr vk::Format VERTEX_FORMAT<glm::vec4>{ vk::Format::eR32G32B32A32Sfloat };
+template <vk::Format Format, typename T, size_t N>
+constexpr vk::Format VERTEX_FORMAT<PackedAttribute<Format, T, N>>{ Format };
+
+// Vertex input of a struct, computed at compile time from its members. Members must be all the
+// members of Vertex in declaration order, attribute i is read from shader location i. e.g.
+// using Layout = VertexLayout<Vertex, &Vertex::position, &Vertex::color>;
+template <typename Vertex, auto... Members>
+class VertexLayout
+{
+    template <typename T>
+    static T member_type(T Vertex::*);
+
+    template <auto Member>
+    using MemberType = decltype(member_type(Member));
+
+public:
+
+    static constexpr uint32_t STRIDE{ sizeof(Vertex) };
+
+    // Offsets follow the layout rules of standard-layout structs
+    static constexpr std::array<VertexAttributeDescription, sizeof...(Members)> ATTRIBUTES{
+        []()
+        {
+            std::array<VertexAttributeDescription, sizeof...(Members)> attributes{};
+            uint32_t offset{};
+            size_t i{};
+            auto add{ [&]<typename T>(std::type_identity<T>)
+                      {
+                          offset          = (offset + alignof(T) - 1) / alignof(T) * alignof(T);
+                          attributes[i++] = { .format = VERTEX_FORMAT<T>, .offset = offset };
+                          offset += sizeof(T);
+                      } };
+            (add(std::type_identity<MemberType<Members>>{}), ...);
+            return attributes;
+        }()
+    };
+
+    // Members of a GraphicsPipelineInfo that reads vertices of this layout from one binding
+    static std::vector<uint32_t> get_binding_strides() { return { STRIDE }; }
+    static std::vector<VertexAttributeDescription> get_attribute_descriptions(uint32_t binding = 0)
+    {
+        std::vector<VertexAttributeDescription> attributes{ ATTRIBUTES.begin(), ATTRIBUTES.end() };
+        for (auto& attribute : attributes) {
+            attribute.binding = binding;
+        }
+        return attributes;
+    }
+
+private:
+
+    static constexpr size_t ALIGNMENT{ std::max({ size_t{ 1 }, alignof(MemberType<Members>)... }) };
+    static constexpr size_t END{ ATTRIBUTES.back().offset
+                                 + (size_t{}, ..., sizeof(MemberType<Members>)) };
+
+    static_assert(sizeof...(Members) > 0);
+    static_assert(std::is_standard_layout_v<Vertex>);
+    static_assert(((VERTEX_FORMAT<MemberType<Members>> != vk::Format::eUndefined) && ...),
+                  "Vertex member of a type with no vertex format");
+    // Catches most missing members, a struct can only be larger than its members by the padding
+    static_assert((END + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT == sizeof(Vertex),
+                  "Vertex members missing from the layout");
+};
+
+}  // namespace ec::vulkan
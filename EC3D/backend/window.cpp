@@ -7,8 +7,16 @@ namespace ec
 Window::Window(const Window::Info& info) :
   m_handle(create_window_glfw(info.width, info.height, info.name)),
   m_width(info.width),
-  m_height(info.height)
+  m_height(info.height),
+  m_callbackState(std::make_unique<CallbackState>())
 {
+    m_framebufferSize = get_framebuffer_size();
+
+    glfwSetWindowUserPointer(m_handle, m_callbackState.get());
+    glfwSetWindowIconifyCallback(m_handle, [](GLFWwindow* handle, int iconified) {
+        auto* state{ static_cast<CallbackState*>(glfwGetWindowUserPointer(handle)) };
+        state->iconified = iconified == GLFW_TRUE;
+    });
 }
 
 Window::~Window() { }
@@ -29,6 +37,26 @@ std::tuple<int, int> Window::get_framebuffer_size() const
     return std::make_tuple(width, height);
 }
 
+void Window::poll_events()
+{
+    glfwPollEvents();
+    auto framebufferSize{ get_framebuffer_size() };
+    if (framebufferSize != m_framebufferSize) {
+        m_framebufferSize = framebufferSize;
+        m_resized         = true;
+    }
+}
+
+bool Window::consume_resize()
+{
+    return std::exchange(m_resized, false);
+}
+
+bool Window::is_hidden() const
+{
+    return m_callbackState->iconified || !glfwGetWindowAttrib(m_handle, GLFW_VISIBLE);
+}
+
 std::vector<const char*> Window::get_required_extensions() const
 {
     uint32_t extensionCount{};
@@ -56,7 +84,7 @@ GLFWwindow* create_window_glfw(int width, int height, std::string_view windowNam
     }
 
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);  // Not needed if not using OpenGL or OpenGL ES
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);    // TODO: Allow resizable window
+    glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
     GLFWwindow* windowHandle = glfwCreateWindow(width, height, windowName.data(), nullptr, nullptr);
     if (!windowHandle) {
@@ -3,13 +3,14 @@
 #define GLFW_INCLUDE_NONE
 #include "GLFW/glfw3.h"
 
+#include <memory>
 #include <string_view>
 #include <vector>
 
 namespace ec
 {
 
-// For now, only one non-resizable window that controls the glfw context
+// For now, only one resizable window that controls the glfw context
 class Window
 {
 public:
@@ -38,7 +39,13 @@ public:
     std::tuple<int, int> get_framebuffer_size() const;
     std::vector<const char*> get_required_extensions() const;
     bool close_signalled() const { return glfwWindowShouldClose(m_handle); };
-    void poll_events() const { glfwPollEvents(); };
+    void poll_events();
+    // Blocks until there is at least one event, e.g. while the window is hidden
+    void wait_events() { glfwWaitEvents(); }
+    // True once after each change of the framebuffer size
+    bool consume_resize();
+    // Minimized or not shown, nothing rendered to it would be seen
+    bool is_hidden() const;
 
     void create_surface(vk::Instance instance);
     void delete_surface() { m_surface = nullptr; };
@@ -48,6 +55,16 @@ private:
     GLFWwindow* m_handle{ nullptr };
     int m_width{};
     int m_height{};
+    // Compared on each poll instead of using a GLFW callback, so the window stays movable
+    std::tuple<int, int> m_framebufferSize{};
+    bool m_resized{};
+
+    // Updated by GLFW callbacks. Behind a pointer, set as the GLFW user pointer, so that it stays
+    // valid when the window is moved
+    struct CallbackState {
+        bool iconified{};
+    };
+    std::unique_ptr<CallbackState> m_callbackState{};
 
     vk::SurfaceKHR m_surface;
 };
@@ -1,7 +1,43 @@
 #include "pch.hpp"
 #include "camera.hpp"
 
+#include <glm/gtc/matrix_transform.hpp>
+
 namespace ec
 {
 
+void Camera::look_at(const glm::vec3& eye, const glm::vec3& center, const glm::vec3& up)
+{
+    m_viewMatrix = glm::lookAtRH(eye, center, up);
+}
+
+void Camera::set_aspect_ratio(float aspectRatio)
+{
+    if (m_perspectiveProperties) {
+        m_perspectiveProperties->aspectRatio = aspectRatio;
+        update_projection();
+    }
 }
+
+void Camera::update_projection()
+{
+    if (m_cameraType == Camera::Type::perspective) {
+        const auto& props{ m_perspectiveProperties.value() };
+        m_projectionMatrix = glm::perspectiveRH_ZO(props.fovY,
+                                                   props.aspectRatio,
+                                                   props.zNear,
+                                                   props.zFar);
+    } else {
+        const auto& props{ m_orthographicProperties.value() };
+        m_projectionMatrix = glm::orthoRH_ZO(-props.halfWidth,
+                                             props.halfWidth,
+                                             -props.halfHeight,
+                                             props.halfHeight,
+                                             props.zNear,
+                                             props.zFar);
+    }
+    // glm follows OpenGL, where Y points up in clip space
+    m_projectionMatrix[1][1] *= -1.f;
+}
+
+}  // namespace ec
@@ -2,6 +2,9 @@
 
 #include <glm/mat4x4.hpp>
 
+#include <optional>
+#include <string>
+
 namespace ec
 {
 
@@ -31,12 +34,29 @@ public:
     Camera() = default;
     Camera(PerspectiveCameraProperties&& perspectiveProperties) :
       m_cameraType(Camera::Type::perspective),
-      m_perspectiveProperties(perspectiveProperties){};
+      m_perspectiveProperties(perspectiveProperties)
+    {
+        update_projection();
+    };
     Camera(OrthographicCameraProperties&& orthographicProperties) :
       m_cameraType(Camera::Type::orthographic),
-      m_orthographicProperties(orthographicProperties){};
+      m_orthographicProperties(orthographicProperties)
+    {
+        update_projection();
+    };
+
+    void look_at(const glm::vec3& eye, const glm::vec3& center, const glm::vec3& up);
+    // Only changes perspective cameras, e.g. after a resize
+    void set_aspect_ratio(float aspectRatio);
+
+    const glm::mat4& get_view_matrix() const { return m_viewMatrix; }
+    // Vulkan clip space: depth in [0, 1] and Y pointing down
+    const glm::mat4& get_projection_matrix() const { return m_projectionMatrix; }
+    glm::mat4 get_view_projection() const { return m_projectionMatrix * m_viewMatrix; }
+
+private:
 
-    // TODO: Create view/projection matrices from constructor
+    void update_projection();
 
 private:
 
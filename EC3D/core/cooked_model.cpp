@@ -0,0 +1,378 @@
+#include "pch.hpp"
+#include "cooked_model.hpp"
+
+#include <cstring>
+#include <fstream>
+
+namespace ec
+{
+
+// Blobs start at multiples of this, enough for any vertex or texel format and for cache lines
+constexpr uint64_t BLOB_ALIGNMENT{ 64 };
+constexpr std::array<char, 8> FILE_MAGIC{ 'E', 'C', '3', 'D', 'C', 'O', 'O', 'K' };
+
+struct BlobRange {
+    uint64_t offset;
+    uint64_t size;
+};
+
+// At the beginning of the file. Metadata holds everything but the blobs, see write_metadata
+struct FileHeader {
+    std::array<char, 8> magic;
+    uint32_t version;
+    uint32_t vertexSize;  // sizeof(PackedVertex) when cooked, the layout must match
+    BlobRange metadata;
+    BlobRange vertices;
+    BlobRange indices;
+    BlobRange images;  // All the images, each one aligned
+};
+
+// Appends values as raw bytes, only for trivially copyable types
+class BinaryWriter
+{
+public:
+
+    template<typename T>
+    void write(const T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const auto* bytes{ reinterpret_cast<const std::byte*>(&value) };
+        m_data.insert(m_data.end(), bytes, bytes + sizeof(T));
+    }
+
+    void write_string(const std::string& string)
+    {
+        write(static_cast<uint32_t>(string.size()));
+        const auto* bytes{ reinterpret_cast<const std::byte*>(string.data()) };
+        m_data.insert(m_data.end(), bytes, bytes + string.size());
+    }
+
+    template<typename T>
+    void write_optional(const std::optional<T>& value)
+    {
+        write(static_cast<uint8_t>(value.has_value()));
+        if (value) {
+            write(value.value());
+        }
+    }
+
+    const std::vector<std::byte>& get_data() const { return m_data; }
+
+private:
+
+    std::vector<std::byte> m_data{};
+};
+
+// Reads what BinaryWriter wrote, throwing instead of reading past the end
+class BinaryReader
+{
+public:
+
+    explicit BinaryReader(std::span<const std::byte> data) : m_data(data){};
+
+    template<typename T>
+    T read()
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T value{};
+        std::memcpy(&value, take(sizeof(T)).data(), sizeof(T));
+        return value;
+    }
+
+    std::string read_string()
+    {
+        auto size{ read<uint32_t>() };
+        auto bytes{ take(size) };
+        return std::string(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    }
+
+    template<typename T>
+    std::optional<T> read_optional()
+    {
+        if (read<uint8_t>() == 0) {
+            return std::nullopt;
+        }
+        return read<T>();
+    }
+
+private:
+
+    std::span<const std::byte> take(size_t size)
+    {
+        if (size > m_data.size() - m_offset) {
+            throw std::runtime_error("Cooked model metadata is truncated");
+        }
+        auto bytes{ m_data.subspan(m_offset, size) };
+        m_offset += size;
+        return bytes;
+    }
+
+private:
+
+    std::span<const std::byte> m_data{};
+    size_t m_offset{};
+};
+
+static void write_texture(BinaryWriter& writer, const std::optional<MaterialTexture>& texture)
+{
+    writer.write(static_cast<uint8_t>(texture.has_value()));
+    if (texture) {
+        writer.write(texture->get_texture_index());
+        writer.write(texture->get_tex_coords());
+    }
+}
+
+static std::optional<MaterialTexture> read_texture(BinaryReader& reader)
+{
+    if (reader.read<uint8_t>() == 0) {
+        return std::nullopt;
+    }
+    auto textureIndex{ reader.read<uint32_t>() };
+    auto texCoords{ reader.read<uint32_t>() };
+    return MaterialTexture{ textureIndex, texCoords };
+}
+
+static void write_entity(BinaryWriter& writer, const Entity& entity)
+{
+    writer.write_string(entity.get_name());
+    writer.write(entity.get_transform());
+    writer.write_optional(entity.get_mesh_index());
+    writer.write(static_cast<uint32_t>(entity.get_children().size()));
+    for (const auto& child : entity.get_children()) {
+        write_entity(writer, child);
+    }
+}
+
+static Entity read_entity(BinaryReader& reader)
+{
+    Entity::Info entityInfo{};
+    entityInfo.name      = reader.read_string();
+    entityInfo.transform = reader.read<glm::mat4>();
+    entityInfo.meshIndex = reader.read_optional<uint32_t>();
+    Entity entity{ entityInfo };
+    auto numChildren{ reader.read<uint32_t>() };
+    for (uint32_t i = 0; i < numChildren; ++i) {
+        entity.add_child(read_entity(reader));
+    }
+    return entity;
+}
+
+// imageRanges are the offsets of the pixels of each image in the file
+static void write_metadata(BinaryWriter& writer,
+                           const Model& model,
+                           const std::vector<BlobRange>& imageRanges)
+{
+    writer.write(static_cast<uint32_t>(model.meshes.size()));
+    for (const auto& mesh : model.meshes) {
+        writer.write_string(mesh.get_name());
+        writer.write(static_cast<uint32_t>(mesh.get_primitives().size()));
+        for (const auto& primitive : mesh.get_primitives()) {
+            writer.write(primitive.firstIndex);
+            writer.write(primitive.indexCount);
+            writer.write(primitive.vertexOffset);
+            writer.write(primitive.vertexCount);
+            writer.write_optional(primitive.materialIndex);
+            writer.write(primitive.bounds.min);
+            writer.write(primitive.bounds.max);
+        }
+    }
+
+    writer.write(static_cast<uint32_t>(model.materials.size()));
+    for (const auto& material : model.materials) {
+        auto info{ material.get_info() };
+        writer.write_string(info.name);
+        writer.write(info.baseColor);
+        writer.write(info.metalness);
+        writer.write(info.roughness);
+        write_texture(writer, info.baseColorTexture);
+        write_texture(writer, info.metalnessRoughnessTexture);
+        writer.write(info.alphaMode);
+        writer.write(info.alphaCutoff);
+        writer.write(static_cast<uint8_t>(info.doubleSided));
+        writer.write(info.emissive);
+        writer.write(info.normalScale);
+        writer.write(info.occlusionStrength);
+        write_texture(writer, info.emissiveTexture);
+        write_texture(writer, info.normalTexture);
+        write_texture(writer, info.occlusionTexture);
+    }
+
+    writer.write(static_cast<uint32_t>(model.images.size()));
+    for (size_t i = 0; i < model.images.size(); ++i) {
+        writer.write_string(model.images[i].name);
+        writer.write(model.images[i].width);
+        writer.write(model.images[i].height);
+        writer.write_string(model.images[i].ktx2Path);
+        writer.write(imageRanges[i]);
+    }
+    writer.write(static_cast<uint32_t>(model.textureImages.size()));
+    for (const auto& textureImage : model.textureImages) {
+        writer.write_optional(textureImage);
+    }
+
+    writer.write(static_cast<uint32_t>(model.scenes.size()));
+    writer.write(model.defaultScene);
+    for (const auto& scene : model.scenes) {
+        writer.write_string(scene.get_name());
+        writer.write(static_cast<uint32_t>(scene.get_entities().size()));
+        for (const auto& entity : scene.get_entities()) {
+            write_entity(writer, entity);
+        }
+    }
+}
+
+static uint64_t align_blob(uint64_t offset)
+{
+    return (offset + BLOB_ALIGNMENT - 1) & ~(BLOB_ALIGNMENT - 1);
+}
+
+void cook_model(const Model& model, const std::filesystem::path& path)
+{
+    // Packed like the renderer uploads them, with the bounds of each primitive in the metadata
+    auto packedVertices{ pack_vertices(model.vertices, model.meshes) };
+
+    // Blobs follow the header in order, then the metadata, which needs the image offsets
+    FileHeader header{
+        .magic      = FILE_MAGIC,
+        .version    = CookedModel::VERSION,
+        .vertexSize = sizeof(PackedVertex),
+    };
+    header.vertices = { align_blob(sizeof(FileHeader)),
+                        packedVertices.size() * sizeof(PackedVertex) };
+    header.indices  = { align_blob(header.vertices.offset + header.vertices.size),
+                        model.indices.size() * sizeof(uint32_t) };
+
+    std::vector<BlobRange> imageRanges(model.images.size());
+    uint64_t offset{ align_blob(header.indices.offset + header.indices.size) };
+    header.images.offset = offset;
+    for (size_t i = 0; i < model.images.size(); ++i) {
+        imageRanges[i] = { offset, model.images[i].pixels.size() };
+        offset         = align_blob(offset + imageRanges[i].size);
+    }
+    header.images.size = offset - header.images.offset;
+
+    BinaryWriter metadata{};
+    write_metadata(metadata, model, imageRanges);
+    header.metadata = { offset, metadata.get_data().size() };
+
+    std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+    if (!file) {
+        throw std::runtime_error(std::format("Failed to open {} to cook a model", path.string()));
+    }
+    auto writeAt{ [&](uint64_t position, const void* data, uint64_t size) {
+        // Padding up to the position is zeroed
+        static constexpr std::array<char, BLOB_ALIGNMENT> zeros{};
+        auto current{ static_cast<uint64_t>(file.tellp()) };
+        EC_ASSERT(current <= position && position - current <= BLOB_ALIGNMENT);
+        file.write(zeros.data(), static_cast<std::streamsize>(position - current));
+        file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    } };
+    writeAt(0, &header, sizeof(header));
+    writeAt(header.vertices.offset, packedVertices.data(), header.vertices.size);
+    writeAt(header.indices.offset, model.indices.data(), header.indices.size);
+    for (size_t i = 0; i < model.images.size(); ++i) {
+        writeAt(imageRanges[i].offset, model.images[i].pixels.data(), imageRanges[i].size);
+    }
+    writeAt(header.metadata.offset, metadata.get_data().data(), header.metadata.size);
+    if (!file) {
+        throw std::runtime_error(std::format("Failed to write the cooked model {}", path.string()));
+    }
+
+    EC_LOG_INFO("Cooked {}: {} bytes",
+                path.string(),
+                header.metadata.offset + header.metadata.size);
+}
+
+CookedModel::CookedModel(const std::filesystem::path& path) :
+  m_file{ path }
+{
+    auto fileBytes{ m_file.get_bytes() };
+    if (fileBytes.size() < sizeof(FileHeader)) {
+        throw std::runtime_error(std::format("{} is not a cooked model", path.string()));
+    }
+    FileHeader header{};
+    std::memcpy(&header, fileBytes.data(), sizeof(header));
+    if (header.magic != FILE_MAGIC) {
+        throw std::runtime_error(std::format("{} is not a cooked model", path.string()));
+    }
+    if (header.version != VERSION || header.vertexSize != sizeof(PackedVertex)) {
+        throw std::runtime_error(
+            std::format("{} was cooked by another version, it has to be cooked again",
+                        path.string()));
+    }
+
+    m_vertexData = m_file.get_bytes(header.vertices.offset, header.vertices.size);
+    m_indexData  = m_file.get_bytes(header.indices.offset, header.indices.size);
+
+    BinaryReader reader{ m_file.get_bytes(header.metadata.offset, header.metadata.size) };
+    auto numMeshes{ reader.read<uint32_t>() };
+    m_model.meshes.reserve(numMeshes);
+    for (uint32_t i = 0; i < numMeshes; ++i) {
+        Mesh::Info meshInfo{ .name = reader.read_string() };
+        auto numPrimitives{ reader.read<uint32_t>() };
+        meshInfo.primitives.resize(numPrimitives);
+        for (auto& primitive : meshInfo.primitives) {
+            primitive.firstIndex    = reader.read<uint32_t>();
+            primitive.indexCount    = reader.read<uint32_t>();
+            primitive.vertexOffset  = reader.read<int32_t>();
+            primitive.vertexCount   = reader.read<uint32_t>();
+            primitive.materialIndex = reader.read_optional<uint32_t>();
+            primitive.bounds.min    = reader.read<glm::vec3>();
+            primitive.bounds.max    = reader.read<glm::vec3>();
+        }
+        m_model.meshes.emplace_back(meshInfo);
+    }
+
+    auto numMaterials{ reader.read<uint32_t>() };
+    m_model.materials.reserve(numMaterials);
+    for (uint32_t i = 0; i < numMaterials; ++i) {
+        Material::Info info{};
+        info.name                      = reader.read_string();
+        info.baseColor                 = reader.read<glm::vec4>();
+        info.metalness                 = reader.read<float>();
+        info.roughness                 = reader.read<float>();
+        info.baseColorTexture          = read_texture(reader);
+        info.metalnessRoughnessTexture = read_texture(reader);
+        info.alphaMode                 = reader.read<Material::AlphaMode>();
+        info.alphaCutoff               = reader.read<float>();
+        info.doubleSided               = reader.read<uint8_t>() != 0;
+        info.emissive                  = reader.read<glm::vec3>();
+        info.normalScale               = reader.read<float>();
+        info.occlusionStrength         = reader.read<float>();
+        info.emissiveTexture           = read_texture(reader);
+        info.normalTexture             = read_texture(reader);
+        info.occlusionTexture          = read_texture(reader);
+        m_model.materials.emplace_back(info);
+    }
+
+    auto numImages{ reader.read<uint32_t>() };
+    m_model.images.resize(numImages);
+    m_imageData.resize(numImages);
+    for (uint32_t i = 0; i < numImages; ++i) {
+        auto& image{ m_model.images[i] };
+        image.name     = reader.read_string();
+        image.width    = reader.read<uint32_t>();
+        image.height   = reader.read<uint32_t>();
+        image.ktx2Path = reader.read_string();
+        auto range{ reader.read<BlobRange>() };
+        m_imageData[i] = m_file.get_bytes(range.offset, range.size);
+    }
+    auto numTextures{ reader.read<uint32_t>() };
+    m_model.textureImages.resize(numTextures);
+    for (auto& textureImage : m_model.textureImages) {
+        textureImage = reader.read_optional<uint32_t>();
+    }
+
+    auto numScenes{ reader.read<uint32_t>() };
+    m_model.defaultScene = reader.read<uint32_t>();
+    for (uint32_t i = 0; i < numScenes; ++i) {
+        Scene scene{ reader.read_string() };
+        auto numEntities{ reader.read<uint32_t>() };
+        for (uint32_t j = 0; j < numEntities; ++j) {
+            scene.add_entity(read_entity(reader));
+        }
+        m_model.scenes.push_back(std::move(scene));
+    }
+}
+
+}  // namespace ec
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "model.hpp"
+#include "packed_vertex.hpp"
+#include "misc/mapped_file.hpp"
+
+#include <filesystem>
+#include <span>
+#include <string_view>
+
+namespace ec
+{
+
+// Model cooked offline into a binary container (see cook_model). The scene, mesh and material
+// descriptions are small and deserialized on load. Vertices, indices and image pixels are stored
+// 64-byte aligned exactly as they are uploaded, and are read straight from the file mapping
+class CookedModel
+{
+public:
+
+    constexpr static std::string_view FILE_EXTENSION{ ".ec3dmodel" };
+    // 2: vertices stored as PackedVertex, 3: paths of the KTX2 images
+    constexpr static uint32_t VERSION{ 3 };
+
+    // Throws if the file is not a cooked model of this version
+    explicit CookedModel(const std::filesystem::path& path);
+
+    // Vertices, indices and image pixels are empty, they are only in the mapping
+    const Model& get_model() const { return m_model; }
+    Model& get_model() { return m_model; }
+
+    // Valid while the CookedModel is alive. PackedVertex and uint32_t indices, RGBA8 pixels
+    std::span<const std::byte> get_vertex_data() const { return m_vertexData; }
+    std::span<const std::byte> get_index_data() const { return m_indexData; }
+    std::span<const std::byte> get_image_data(uint32_t imageIndex) const
+    {
+        return m_imageData.at(imageIndex);
+    }
+
+private:
+
+    MappedFile m_file{};
+    Model m_model{};
+
+    std::span<const std::byte> m_vertexData{};
+    std::span<const std::byte> m_indexData{};
+    std::vector<std::span<const std::byte>> m_imageData{};
+};
+
+// Writes everything the renderer needs from the model, e.g. a glTF file after load_gltf_file, so
+// the next launches skip parsing and image decoding. Throws if the file can't be written
+void cook_model(const Model& model, const std::filesystem::path& path);
+
+}  // namespace ec
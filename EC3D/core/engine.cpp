@@ -1,12 +1,113 @@
 #include "pch.hpp"
 #include "engine.hpp"
 #include "misc/timer.hpp"
+#include "misc/frame_limiter.hpp"
 
 #include <vulkan/vulkan_structs.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <filesystem>
+#include <span>
 
 namespace ec
 {
 
+constexpr vk::Format MODEL_DEPTH_FORMAT{ vk::Format::eD32Sfloat };
+
+// Vertex of the test triangle, read by basic.vert
+struct TestVertex {
+    glm::vec3 position;
+    vulkan::Unorm8x4 color;
+};
+using TestVertexLayout
+    = vulkan::VertexLayout<TestVertex, &TestVertex::position, &TestVertex::color>;
+
+// Layout of the push constants in mesh.vert, 128 bytes (the minimum maxPushConstantsSize)
+struct ModelPushConstants {
+    glm::mat4 mvp;  // Includes the dequantization of the packed positions
+    glm::vec4 normalMatrix[3];  // Columns of the mat3, alpha cutoff in normalMatrix[0].w
+    glm::vec4 baseColor;
+};
+static_assert(sizeof(ModelPushConstants) == 128);
+
+// Cleared to the far plane every frame, only needed while rendering
+static vulkan::AttachmentInfo model_depth_attachment()
+{
+    return {
+        .format        = MODEL_DEPTH_FORMAT,
+        .aspect        = vk::ImageAspectFlagBits::eDepth,
+        .numSamples    = vk::SampleCountFlagBits::e1,
+        .loadOp        = vk::AttachmentLoadOp::eClear,
+        .storeOp       = vk::AttachmentStoreOp::eDontCare,
+        .initialLayout = vk::ImageLayout::eUndefined,
+        .finalLayout   = vk::ImageLayout::eDepthStencilAttachmentOptimal,
+        .clearValue    = VkClearValue{ .depthStencil = { 1.f, 0 } },
+    };
+}
+
+// Double-sided materials show their back faces
+static vk::CullModeFlags material_cull_mode(const Material& material)
+{
+    return material.is_double_sided() ? vk::CullModeFlagBits::eNone : vk::CullModeFlagBits::eBack;
+}
+
+// Image sampled through the texture, if it has one
+static std::optional<uint32_t> get_texture_image(const Model& model,
+                                                 const std::optional<MaterialTexture>& texture)
+{
+    if (!texture || texture->get_texture_index() >= model.textureImages.size()) {
+        return std::nullopt;
+    }
+    return model.textureImages[texture->get_texture_index()];
+}
+
+// Images any material reads colors from, stored in sRGB
+static std::vector<bool> find_color_images(const Model& model)
+{
+    std::vector<bool> colorImages(model.images.size());
+    for (const auto& material : model.materials) {
+        auto materialInfo{ material.get_info() };
+        for (const auto& colorTexture :
+             { materialInfo.baseColorTexture, materialInfo.emissiveTexture }) {
+            if (auto image{ get_texture_image(model, colorTexture) }) {
+                colorImages.at(image.value()) = true;
+            }
+        }
+    }
+    return colorImages;
+}
+
+// Full mip chain from pixels, without levels if the image failed to decode
+static vulkan::ImageData get_image_data(const ModelImage& image,
+                                        std::span<const std::byte> pixels,
+                                        bool isColor)
+{
+    vulkan::ImageData imageData{
+        .format    = isColor ? vk::Format::eR8G8B8A8Srgb : vk::Format::eR8G8B8A8Unorm,
+        .extent    = { .width = image.width, .height = image.height, .depth = 1 },
+        .mipLevels = vulkan::Image::get_max_mip_levels(image.width, image.height),
+    };
+    if (!pixels.empty()) {
+        imageData.levels.push_back(pixels);
+    }
+    return imageData;
+}
+
+// Empty if the image is not in a KTX2 file or the file can't be uploaded as is
+static std::optional<Ktx2Texture> load_ktx2_image(const ModelImage& image)
+{
+    if (image.ktx2Path.empty()) {
+        return std::nullopt;
+    }
+    try {
+        return Ktx2Texture{ image.ktx2Path };
+    }
+    catch (const std::exception& e) {
+        EC_LOG_WARN("Failed to load KTX2 image {}: {}", image.name, e.what());
+        return std::nullopt;
+    }
+}
+
 Engine::Engine(const Engine::Info& info)
 {
     try {
@@ -24,29 +125,148 @@ Engine::~Engine() { }
 
 void Engine::run()
 {
+    bool hasModel{ !m_modelPath.empty() };
+    std::vector<vulkan::Image> textures{};
+    bool texturesUploaded{};
+    if (hasModel) {
+        Timer loadTimer{};
+        if (std::filesystem::path{ m_modelPath }.extension() == CookedModel::FILE_EXTENSION) {
+            m_cookedModel.emplace(m_modelPath);
+            m_model = std::move(m_cookedModel->get_model());
+        } else {
+            GltfLoadInfo loadInfo{
+                .numThreads     = m_loaderThreads,
+                .optimizeMeshes = m_optimizeMeshes,
+            };
+            // Unless streamed, each image is uploaded as soon as it is decoded, while the rest
+            // of the model is still loading. The pixels are staged before the transfer returns
+            std::vector<bool> colorImages{};
+            if (!m_textureStreamer) {
+                loadInfo.onImageLoaded = [&](const Model& model, uint32_t imageIndex)
+                {
+                    if (!texturesUploaded) {
+                        colorImages = find_color_images(model);
+                        textures.resize(model.images.size());
+                        texturesUploaded = true;
+                    }
+                    const auto& image{ model.images[imageIndex] };
+                    std::span<const std::byte> pixels{ std::as_bytes(std::span{ image.pixels }) };
+                    auto ktx2{ load_ktx2_image(image) };
+                    auto data{ ktx2 ? ktx2->get_image_data()
+                                    : get_image_data(image, pixels, colorImages[imageIndex]) };
+                    if (data.levels.empty()) {
+                        return;
+                    }
+                    textures[imageIndex] = m_renderer.create_texture(data);
+                    m_renderer.transfer_data_async(
+                        { { .dstImage = &textures[imageIndex], .data = &data } });
+                };
+            }
+            m_model = load_gltf_file(m_modelPath, loadInfo);
+        }
+        EC_LOG_INFO("Model loaded in {} ms", loadTimer.get_elapsed_time() * 1000.f);
+    }
+
+    // Startup and first frame latency, to compare shader objects against pipelines
+    Timer startupTimer{};
     auto& context{ m_renderer.create_graphics_context() };
-    create_test_renderpass(context);
-    add_test_pipeline(context);
-    // load_gltf_file("./models/Box.gltf");
-    auto [vBuf, iBuf] = load_test_buffers();
+    context.set_frames_in_flight(m_framesInFlight);
+    if (m_targetFrameRate > 0.f) {
+        context.enable_adaptive_latency(m_targetFrameRate);
+    }
+    if (!m_renderer.is_headless()) {
+        std::string supportedModes{};
+        for (auto mode : context.get_supported_present_modes()) {
+            supportedModes += std::format(" {}", vk::to_string(mode));
+        }
+        EC_LOG_INFO("Supported present modes:{}", supportedModes);
+    }
+    if (m_presentMode) {
+        context.set_present_mode(m_presentMode.value());
+    }
+    // Shader objects are only enabled by devices with dynamic rendering, else pipelines are used
+    if (m_dynamicRendering || context.uses_shader_objects()) {
+        create_test_dynamic_rendering(context);
+    } else {
+        create_test_renderpass(context);
+    }
+    uint32_t pipelineIndex{};
+    if (hasModel) {
+        pipelineIndex = add_model_pipeline(context);
+        // Residency feedback is meaningless for textures no shader reads
+        if (m_textureStreamer && !context.samples_images(pipelineIndex)) {
+            EC_LOG_WARN("The model shaders don't sample textures, they are not streamed");
+            m_textureStreamer.reset();
+        }
+    } else {
+        add_test_pipeline(context);
+    }
+    float pipelineCreationTime{ startupTimer.get_elapsed_time() };
+    auto [vBuf, iBuf] = hasModel ? load_model_buffers() : load_test_buffers();
     std::vector<vulkan::Buffer> vertexBuffers{ vBuf };
+    if (hasModel) {
+        if (m_textureStreamer) {
+            // Streamed from the model images, cooked ones stay mapped
+            for (const auto& data : get_model_image_data()) {
+                m_textureStreamer->add_texture(data);
+            }
+        } else {
+            // Unless they were already uploaded while loading
+            if (!texturesUploaded) {
+                textures = load_model_textures(get_model_image_data());
+            }
+            // Everything they map is on the GPU now
+            m_cookedModel.reset();
+            m_ktx2Images.clear();
+        }
+        frame_model();
+    }
+    if (!m_texturePath.empty()) {
+        textures.push_back(load_texture(m_texturePath));
+    }
+
+    std::optional<FrameExporter> exporter{};
+    if (!m_exportInfo.path.empty()) {
+        exporter.emplace(m_exportInfo);
+        context.start_readback(
+            [&](const vulkan::ReadbackFrame& frame) { exporter->submit(frame); });
+    }
 
     Timer timer{};
     timer.reset();
     int frameCount{ 0 };
     float addedFrameTime{ 0.f };
+    // Waiting for the first frame stalls the GPU, so it is only timed in runs of a fixed number
+    // of frames, which are meant for measurements
+    bool timeFirstFrame{ m_maxFrames > 0 };
+    uint32_t renderedFrames{ 0 };
+    float totalCpuTime{ 0.f };  // Of the rendered frames, compared between the binding paths
+    FrameLimiter frameLimiter{ m_frameRateLimit };
 
-    while (!m_renderer.close_signalled()) {
+    while (!m_renderer.close_signalled() && (m_maxFrames == 0 || renderedFrames < m_maxFrames)) {
+        // Before polling, so the input is as recent as possible when the frame is recorded
+        frameLimiter.wait();
         m_renderer.poll_events();
+        // Nothing would be seen, sleep until the window is shown again
+        if (m_renderer.is_window_hidden()) {
+            m_renderer.wait_events();
+            continue;
+        }
 
         // FPS counting
         float dt{ timer.get_delta_time() };
         addedFrameTime += dt;
         ++frameCount;
         if (addedFrameTime >= 1.f) {
-            std::cout << std::format("FPS: {}, Frame time: {} ms\n\n",
-                                     frameCount,
-                                     addedFrameTime / frameCount);
+            const auto& timings{ context.get_frame_timings() };
+            std::ostream& status{ m_exportInfo.writes_to_stdout() ? std::cerr : std::cout };
+            status << std::format("FPS: {}, Frame time: {} ms (CPU {} ms, GPU {} ms), {} frames in "
+                                  "flight\n\n",
+                                  frameCount,
+                                  addedFrameTime / frameCount,
+                                  timings.cpuTime * 1000.f,
+                                  timings.gpuTime * 1000.f,
+                                  context.get_frames_in_flight());
             addedFrameTime = 0.f;
             frameCount     = 0;
         }
@@ -55,13 +275,64 @@ void Engine::run()
         VkClearValue testClearValue{};
         testClearValue.color = { glm::sin(addedFrameTime) };
         context.set_clear_value(0, testClearValue);
-        context.begin_rendering();
-        context.bind_pipeline(0);
+        if (m_textureStreamer) {
+            m_textureStreamer->update(context);  // With the feedback of the previous frame
+        }
+        if (!context.begin_rendering()) {
+            m_renderer.wait_events();  // No area to render to, e.g. minimized
+            continue;
+        }
+        context.bind_pipeline(pipelineIndex);
         context.bind_vertex_buffers(vertexBuffers);
-        context.bind_index_buffer(iBuf);
-        context.draw_indexed(iBuf.get_count());
+        if (hasModel) {
+            draw_model(context, pipelineIndex, iBuf);
+        } else {
+            context.bind_index_buffer(iBuf);
+            context.draw_indexed(iBuf.get_count());
+        }
         context.end_rendering();
+        ++renderedFrames;
+        totalCpuTime += context.get_frame_timings().cpuTime;
+
+        if (timeFirstFrame) {
+            context.wait_idle();
+            EC_LOG_INFO("Startup with {}: pipeline creation {} ms, first frame done at {} ms",
+                        context.uses_shader_objects() ? "shader objects" : "pipelines",
+                        pipelineCreationTime * 1000.f,
+                        startupTimer.get_elapsed_time() * 1000.f);
+            timeFirstFrame = false;
+        }
     }
+
+    if (renderedFrames > 0) {
+        EC_LOG_INFO("Average CPU frame time with {}: {} ms over {} frames",
+                    context.uses_shader_objects() ? "shader objects" : "pipelines",
+                    totalCpuTime * 1000.f / renderedFrames,
+                    renderedFrames);
+    }
+
+    if (exporter) {
+        context.stop_readback();
+        exporter->stop();
+        EC_LOG_INFO("Exported {} frames to {} ({} dropped)",
+                    exporter->get_num_written(),
+                    m_exportInfo.path,
+                    exporter->get_num_dropped());
+    }
+
+    context.wait_idle();
+    m_renderer.free_buffer(vBuf);
+    m_renderer.free_buffer(iBuf);
+    for (auto& texture : textures) {
+        m_renderer.free_image(texture);
+    }
+    if (m_textureStreamer) {
+        EC_LOG_INFO("Streamed textures use {} MiB", m_textureStreamer->get_resident_size() >> 20);
+        m_textureStreamer->free();
+        m_textureStreamer.reset();
+    }
+    m_cookedModel.reset();
+    m_ktx2Images.clear();
 }
 
 void Engine::free()
@@ -74,13 +345,37 @@ void Engine::init(const Engine::Info& info)
     vulkan::Renderer::Info rendererInfo{
         .validationLayers   = info.validationLayers,
         .verticalSync       = info.verticalSync,
+        .swapchainImages    = info.swapchainImages,
+        .shaderObjects      = info.shaderObjects,
+        .headless           = info.headless,
+        .recordAhead        = info.recordAhead,
         .instanceExtensions = {},
         .deviceExtensions   = {},
         .windowCreateInfo   = info.windowInfo,
     };
-    rendererInfo.deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    if (!info.headless) {
+        rendererInfo.deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
 
     m_renderer = vulkan::Renderer{ rendererInfo };
+
+    m_dynamicRendering = info.dynamicRendering;
+    m_maxFrames        = info.maxFrames;
+    m_framesInFlight   = info.framesInFlight;
+    m_targetFrameRate  = info.targetFrameRate;
+    m_frameRateLimit   = info.frameRateLimit;
+    m_presentMode      = info.presentMode;
+    m_exportInfo       = info.exportInfo;
+    m_modelPath        = info.modelPath;
+    m_loaderThreads    = info.loaderThreads;
+    m_optimizeMeshes   = info.optimizeMeshes;
+    m_texturePath      = info.texturePath;
+    if (info.streamTextures) {
+        m_textureStreamer.emplace(m_renderer,
+                                  TextureStreamer::Info{
+                                      .memoryBudget = vk::DeviceSize{ info.textureBudget } << 20,
+                                  });
+    }
 }
 
 void Engine::create_test_renderpass(vulkan::GraphicsContext& context)
@@ -123,9 +418,46 @@ void Engine::create_test_renderpass(vulkan::GraphicsContext& context)
         .dependencies = dependencies,
     };
 
+    if (!m_modelPath.empty()) {
+        // idx 1, also waits for the depth writes of the previous frame before clearing
+        renderPassInfo.attachments.push_back(model_depth_attachment());
+        renderPassInfo.subpasses[0].depthStencilAttachment
+            = { 1, vk::ImageLayout::eDepthStencilAttachmentOptimal };
+        auto& [srcStages, dstStages]{ renderPassInfo.dependencies[0].stages };
+        srcStages |= vk::PipelineStageFlagBits::eEarlyFragmentTests
+                     | vk::PipelineStageFlagBits::eLateFragmentTests;
+        dstStages |= vk::PipelineStageFlagBits::eEarlyFragmentTests;
+        auto& [srcAccess, dstAccess]{ renderPassInfo.dependencies[0].access };
+        srcAccess |= vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+        dstAccess |= vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+    }
+
     context.create_render_pass(renderPassInfo);
 }
 
+void Engine::create_test_dynamic_rendering(vulkan::GraphicsContext& context)
+{
+    vulkan::AttachmentInfo swapchainColorAttachment{
+        .format        = m_renderer.get_presentable_image_format(),
+        .aspect        = vk::ImageAspectFlagBits::eColor,
+        .numSamples    = vk::SampleCountFlagBits::e1,
+        .loadOp        = vk::AttachmentLoadOp::eClear,
+        .storeOp       = vk::AttachmentStoreOp::eStore,
+        .initialLayout = vk::ImageLayout::eUndefined,
+        .finalLayout   = vk::ImageLayout::ePresentSrcKHR,
+        .clearValue    = VkClearValue{ .color = { 0.4f, 0.3f, 0.2f, 1.f }, },
+    };
+
+    vulkan::RenderingInfo renderingInfo{
+        .colorAttachments = { swapchainColorAttachment },
+    };
+    if (!m_modelPath.empty()) {
+        renderingInfo.depthAttachment = model_depth_attachment();
+    }
+
+    context.create_dynamic_rendering(renderingInfo);
+}
+
 void Engine::add_test_pipeline(vulkan::GraphicsContext& context)
 {
     std::vector<vulkan::ShaderInfo> shaders{};
@@ -139,19 +471,10 @@ void Engine::add_test_pipeline(vulkan::GraphicsContext& context)
         .stage    = vk::ShaderStageFlagBits::eFragment,
     };
 
-    struct Vertex {
-        glm::vec3 position;
-        glm::vec3 color;
-    };
-
-    std::vector<vulkan::VertexAttributeDescription> attributeDescriptions(2);
-    attributeDescriptions[0] = { vk::Format::eR32G32B32Sfloat, 0, offsetof(Vertex, position) };
-    attributeDescriptions[1] = { vk::Format::eR32G32B32Sfloat, 0, offsetof(Vertex, color) };
-
     vulkan::GraphicsPipelineInfo pipelineInfo{
         .shaders                  = shaders,
-        .bindingStrides           = { sizeof(Vertex) },
-        .attributeDescriptions    = attributeDescriptions,
+        .bindingStrides           = TestVertexLayout::get_binding_strides(),
+        .attributeDescriptions    = TestVertexLayout::get_attribute_descriptions(),
         .blendEnableInAttachments = { VK_FALSE },
         .subpassIdx               = 0,
     };
@@ -160,27 +483,24 @@ void Engine::add_test_pipeline(vulkan::GraphicsContext& context)
 
 std::pair<vulkan::Buffer, vulkan::Buffer> Engine::load_test_buffers()
 {
-    struct Vertex {
-        glm::vec3 position;
-        glm::vec3 color;
-    };
-
-    std::vector<Vertex> vb(3);
+    std::vector<TestVertex> vb(3);
     vb[0] = {
         .position = {-0.5f, 0.5f, 1.f},
-        .color    = {  1.f,  0.f, 0.f},
+        .color    = { 255,    0,   0, 255},
     };
     vb[1] = {
         .position = {0.5f, 0.5f, 1.f},
-        .color    = { 0.f,  1.f, 0.f},
+        .color    = {   0, 255,   0, 255},
     };
     vb[2] = {
         .position = {0.f, -0.5f, 1.f},
-        .color    = {0.f,   0.f, 1.f},
+        .color    = {   0,   0, 255, 255},
     };
 
-    std::vector<uint16_t> ib(3);
-    ib = { 0, 1, 2 };
+    std::vector<uint32_t> indices{ 0, 1, 2 };
+    vk::IndexType indexType{ select_index_type(static_cast<uint32_t>(vb.size() - 1),
+                                               m_renderer.supports_uint8_indices()) };
+    auto ib{ pack_indices(indices, indexType) };
 
     auto vertexBuffer{ m_renderer.create_buffer({
         .count    = static_cast<uint32_t>(vb.size()),
@@ -190,11 +510,11 @@ std::pair<vulkan::Buffer, vulkan::Buffer> Engine::load_test_buffers()
     }) };
 
     auto indexBuffer{ m_renderer.create_buffer({
-        .count    = static_cast<uint32_t>(ib.size()),
-        .elemSize = static_cast<vk::DeviceSize>(sizeof(ib[0])),
+        .count    = static_cast<uint32_t>(indices.size()),
+        .elemSize = static_cast<vk::DeviceSize>(get_index_size(indexType)),
         .usage    = vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst,
         .memoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal,
-        .indexType        = vk::IndexType::eUint16,
+        .indexType        = indexType,
     }) };
 
     m_renderer.transfer_data(vertexBuffer, vertexBuffer.get_size(), vb.data());
@@ -203,4 +523,283 @@ std::pair<vulkan::Buffer, vulkan::Buffer> Engine::load_test_buffers()
     return std::make_pair(vertexBuffer, indexBuffer);
 }
 
+uint32_t Engine::add_model_pipeline(vulkan::GraphicsContext& context)
+{
+    std::vector<vulkan::ShaderInfo> shaders{};
+    shaders.resize(2);
+    shaders[0] = {
+        .filePath = "C:/EC3D/viewer/shaders/mesh-vert.spv",
+        .stage    = vk::ShaderStageFlagBits::eVertex,
+    };
+    shaders[1] = {
+        .filePath = "C:/EC3D/viewer/shaders/mesh-frag.spv",
+        .stage    = vk::ShaderStageFlagBits::eFragment,
+    };
+
+    // glTF front faces are counter-clockwise, kept so by the Y flip of the camera projection
+    vulkan::GraphicsPipelineInfo pipelineInfo{
+        .shaders                  = shaders,
+        .bindingStrides           = PackedVertexLayout::get_binding_strides(),
+        .attributeDescriptions    = PackedVertexLayout::get_attribute_descriptions(),
+        .cullMode                 = vk::CullModeFlagBits::eBack,
+        .frontFace                = vk::FrontFace::eCounterClockwise,
+        .depthTestEnable          = VK_TRUE,
+        .depthWriteEnable         = VK_TRUE,
+        .depthCompareOp           = vk::CompareOp::eLess,
+        .blendEnableInAttachments = { VK_FALSE },
+        .subpassIdx               = 0,
+    };
+    uint32_t pipelineIndex{ context.create_pipeline(pipelineInfo) };
+
+    // Created up front so no pipeline is compiled mid-frame. Materials with the same features
+    // share their variant
+    auto materialVariant{ [](const Material& material) {
+        return vulkan::PipelineVariantInfo{
+            .featureMask = material.get_feature_mask(),
+            .blendEnable = material.get_alpha_mode() == Material::AlphaMode::blend ? VK_TRUE
+                                                                                   : VK_FALSE,
+            .cullMode    = material_cull_mode(material),
+        };
+    } };
+    m_materialPipelines.clear();
+    for (const auto& material : m_model.materials) {
+        m_materialPipelines.push_back(
+            context.get_pipeline_variant(pipelineIndex, materialVariant(material)));
+    }
+    m_materialPipelines.push_back(
+        context.get_pipeline_variant(pipelineIndex, materialVariant(Material{})));
+    return pipelineIndex;
+}
+
+std::pair<vulkan::Buffer, vulkan::Buffer> Engine::load_model_buffers()
+{
+    // Cooked models are packed when cooked, so their vertices are uploaded from the mapping
+    std::vector<PackedVertex> packedVertices{};
+    if (!m_cookedModel) {
+        packedVertices = pack_vertices(m_model.vertices, m_model.meshes);
+        EC_LOG_INFO("Packed {} vertices in {} KiB instead of {} KiB",
+                    packedVertices.size(),
+                    packedVertices.size() * sizeof(PackedVertex) >> 10,
+                    m_model.vertices.size() * sizeof(Vertex) >> 10);
+    }
+    std::span<const std::byte> vertexData{ m_cookedModel
+                                               ? m_cookedModel->get_vertex_data()
+                                               : std::as_bytes(std::span{ packedVertices }) };
+    std::span<const std::byte> indexData{ m_cookedModel
+                                              ? m_cookedModel->get_index_data()
+                                              : std::as_bytes(std::span{ m_model.indices }) };
+    if (vertexData.empty() || indexData.empty()) {
+        throw std::runtime_error(std::format("Model {} has no triangles to render", m_modelPath));
+    }
+
+    auto vertexBuffer{ m_renderer.create_buffer({
+        .count    = static_cast<uint32_t>(vertexData.size() / sizeof(PackedVertex)),
+        .elemSize = static_cast<vk::DeviceSize>(sizeof(PackedVertex)),
+        .usage    = vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst,
+        .memoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal,
+    }) };
+
+    // Each primitive with its own index type, bound per draw
+    m_indexPool.emplace(std::span{ reinterpret_cast<const uint32_t*>(indexData.data()),
+                                   indexData.size() / sizeof(uint32_t) },
+                        m_model.meshes,
+                        IndexPool::Info{ .uint8Indices = m_renderer.supports_uint8_indices() });
+    auto poolData{ m_indexPool->get_data() };
+    EC_LOG_INFO("Packed {} indices in {} KiB instead of {} KiB, {} draws",
+                indexData.size() / sizeof(uint32_t),
+                poolData.size() >> 10,
+                indexData.size() >> 10,
+                m_indexPool->get_num_draws());
+
+    auto indexBuffer{ m_renderer.create_buffer({
+        .count    = static_cast<uint32_t>(poolData.size()),
+        .elemSize = 1,
+        .usage    = vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst,
+        .memoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal,
+    }) };
+
+    std::vector<vulkan::BufferTransfer> transfers{
+        { &vertexBuffer, vertexBuffer.get_size(), vertexData.data() },
+        { &indexBuffer, indexBuffer.get_size(), poolData.data() },
+    };
+    m_renderer.transfer_data(transfers);
+
+    return std::make_pair(vertexBuffer, indexBuffer);
+}
+
+std::vector<vulkan::ImageData> Engine::get_model_image_data()
+{
+    m_materialImages.assign(m_model.materials.size(), {});
+    for (size_t i = 0; i < m_model.materials.size(); ++i) {
+        auto materialInfo{ m_model.materials[i].get_info() };
+        for (const auto& texture : { materialInfo.baseColorTexture,
+                                     materialInfo.metalnessRoughnessTexture,
+                                     materialInfo.emissiveTexture,
+                                     materialInfo.normalTexture,
+                                     materialInfo.occlusionTexture }) {
+            if (auto image{ get_texture_image(m_model, texture) }) {
+                m_materialImages[i].push_back(image.value());
+            }
+        }
+    }
+
+    auto colorImages{ find_color_images(m_model) };
+    std::vector<vulkan::ImageData> imageData{};
+    m_ktx2Images.clear();
+    m_ktx2Images.resize(m_model.images.size());
+    for (uint32_t i = 0; i < m_model.images.size(); ++i) {
+        const auto& image{ m_model.images[i] };
+        // KTX2 images keep the format of the file
+        m_ktx2Images[i] = load_ktx2_image(image);
+        if (m_ktx2Images[i]) {
+            imageData.push_back(m_ktx2Images[i]->get_image_data());
+            continue;
+        }
+        std::span<const std::byte> pixels{ m_cookedModel
+                                               ? m_cookedModel->get_image_data(i)
+                                               : std::as_bytes(std::span{ image.pixels }) };
+        imageData.push_back(get_image_data(image, pixels, colorImages[i]));
+    }
+    return imageData;
+}
+
+std::vector<vulkan::Image> Engine::load_model_textures(
+    const std::vector<vulkan::ImageData>& imageData)
+{
+    std::vector<vulkan::Image> textures(imageData.size());
+    std::vector<vulkan::ImageTransfer> transfers{};
+    for (size_t i = 0; i < imageData.size(); ++i) {
+        if (imageData[i].levels.empty()) {
+            continue;
+        }
+        textures[i] = m_renderer.create_texture(imageData[i]);
+        transfers.push_back({ .dstImage = &textures[i], .data = &imageData[i] });
+    }
+    m_renderer.transfer_data(transfers);
+
+    return textures;
+}
+
+vulkan::Image Engine::load_texture(const std::filesystem::path& path)
+{
+    if (path.extension() != Ktx2Texture::FILE_EXTENSION) {
+        throw std::runtime_error(
+            std::format("Texture {} is not a {} file", path.string(), Ktx2Texture::FILE_EXTENSION));
+    }
+    Ktx2Texture ktx2{ path };
+    const auto& data{ ktx2.get_image_data() };
+    vulkan::Image texture{ m_renderer.create_texture(data) };
+    m_renderer.transfer_data({ { .dstImage = &texture, .data = &data } });
+    EC_LOG_INFO("Loaded texture {}: {}x{}x{} {}, {} levels, {} layers",
+                path.string(),
+                data.extent.width,
+                data.extent.height,
+                data.extent.depth,
+                vk::to_string(data.format),
+                data.mipLevels,
+                data.arrayLayers);
+    return texture;
+}
+
+void Engine::frame_model()
+{
+    BoundingBox bounds{ m_model.get_bounds() };
+    glm::vec3 center{ bounds.is_valid() ? bounds.get_center() : glm::vec3{} };
+    float radius{ bounds.is_valid() ? glm::length(bounds.get_size()) * 0.5f : 1.f };
+    radius = std::max(radius, 1e-3f);
+
+    // Looking down -Z, the glTF forward direction, from where the bounding sphere fits the view
+    float fovY{ glm::radians(45.f) };
+    float distance{ radius / std::sin(fovY * 0.5f) };
+    m_camera = Camera{ PerspectiveCameraProperties{
+        .aspectRatio = 1.f,
+        .fovY        = fovY,
+        .zNear       = distance * 0.01f,
+        .zFar        = distance + radius * 2.f,
+    } };
+    m_camera.look_at(center + glm::vec3{ 0.f, 0.f, distance }, center, { 0.f, 1.f, 0.f });
+}
+
+void Engine::draw_model(vulkan::GraphicsContext& context,
+                        uint32_t pipelineIndex,
+                        const vulkan::Buffer& indexBuffer)
+{
+    vk::Extent2D extent{ context.get_render_extent() };
+    m_camera.set_aspect_ratio(static_cast<float>(extent.width)
+                              / static_cast<float>(std::max(extent.height, 1u)));
+    glm::mat4 viewProjection{ m_camera.get_view_projection() };
+    // Pixels per unit of size at a clip space w of 1, for the texture streaming feedback
+    float pixelScale{ std::abs(m_camera.get_projection_matrix()[1][1]) * 0.5f
+                      * static_cast<float>(extent.height) };
+
+    static const Material defaultMaterial{};
+    uint32_t boundPipeline{ pipelineIndex };
+    std::optional<vk::IndexType> boundIndexType{};
+    const auto& scene{ m_model.scenes.at(m_model.defaultScene) };
+    scene.traverse(
+        [&](const Entity& entity, const glm::mat4& transform)
+        {
+            if (!entity.get_mesh_index()) {
+                return;
+            }
+            glm::mat3 normalMatrix{ glm::transpose(glm::inverse(glm::mat3{ transform })) };
+            glm::mat4 modelViewProjection{ viewProjection * transform };
+            ModelPushConstants pushConstants{
+                .normalMatrix = { glm::vec4{ normalMatrix[0], 0.f },
+                                  glm::vec4{ normalMatrix[1], 0.f },
+                                  glm::vec4{ normalMatrix[2], 0.f } },
+            };
+
+            uint32_t meshIndex{ entity.get_mesh_index().value() };
+            const auto& primitives{ m_model.meshes.at(meshIndex).get_primitives() };
+            for (uint32_t i = 0; i < primitives.size(); ++i) {
+                const Primitive& primitive{ primitives[i] };
+                const Material& material{
+                    primitive.materialIndex ? m_model.materials.at(primitive.materialIndex.value())
+                                            : defaultMaterial
+                };
+                // Blended materials are drawn in scene order, unsorted, with depth writes
+                bool masked{ material.get_alpha_mode() == Material::AlphaMode::mask };
+                pushConstants.mvp
+                    = modelViewProjection * get_dequantization_matrix(primitive.bounds);
+                pushConstants.normalMatrix[0].w = masked ? material.get_alpha_cutoff() : 0.f;
+                pushConstants.baseColor         = material.get_base_color();
+                uint32_t materialPipeline{ m_materialPipelines.at(
+                    primitive.materialIndex.value_or(m_model.materials.size())) };
+                if (boundPipeline != materialPipeline) {
+                    context.bind_pipeline(materialPipeline);  // Before the dynamic state below
+                    boundPipeline = materialPipeline;
+                }
+                // Else baked into the variant
+                if (context.has_extended_dynamic_state()) {
+                    context.set_cull_mode(material_cull_mode(material));
+                }
+                context.push_constants(materialPipeline,
+                                       vk::ShaderStageFlagBits::eVertex,
+                                       0,
+                                       sizeof(pushConstants),
+                                       &pushConstants);
+                // Consecutive draws mostly share the index type, it is only bound on changes
+                for (const auto& draw : m_indexPool->get_draws(meshIndex, i)) {
+                    if (boundIndexType != draw.indexType) {
+                        context.bind_index_buffer(indexBuffer, draw.indexType);
+                        boundIndexType = draw.indexType;
+                    }
+                    context.draw_indexed(draw.indexCount, draw.firstIndex, draw.vertexOffset);
+                }
+
+                // Assumes the textures are mapped once over the primitive
+                if (m_textureStreamer && primitive.materialIndex) {
+                    BoundingBox bounds{ primitive.bounds.transformed(transform) };
+                    glm::vec4 center{ viewProjection * glm::vec4{ bounds.get_center(), 1.f } };
+                    float screenSize{ glm::length(bounds.get_size()) * pixelScale
+                                      / std::max(center.w, 1e-3f) };
+                    for (uint32_t image : m_materialImages.at(primitive.materialIndex.value())) {
+                        m_textureStreamer->request(image, screenSize);
+                    }
+                }
+            }
+        });
+}
+
 }  // namespace ec
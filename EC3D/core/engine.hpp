@@ -3,6 +3,14 @@
 #include "backend/renderer.hpp"
 #include "backend/utils.hpp"
 #include "backend/graphics_context.hpp"
+#include "core/frame_exporter.hpp"
+#include "core/object_loader.hpp"
+#include "core/cooked_model.hpp"
+#include "core/camera.hpp"
+#include "core/texture_streamer.hpp"
+#include "core/ktx2_texture.hpp"
+#include "core/packed_vertex.hpp"
+#include "core/index_pool.hpp"
 
 namespace ec
 {
@@ -14,6 +22,27 @@ public:
     struct Info {
         bool validationLayers{};
         bool verticalSync{};
+        bool dynamicRendering{};  // Use vkCmdBeginRendering instead of render pass objects
+        bool shaderObjects{};     // Use shader objects instead of pipelines if supported, with
+                                  // dynamic rendering
+        bool headless{};          // Offscreen rendering, windowInfo only sets the size
+        bool recordAhead{};       // Record the frame before acquiring the swapchain image
+        uint32_t framesInFlight{ vulkan::GraphicsContext::DEFAULT_FRAMES_IN_FLIGHT };
+        uint32_t swapchainImages{ 3 };
+        float targetFrameRate{};  // Adapts the two above to reach it with the least latency, or 0
+        float frameRateLimit{};   // Frames per second at most, 0 for unlimited
+        std::optional<vk::PresentModeKHR> presentMode{};  // Instead of the verticalSync default
+        uint32_t maxFrames{};     // Stop after this many frames, 0 to run until the window closes
+        FrameExporter::Info exportInfo{};  // Read back and export every frame if path is set
+        // glTF or cooked model file rendered instead of the test triangle, if set
+        std::string modelPath{};
+        uint32_t loaderThreads{};  // Worker threads importing the model, 0 for all cores
+        // Reorder the imported meshes for the vertex cache, overdraw and vertex fetch
+        bool optimizeMeshes{ true };
+        // Keep only the mip levels in view resident, if the model shaders sample textures
+        bool streamTextures{};
+        uint32_t textureBudget{};  // MiB of streamed textures, 0 for what the device has free
+        std::string texturePath{};  // KTX2 file uploaded at startup, on its own, if set
         Window::Info windowInfo{};
     };
 
@@ -34,12 +63,56 @@ private:
 
     void init(const Engine::Info& info);
     void create_test_renderpass(vulkan::GraphicsContext& context);
+    void create_test_dynamic_rendering(vulkan::GraphicsContext& context);
     void add_test_pipeline(vulkan::GraphicsContext& context);
     std::pair<vulkan::Buffer, vulkan::Buffer> load_test_buffers();
 
+    // Also creates the variant of each material in m_materialPipelines
+    uint32_t add_model_pipeline(vulkan::GraphicsContext& context);
+    // Uploads the vertex and index streams of m_model in a single transfer, packed and with the
+    // draws of each primitive in m_indexPool. Read from the file mapping for cooked models, which
+    // are stored packed
+    std::pair<vulkan::Buffer, vulkan::Buffer> load_model_buffers();
+    // One per model image, in sRGB if any material reads colors from it, without levels if it
+    // failed to decode. KTX2 images are read from m_ktx2Images in their own format. Also fills
+    // m_materialImages
+    std::vector<vulkan::ImageData> get_model_image_data();
+    // Full mip chains, images without levels are left empty
+    std::vector<vulkan::Image> load_model_textures(const std::vector<vulkan::ImageData>& imageData);
+    // With all its levels. Throws if path is not a KTX2 file the device can sample
+    vulkan::Image load_texture(const std::filesystem::path& path);
+    // Places the camera so the whole default scene is in view
+    void frame_model();
+    // indexBuffer holds the data of m_indexPool. Binds the variant of pipelineIndex of each
+    // material, pipelineIndex is expected to be bound
+    void draw_model(vulkan::GraphicsContext& context,
+                    uint32_t pipelineIndex,
+                    const vulkan::Buffer& indexBuffer);
+
 private:
 
     vulkan::Renderer m_renderer{};
+
+    bool m_dynamicRendering{};
+    uint32_t m_maxFrames{};
+    uint32_t m_framesInFlight{};
+    float m_targetFrameRate{};
+    float m_frameRateLimit{};
+    std::optional<vk::PresentModeKHR> m_presentMode{};
+    FrameExporter::Info m_exportInfo{};
+
+    std::string m_modelPath{};
+    uint32_t m_loaderThreads{};
+    bool m_optimizeMeshes{};
+    std::string m_texturePath{};
+    Model m_model{};
+    std::optional<CookedModel> m_cookedModel{};  // Mapped until its data is uploaded
+    std::vector<std::optional<Ktx2Texture>> m_ktx2Images{};  // Per model image, mapped likewise
+    std::optional<IndexPool> m_indexPool{};      // Draws of each primitive
+    Camera m_camera{};
+    std::vector<std::vector<uint32_t>> m_materialImages{};  // Images read by each material
+    std::vector<uint32_t> m_materialPipelines{};  // Per material, the default material last
+    std::optional<TextureStreamer> m_textureStreamer{};
 };
 
 }  // namespace ec
@@ -4,4 +4,11 @@
 namespace ec
 {
 
+Entity::Entity(const Entity::Info& info) :
+  m_name{ info.name },
+  m_transform{ info.transform },
+  m_meshIndex{ info.meshIndex }
+{
 }
+
+}  // namespace ec
@@ -1,18 +1,42 @@
 #pragma once
 
+#include <glm/glm.hpp>
+
+#include <optional>
+#include <string>
+#include <vector>
+
 namespace ec
 {
 
+// Node of a scene hierarchy. The transform is relative to the parent entity
 class Entity
 {
 public:
 
+    struct Info {
+        std::string name{};
+        glm::mat4 transform{ 1.f };
+        std::optional<uint32_t> meshIndex{};  // Into the meshes of the Model, none if empty
+    };
+
     Entity() = default;
+    explicit Entity(const Entity::Info& info);
+
+    void add_child(Entity&& child) { m_children.push_back(std::move(child)); }
+
+    const std::string& get_name() const { return m_name; }
+    const glm::mat4& get_transform() const { return m_transform; }
+    const std::optional<uint32_t>& get_mesh_index() const { return m_meshIndex; }
+    const std::vector<Entity>& get_children() const { return m_children; }
 
 private:
 
     std::string m_name{};
 
+    glm::mat4 m_transform{ 1.f };
+    std::optional<uint32_t> m_meshIndex{};
+
     std::vector<Entity> m_children{};
 };
 
@@ -0,0 +1,163 @@
+#include "pch.hpp"
+#include "frame_exporter.hpp"
+
+#include <filesystem>
+#ifdef _WIN32
+    #include <fcntl.h>
+    #include <io.h>
+#endif
+
+#pragma warning(push, 0)
+#include <stb_image_write.h>
+#pragma warning(pop)
+
+namespace ec
+{
+
+FrameExporter::FrameExporter(const FrameExporter::Info& info) :
+  m_mode{ info.mode },
+  m_path{ info.path },
+  m_maxQueuedFrames{ info.maxQueuedFrames }
+{
+    if (m_mode == Mode::png) {
+        std::filesystem::create_directories(m_path);
+    } else if (m_path == STDOUT_PATH) {
+        m_rawFile = stdout;
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);  // Text mode would expand the 0x0A bytes
+#endif
+    } else {
+        m_rawFile = std::fopen(m_path.c_str(), "wb");
+        if (!m_rawFile) {
+            throw std::runtime_error(std::format("Failed to open {} to export frames!", m_path));
+        }
+    }
+    m_thread = std::thread(&FrameExporter::worker_loop, this);
+}
+
+FrameExporter::~FrameExporter() noexcept
+{
+    stop();
+}
+
+void FrameExporter::submit(const vulkan::ReadbackFrame& frame)
+{
+    std::vector<std::byte> pixels{};
+    {
+        std::scoped_lock lock{ m_mutex };
+        if (m_stop) {
+            return;
+        }
+        if (m_jobs.size() >= m_maxQueuedFrames) {
+            ++m_numDropped;
+            return;
+        }
+        if (!m_freeBuffers.empty()) {
+            pixels = std::move(m_freeBuffers.back());
+            m_freeBuffers.pop_back();
+        }
+    }
+
+    // Copied outside of the lock, the worker keeps encoding meanwhile
+    pixels.assign(frame.data, frame.data + frame.size);
+    {
+        std::scoped_lock lock{ m_mutex };
+        m_jobs.push_back({
+            .frameNumber = frame.frameNumber,
+            .extent      = frame.extent,
+            .format      = frame.format,
+            .pixels      = std::move(pixels),
+        });
+    }
+    m_condition.notify_one();
+}
+
+void FrameExporter::stop()
+{
+    {
+        std::scoped_lock lock{ m_mutex };
+        m_stop = true;
+    }
+    m_condition.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    if (m_rawFile) {
+        std::fflush(m_rawFile);
+        if (m_rawFile != stdout) {
+            std::fclose(m_rawFile);
+        }
+        m_rawFile = nullptr;
+    }
+    if (m_numDropped > 0) {
+        EC_LOG_WARN("Frame export dropped {} frames, the writer could not keep up",
+                    m_numDropped.load());
+    }
+}
+
+void FrameExporter::worker_loop()
+{
+    while (true) {
+        Job job{};
+        {
+            std::unique_lock lock{ m_mutex };
+            m_condition.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+            // Queued frames are still written when stopping
+            if (m_jobs.empty()) {
+                return;
+            }
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+
+        try {
+            if (m_mode == Mode::png) {
+                write_png(job);
+            } else {
+                write_raw(job);
+            }
+            ++m_numWritten;
+        }
+        catch (const std::exception& e) {
+            EC_LOG_ERROR("Failed to export frame {}. Reason: {}", job.frameNumber, e.what());
+        }
+
+        std::scoped_lock lock{ m_mutex };
+        m_freeBuffers.push_back(std::move(job.pixels));
+    }
+}
+
+void FrameExporter::write_png(Job& job)
+{
+    // PNG is always RGBA, swizzle BGRA swapchain formats in place
+    if (job.format == vk::Format::eB8G8R8A8Unorm || job.format == vk::Format::eB8G8R8A8Srgb) {
+        for (size_t i = 0; i + 3 < job.pixels.size(); i += 4) {
+            std::swap(job.pixels[i], job.pixels[i + 2]);
+        }
+    }
+
+    std::string filePath{ std::format("{}/frame_{:06}.png", m_path, job.frameNumber) };
+    int width{ static_cast<int>(job.extent.width) };
+    int height{ static_cast<int>(job.extent.height) };
+    if (!stbi_write_png(filePath.c_str(), width, height, 4, job.pixels.data(), width * 4)) {
+        throw std::runtime_error(std::format("Failed to write {}", filePath));
+    }
+}
+
+void FrameExporter::write_raw(const Job& job)
+{
+    if (m_rawExtent.width == 0) {
+        m_rawExtent = job.extent;
+        EC_LOG_INFO("Exporting raw {} frames of {}x{}",
+                    vk::to_string(job.format),
+                    job.extent.width,
+                    job.extent.height);
+    } else if (job.extent != m_rawExtent) {
+        throw std::runtime_error("Frame size changed during a raw export");
+    }
+    if (std::fwrite(job.pixels.data(), 1, job.pixels.size(), m_rawFile) != job.pixels.size()) {
+        throw std::runtime_error("Failed to write to the raw export file");
+    }
+}
+
+}  // namespace ec
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "backend/frame_readback.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace ec
+{
+
+// Writes read back frames from a worker thread, so encoding never blocks the render loop
+class FrameExporter
+{
+public:
+
+    enum class Mode {
+        png,  // One PNG per frame (frame_<number>.png) in the directory at path
+        raw,  // Tightly packed pixels of every frame appended to the file at path (STDOUT_PATH
+              // for stdout), e.g. for ffmpeg -f rawvideo -pix_fmt bgra -s WxH -i <path>
+    };
+
+    constexpr static std::string_view STDOUT_PATH{ "-" };
+
+    struct Info {
+        Mode mode{};
+        std::string path{};
+        // Frames submitted while this many are waiting to be written are dropped
+        uint32_t maxQueuedFrames{ 8 };
+
+        // Anything else printed to stdout would corrupt the frames, status goes to stderr then
+        bool writes_to_stdout() const { return mode == Mode::raw && path == STDOUT_PATH; }
+    };
+
+    explicit FrameExporter(const FrameExporter::Info& info);
+    ~FrameExporter() noexcept;
+
+    FrameExporter(const FrameExporter&)            = delete;
+    FrameExporter(FrameExporter&&)                 = delete;
+    FrameExporter& operator=(const FrameExporter&) = delete;
+    FrameExporter& operator=(FrameExporter&&)      = delete;
+
+    // Copies the pixels, so it can be called directly from a readback callback
+    void submit(const vulkan::ReadbackFrame& frame);
+
+    // Writes the queued frames and joins the worker
+    void stop();
+
+    uint64_t get_num_written() const { return m_numWritten; }
+    uint64_t get_num_dropped() const { return m_numDropped; }
+
+private:
+
+    struct Job {
+        uint64_t frameNumber{};
+        vk::Extent2D extent{};
+        vk::Format format{};
+        std::vector<std::byte> pixels{};
+    };
+
+    void worker_loop();
+    void write_png(Job& job);
+    void write_raw(const Job& job);
+
+private:
+
+    Mode m_mode{};
+    std::string m_path{};
+    uint32_t m_maxQueuedFrames{};
+    std::FILE* m_rawFile{};
+    vk::Extent2D m_rawExtent{};  // Of the first frame, a raw stream can't change size
+
+    std::thread m_thread{};
+    std::mutex m_mutex{};
+    std::condition_variable m_condition{};
+    std::deque<Job> m_jobs{};
+    std::vector<std::vector<std::byte>> m_freeBuffers{};  // Recycled pixel storage
+    bool m_stop{};
+
+    std::atomic<uint64_t> m_numWritten{};
+    std::atomic<uint64_t> m_numDropped{};
+};
+
+}  // namespace ec
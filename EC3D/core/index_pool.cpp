@@ -0,0 +1,155 @@
+#include "pch.hpp"
+#include "index_pool.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace ec
+{
+
+constexpr uint32_t MAX_UINT16_INDEX{ std::numeric_limits<uint16_t>::max() };
+
+vk::IndexType select_index_type(uint32_t maxIndex, bool uint8Indices)
+{
+    if (uint8Indices && maxIndex <= std::numeric_limits<uint8_t>::max()) {
+        return vk::IndexType::eUint8EXT;
+    }
+    return maxIndex <= MAX_UINT16_INDEX ? vk::IndexType::eUint16 : vk::IndexType::eUint32;
+}
+
+uint32_t get_index_size(vk::IndexType indexType)
+{
+    switch (indexType) {
+        case vk::IndexType::eUint8EXT: return 1;
+        case vk::IndexType::eUint16: return 2;
+        case vk::IndexType::eUint32: return 4;
+        default: throw std::runtime_error("Index type without indices");
+    }
+}
+
+// Appends the indices minus baseIndex, narrowed to indexType
+static void append_indices(std::vector<std::byte>& data,
+                           std::span<const uint32_t> indices,
+                           vk::IndexType indexType,
+                           uint32_t baseIndex)
+{
+    auto append{ [&]<typename T>(T)
+                 {
+                     size_t offset{ data.size() };
+                     data.resize(offset + indices.size() * sizeof(T));
+                     for (size_t i = 0; i < indices.size(); ++i) {
+                         T index{ static_cast<T>(indices[i] - baseIndex) };
+                         std::memcpy(data.data() + offset + i * sizeof(T), &index, sizeof(T));
+                     }
+                 } };
+    switch (get_index_size(indexType)) {
+        case 1: append(uint8_t{}); break;
+        case 2: append(uint16_t{}); break;
+        default: append(uint32_t{}); break;
+    }
+}
+
+std::vector<std::byte> pack_indices(std::span<const uint32_t> indices, vk::IndexType indexType)
+{
+    std::vector<std::byte> data{};
+    append_indices(data, indices, indexType, 0);
+    return data;
+}
+
+// Consecutive triangles whose vertices are within 16-bit range of the lowest one, as the first
+// triangle and the lowest vertex of each chunk. Empty if a triangle alone is out of range
+static std::vector<std::pair<uint32_t, uint32_t>> split_16bit_chunks(
+    std::span<const uint32_t> indices)
+{
+    std::vector<std::pair<uint32_t, uint32_t>> chunks{};
+    uint32_t minIndex{ std::numeric_limits<uint32_t>::max() };
+    uint32_t maxIndex{};
+    for (uint32_t triangle = 0; triangle < indices.size() / 3; ++triangle) {
+        auto [triangleMin, triangleMax]{ std::minmax(
+            { indices[triangle * 3], indices[triangle * 3 + 1], indices[triangle * 3 + 2] }) };
+        if (triangleMax - triangleMin > MAX_UINT16_INDEX) {
+            return {};
+        }
+        uint32_t newMin{ std::min(minIndex, triangleMin) };
+        uint32_t newMax{ std::max(maxIndex, triangleMax) };
+        if (chunks.empty() || newMax - newMin > MAX_UINT16_INDEX) {
+            chunks.emplace_back(triangle, triangleMin);
+            newMin = triangleMin;
+            newMax = triangleMax;
+        }
+        minIndex             = newMin;
+        maxIndex             = newMax;
+        chunks.back().second = minIndex;
+    }
+    return chunks;
+}
+
+IndexPool::IndexPool(std::span<const uint32_t> indices,
+                     std::span<const Mesh> meshes,
+                     const IndexPool::Info& info)
+{
+    m_primitiveDraws.resize(meshes.size());
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        for (const auto& primitive : meshes[i].get_primitives()) {
+            auto primitiveIndices{ indices.subspan(primitive.firstIndex, primitive.indexCount) };
+            m_primitiveDraws[i].push_back({ static_cast<uint32_t>(m_draws.size()), 0 });
+            add_primitive(primitiveIndices, primitive.vertexOffset, info);
+            m_primitiveDraws[i].back().second = static_cast<uint32_t>(m_draws.size())
+                                                - m_primitiveDraws[i].back().first;
+        }
+    }
+}
+
+std::span<const IndexedDraw> IndexPool::get_draws(uint32_t meshIndex,
+                                                  uint32_t primitiveIndex) const
+{
+    auto [first, count]{ m_primitiveDraws.at(meshIndex).at(primitiveIndex) };
+    return std::span{ m_draws }.subspan(first, count);
+}
+
+void IndexPool::add_primitive(std::span<const uint32_t> indices,
+                              int32_t vertexOffset,
+                              const IndexPool::Info& info)
+{
+    if (indices.empty()) {
+        return;
+    }
+    vk::IndexType indexType{ select_index_type(std::ranges::max(indices), info.uint8Indices) };
+    if (indexType == vk::IndexType::eUint32) {
+        auto chunks{ split_16bit_chunks(indices) };
+        size_t savedBytes{ indices.size() * (sizeof(uint32_t) - sizeof(uint16_t)) };
+        if (!chunks.empty() && (chunks.size() - 1) * info.splitCost < savedBytes) {
+            for (size_t c = 0; c < chunks.size(); ++c) {
+                uint32_t start{ chunks[c].first * 3 };
+                uint32_t end{ c + 1 < chunks.size() ? chunks[c + 1].first * 3
+                                                    : static_cast<uint32_t>(indices.size()) };
+                uint32_t baseIndex{ chunks[c].second };
+                add_draw(indices.subspan(start, end - start),
+                         vk::IndexType::eUint16,
+                         baseIndex,
+                         vertexOffset + static_cast<int32_t>(baseIndex));
+            }
+            return;
+        }
+    }
+    add_draw(indices, indexType, 0, vertexOffset);
+}
+
+void IndexPool::add_draw(std::span<const uint32_t> indices,
+                         vk::IndexType indexType,
+                         uint32_t baseIndex,
+                         int32_t vertexOffset)
+{
+    // firstIndex is in indices, so the draw starts at a multiple of the index size
+    uint32_t indexSize{ get_index_size(indexType) };
+    m_data.resize((m_data.size() + indexSize - 1) / indexSize * indexSize);
+    m_draws.push_back({
+        .indexType    = indexType,
+        .firstIndex   = static_cast<uint32_t>(m_data.size() / indexSize),
+        .indexCount   = static_cast<uint32_t>(indices.size()),
+        .vertexOffset = vertexOffset,
+    });
+    append_indices(m_data, indices, indexType, baseIndex);
+}
+
+}  // namespace ec
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include "mesh.hpp"
+
+#include <span>
+
+namespace ec
+{
+
+// Indexed draw of a primitive, or of a chunk of one, from an IndexPool
+struct IndexedDraw {
+    vk::IndexType indexType{};
+    uint32_t firstIndex{};  // In indices of indexType from the start of the pool
+    uint32_t indexCount{};
+    int32_t vertexOffset{};
+};
+
+// Narrowest index type that can index vertices [0, maxIndex]
+vk::IndexType select_index_type(uint32_t maxIndex, bool uint8Indices);
+uint32_t get_index_size(vk::IndexType indexType);
+// Indices narrowed to indexType, bytes as read by the GPU. Each index must fit in it
+std::vector<std::byte> pack_indices(std::span<const uint32_t> indices, vk::IndexType indexType);
+
+// Indices of all the primitives of a model packed into one buffer, each primitive with the
+// narrowest index type. Primitives over 65536 vertices are split into draws of 16-bit indices
+// when that is smaller, which works best after optimize_vertex_fetch
+class IndexPool
+{
+public:
+
+    struct Info {
+        bool uint8Indices{};  // See Device::supports_uint8_indices
+        // Bytes of indices an additional draw must save for a primitive to be split
+        uint32_t splitCost{ 4096 };
+    };
+
+    IndexPool(std::span<const uint32_t> indices,
+              std::span<const Mesh> meshes,
+              const IndexPool::Info& info);
+
+    // Bound with the index type of each draw, which rarely changes between draws
+    std::span<const std::byte> get_data() const { return m_data; }
+    std::span<const IndexedDraw> get_draws(uint32_t meshIndex, uint32_t primitiveIndex) const;
+    uint32_t get_num_draws() const { return static_cast<uint32_t>(m_draws.size()); }
+
+private:
+
+    void add_primitive(std::span<const uint32_t> indices,
+                       int32_t vertexOffset,
+                       const IndexPool::Info& info);
+    void add_draw(std::span<const uint32_t> indices,
+                  vk::IndexType indexType,
+                  uint32_t baseIndex,
+                  int32_t vertexOffset);
+
+private:
+
+    std::vector<std::byte> m_data{};
+    std::vector<IndexedDraw> m_draws{};
+    // First draw and number of draws of each primitive of each mesh
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> m_primitiveDraws{};
+};
+
+}  // namespace ec
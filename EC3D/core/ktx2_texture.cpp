@@ -0,0 +1,116 @@
+#include "pch.hpp"
+#include "ktx2_texture.hpp"
+#include "backend/utils.hpp"
+
+#include <cstring>
+
+namespace ec
+{
+
+constexpr std::array<uint8_t, 12> KTX2_IDENTIFIER{ 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32,
+                                                   0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+// At the beginning of the file, followed by the level index
+struct Ktx2Header {
+    std::array<uint8_t, 12> identifier;
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;  // 0 for 1D textures
+    uint32_t pixelDepth;   // 0 for anything but 3D textures
+    uint32_t layerCount;   // 0 if not an array
+    uint32_t faceCount;    // 6 for cube maps
+    uint32_t levelCount;   // 0 to have the mip levels generated
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+static_assert(sizeof(Ktx2Header) == 80);
+
+struct Ktx2LevelIndex {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+Ktx2Texture::Ktx2Texture(const std::filesystem::path& path) :
+  m_file{ path }
+{
+    auto fileBytes{ m_file.get_bytes() };
+    Ktx2Header header{};
+    if (fileBytes.size() < sizeof(header)) {
+        throw std::runtime_error(std::format("{} is not a KTX2 file", path.string()));
+    }
+    std::memcpy(&header, fileBytes.data(), sizeof(header));
+    if (header.identifier != KTX2_IDENTIFIER) {
+        throw std::runtime_error(std::format("{} is not a KTX2 file", path.string()));
+    }
+    if (header.supercompressionScheme != 0) {
+        throw std::runtime_error(
+            std::format("{} is supercompressed, which is not supported", path.string()));
+    }
+    auto format{ static_cast<vk::Format>(header.vkFormat) };
+    if (format == vk::Format::eUndefined) {
+        throw std::runtime_error(
+            std::format("{} has no Vulkan format (e.g. Basis Universal)", path.string()));
+    }
+    bool cube{ header.faceCount == 6 };
+    if ((header.faceCount != 1 && !cube) || (header.pixelDepth > 0 && header.layerCount > 0)
+        || (cube && header.pixelDepth > 0)) {
+        throw std::runtime_error(
+            std::format("{} has an unsupported combination of faces, layers and depth",
+                        path.string()));
+    }
+
+    vk::Extent3D extent{
+        .width  = header.pixelWidth,
+        .height = std::max(header.pixelHeight, 1u),
+        .depth  = std::max(header.pixelDepth, 1u),
+    };
+    m_imageData = vulkan::ImageData{
+        .format      = format,
+        .type        = header.pixelDepth > 0 ? vulkan::Image::Type::image3D
+                       : cube                ? vulkan::Image::Type::imageCube
+                                             : vulkan::Image::Type::image2D,
+        .extent      = extent,
+        .mipLevels   = header.levelCount > 0
+                           ? header.levelCount
+                           : vulkan::Image::get_max_mip_levels(extent.width,
+                                                               extent.height,
+                                                               extent.depth),
+        .arrayLayers = std::max(header.layerCount, 1u) * header.faceCount,
+    };
+    if (m_imageData.mipLevels
+        > vulkan::Image::get_max_mip_levels(extent.width, extent.height, extent.depth)) {
+        throw std::runtime_error(std::format("{} has too many mip levels", path.string()));
+    }
+
+    // Faces and layers of each level are stored one after the other, as Vulkan copies expect
+    uint32_t numLevels{ std::max(header.levelCount, 1u) };
+    auto levelIndexBytes{ m_file.get_bytes(sizeof(header), numLevels * sizeof(Ktx2LevelIndex)) };
+    for (uint32_t level = 0; level < numLevels; ++level) {
+        Ktx2LevelIndex levelIndex{};
+        std::memcpy(&levelIndex,
+                    levelIndexBytes.data() + level * sizeof(levelIndex),
+                    sizeof(levelIndex));
+        vk::DeviceSize expectedSize{
+            vulkan::image_level_size(format, extent, level, m_imageData.arrayLayers)
+        };
+        if (levelIndex.byteLength != expectedSize) {
+            throw std::runtime_error(
+                std::format("Level {} of {} has {} bytes instead of {}",
+                            level,
+                            path.string(),
+                            levelIndex.byteLength,
+                            expectedSize));
+        }
+        m_imageData.levels.push_back(
+            m_file.get_bytes(levelIndex.byteOffset, levelIndex.byteLength));
+    }
+}
+
+}  // namespace ec
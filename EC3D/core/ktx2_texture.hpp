@@ -0,0 +1,34 @@
+#pragma once
+
+#include "backend/image.hpp"
+#include "misc/mapped_file.hpp"
+
+#include <filesystem>
+#include <string_view>
+
+namespace ec
+{
+
+// KTX2 texture file. Levels are read straight from the file mapping in their stored format, so
+// block compressed data (BC1-7, ETC2, ASTC) stays compressed up to the GPU. Supercompressed files
+// (BasisLZ, Zstandard) are not supported
+class Ktx2Texture
+{
+public:
+
+    constexpr static std::string_view FILE_EXTENSION{ ".ktx2" };
+
+    // Throws if the file is not a KTX2 texture that can be uploaded as is
+    explicit Ktx2Texture(const std::filesystem::path& path);
+
+    // Valid while the Ktx2Texture is alive. Files without mip levels get a single level, for the
+    // rest to be generated on upload
+    const vulkan::ImageData& get_image_data() const { return m_imageData; }
+
+private:
+
+    MappedFile m_file{};
+    vulkan::ImageData m_imageData{};
+};
+
+}  // namespace ec
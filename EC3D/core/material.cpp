@@ -4,4 +4,71 @@
 namespace ec
 {
 
+Material::Material(const Material::Info& info) :
+  m_name{ info.name },
+  m_baseColor{ info.baseColor },
+  m_metalness{ info.metalness },
+  m_roughness{ info.roughness },
+  m_baseColorTexture{ info.baseColorTexture.value_or(MaterialTexture{}) },
+  m_metalnessRoughnessTexture{ info.metalnessRoughnessTexture.value_or(MaterialTexture{}) },
+  m_hasColorTexture{ info.baseColorTexture.has_value() },
+  // Both come from the same texture in glTF
+  m_hasMetalnessTexture{ info.metalnessRoughnessTexture.has_value() },
+  m_hasRoughnessTexture{ info.metalnessRoughnessTexture.has_value() },
+  m_alphaMode{ info.alphaMode },
+  m_alphaCutoff{ info.alphaCutoff },
+  m_doubleSided{ info.doubleSided },
+  m_emissive{ info.emissive },
+  m_normalScale{ info.normalScale },
+  m_occlusionStrength{ info.occlusionStrength },
+  m_emissiveTexture{ info.emissiveTexture.value_or(MaterialTexture{}) },
+  m_normalTexture{ info.normalTexture.value_or(MaterialTexture{}) },
+  m_occlusionTexture{ info.occlusionTexture.value_or(MaterialTexture{}) },
+  m_hasNormalTexture{ info.normalTexture.has_value() },
+  m_hasOcclusionTexture{ info.occlusionTexture.has_value() },
+  m_hasEmissiveTexture{ info.emissiveTexture.has_value() }
+{
+}
+
+uint32_t Material::get_feature_mask() const
+{
+    auto bit{ [](bool enabled, MaterialFeature feature)
+              { return enabled ? static_cast<uint32_t>(feature) : 0u; } };
+
+    return bit(m_hasColorTexture, MaterialFeature::colorTexture)
+           | bit(m_hasMetalnessTexture || m_hasRoughnessTexture,
+                 MaterialFeature::metalnessRoughnessTexture)
+           | bit(m_hasNormalTexture, MaterialFeature::normalTexture)
+           | bit(m_hasOcclusionTexture, MaterialFeature::occlusionTexture)
+           | bit(m_hasEmissiveTexture, MaterialFeature::emissiveTexture)
+           | bit(m_alphaMode == AlphaMode::mask, MaterialFeature::alphaMask)
+           | bit(m_alphaMode == AlphaMode::blend, MaterialFeature::alphaBlend)
+           | bit(m_doubleSided, MaterialFeature::doubleSided);
 }
+
+Material::Info Material::get_info() const
+{
+    auto texture{ [](bool enabled, const MaterialTexture& texture)
+                  { return enabled ? std::optional{ texture } : std::nullopt; } };
+
+    return {
+        .name                      = m_name,
+        .baseColor                 = m_baseColor,
+        .metalness                 = m_metalness,
+        .roughness                 = m_roughness,
+        .baseColorTexture          = texture(m_hasColorTexture, m_baseColorTexture),
+        .metalnessRoughnessTexture = texture(m_hasMetalnessTexture || m_hasRoughnessTexture,
+                                             m_metalnessRoughnessTexture),
+        .alphaMode                 = m_alphaMode,
+        .alphaCutoff               = m_alphaCutoff,
+        .doubleSided               = m_doubleSided,
+        .emissive                  = m_emissive,
+        .normalScale               = m_normalScale,
+        .occlusionStrength         = m_occlusionStrength,
+        .emissiveTexture           = texture(m_hasEmissiveTexture, m_emissiveTexture),
+        .normalTexture             = texture(m_hasNormalTexture, m_normalTexture),
+        .occlusionTexture          = texture(m_hasOcclusionTexture, m_occlusionTexture),
+    };
+}
+
+}  // namespace ec
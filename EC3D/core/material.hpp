@@ -2,6 +2,9 @@
 
 #include <glm/glm.hpp>
 
+#include <optional>
+#include <string>
+
 namespace ec
 {
 
@@ -9,23 +12,89 @@ class MaterialTexture
 {
 public:
 
+    MaterialTexture() = default;
     explicit MaterialTexture(uint32_t textureIndex, uint32_t texCoords = 0) :
       m_textureIndex(textureIndex),
       m_texCoords(texCoords){};
 
+    uint32_t get_texture_index() const { return m_textureIndex; }
+    uint32_t get_tex_coords() const { return m_texCoords; }  // Vertex texture coordinate set
+
 private:
 
-    uint32_t m_textureIndex;
+    uint32_t m_textureIndex{};
     uint32_t m_texCoords{};
 };
 
+// Bit i is specialization constant i of the material shaders (see PipelineManager variants)
+enum class MaterialFeature : uint32_t {
+    colorTexture              = 1 << 0,
+    metalnessRoughnessTexture = 1 << 1,
+    normalTexture             = 1 << 2,
+    occlusionTexture          = 1 << 3,
+    emissiveTexture           = 1 << 4,
+    alphaMask                 = 1 << 5,
+    alphaBlend                = 1 << 6,
+    doubleSided               = 1 << 7,
+};
+
 class Material
 {
 public:
 
+    enum class AlphaMode {
+        opaque,
+        mask,
+        blend,
+    };
+
+    // Textures are indices into the textures of the source file, unused if empty
+    struct Info {
+        std::string name{};
+        glm::vec4 baseColor{ 1.f };
+        float metalness{ 1.f };
+        float roughness{ 1.f };
+        std::optional<MaterialTexture> baseColorTexture{};
+        std::optional<MaterialTexture> metalnessRoughnessTexture{};
+        AlphaMode alphaMode{ AlphaMode::opaque };
+        float alphaCutoff{ 0.5f };
+        bool doubleSided{};
+        glm::vec3 emissive{};
+        float normalScale{ 1.f };
+        float occlusionStrength{ 1.f };
+        std::optional<MaterialTexture> emissiveTexture{};
+        std::optional<MaterialTexture> normalTexture{};
+        std::optional<MaterialTexture> occlusionTexture{};
+    };
+
     // TODO: Create an "error" material (e.g. pink emissive texture)
 
     Material() = default;
+    explicit Material(const Material::Info& info);
+
+    // Mask of MaterialFeature, used to select the specialized pipeline of this material
+    uint32_t get_feature_mask() const;
+    // Creates an equivalent material, e.g. to serialize it
+    Material::Info get_info() const;
+
+    const std::string& get_name() const { return m_name; }
+    const glm::vec4& get_base_color() const { return m_baseColor; }
+    float get_metalness() const { return m_metalness; }
+    float get_roughness() const { return m_roughness; }
+    const glm::vec3& get_emissive() const { return m_emissive; }
+    AlphaMode get_alpha_mode() const { return m_alphaMode; }
+    float get_alpha_cutoff() const { return m_alphaCutoff; }
+    bool is_double_sided() const { return m_doubleSided; }
+
+    // Only meaningful if the corresponding feature bit is set
+    const MaterialTexture& get_base_color_texture() const { return m_baseColorTexture; }
+    const MaterialTexture& get_metalness_roughness_texture() const
+    {
+        return m_metalnessRoughnessTexture;
+    }
+    const MaterialTexture& get_normal_texture() const { return m_normalTexture; }
+    const MaterialTexture& get_occlusion_texture() const { return m_occlusionTexture; }
+    const MaterialTexture& get_emissive_texture() const { return m_emissiveTexture; }
 
 private:
 
@@ -43,11 +112,7 @@ private:
     bool m_hasMetalnessTexture{};
     bool m_hasRoughnessTexture{};
 
-    enum class AlphaMode {
-        opaque,
-        mask,
-        blend,
-    } m_alphaMode{};
+    AlphaMode m_alphaMode{};
     float m_alphaCutoff{ 0.5f };  // Threshold for AlphaMode::mask
 
     bool m_doubleSided{};  // If true, back-face culling should be disabled
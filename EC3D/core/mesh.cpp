@@ -0,0 +1,45 @@
+#include "pch.hpp"
+#include "mesh.hpp"
+
+namespace ec
+{
+
+void BoundingBox::extend(const glm::vec3& point)
+{
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+}
+
+void BoundingBox::extend(const BoundingBox& box)
+{
+    if (box.is_valid()) {
+        extend(box.min);
+        extend(box.max);
+    }
+}
+
+BoundingBox BoundingBox::transformed(const glm::mat4& transform) const
+{
+    BoundingBox result{};
+    if (!is_valid()) {
+        return result;
+    }
+    for (uint32_t corner = 0; corner < 8; ++corner) {
+        glm::vec3 point{ corner & 1 ? max.x : min.x,
+                         corner & 2 ? max.y : min.y,
+                         corner & 4 ? max.z : min.z };
+        result.extend(glm::vec3{ transform * glm::vec4{ point, 1.f } });
+    }
+    return result;
+}
+
+Mesh::Mesh(const Mesh::Info& info) :
+  m_name{ info.name },
+  m_primitives{ info.primitives }
+{
+    for (const auto& primitive : m_primitives) {
+        m_bounds.extend(primitive.bounds);
+    }
+}
+
+}  // namespace ec
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <limits>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace ec
+{
+
+// Interleaved vertex shared by all meshes. Attributes missing in the source file are zero, except
+// the color, which is white
+struct Vertex {
+    glm::vec3 position{};
+    glm::vec3 normal{};
+    glm::vec4 tangent{};  // w is the handedness of the bitangent
+    glm::vec2 texCoord0{};
+    glm::vec2 texCoord1{};
+    glm::vec4 color{ 1.f };
+};
+
+struct BoundingBox {
+    glm::vec3 min{ std::numeric_limits<float>::max() };
+    glm::vec3 max{ std::numeric_limits<float>::lowest() };
+
+    bool is_valid() const { return min.x <= max.x; }
+    glm::vec3 get_center() const { return (min + max) * 0.5f; }
+    glm::vec3 get_size() const { return max - min; }
+
+    void extend(const glm::vec3& point);
+    void extend(const BoundingBox& box);
+    // Box containing this one after the transformation
+    BoundingBox transformed(const glm::mat4& transform) const;
+};
+
+// Range of the vertex and index streams of a Model, drawn with a single material. Always a
+// triangle list, indices are relative to vertexOffset
+struct Primitive {
+    uint32_t firstIndex{};
+    uint32_t indexCount{};
+    int32_t vertexOffset{};
+    uint32_t vertexCount{};
+    std::optional<uint32_t> materialIndex{};  // Default material if empty
+    BoundingBox bounds{};
+};
+
+class Mesh
+{
+public:
+
+    struct Info {
+        std::string name{};
+        std::vector<Primitive> primitives{};
+    };
+
+    Mesh() = default;
+    explicit Mesh(const Mesh::Info& info);
+
+    const std::string& get_name() const { return m_name; }
+    const std::vector<Primitive>& get_primitives() const { return m_primitives; }
+    const BoundingBox& get_bounds() const { return m_bounds; }
+
+private:
+
+    std::string m_name{};
+
+    std::vector<Primitive> m_primitives{};
+    BoundingBox m_bounds{};  // Of all the primitives
+};
+
+}  // namespace ec
@@ -0,0 +1,294 @@
+#include "pch.hpp"
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+namespace ec
+{
+
+// FIFO cache over vertex timestamps. A vertex is cached while fewer than cacheSize vertices were
+// added after it, so nothing has to be evicted explicitly
+class VertexCache
+{
+public:
+
+    VertexCache(uint32_t vertexCount, uint32_t cacheSize) :
+      m_timestamps(vertexCount),
+      m_cacheSize{ cacheSize },
+      m_time{ cacheSize + 1 }
+    {
+    }
+
+    // Returns whether the vertex was transformed
+    bool access(uint32_t vertex)
+    {
+        if (m_time - m_timestamps[vertex] <= m_cacheSize) {
+            return false;
+        }
+        m_timestamps[vertex] = m_time++;
+        return true;
+    }
+
+    // Empties the cache without touching the timestamps
+    void flush() { m_time += m_cacheSize + 1; }
+
+private:
+
+    std::vector<uint32_t> m_timestamps{};
+    uint32_t m_cacheSize{};
+    uint32_t m_time{};
+};
+
+float VertexCacheStats::get_acmr() const
+{
+    return triangles > 0 ? static_cast<float>(transformedVertices) / triangles : 0.f;
+}
+
+float VertexCacheStats::get_atvr() const
+{
+    return vertices > 0 ? static_cast<float>(transformedVertices) / vertices : 0.f;
+}
+
+VertexCacheStats& VertexCacheStats::operator+=(const VertexCacheStats& other)
+{
+    triangles += other.triangles;
+    vertices += other.vertices;
+    transformedVertices += other.transformedVertices;
+    return *this;
+}
+
+VertexCacheStats analyze_vertex_cache(std::span<const uint32_t> indices,
+                                      uint32_t vertexCount,
+                                      uint32_t cacheSize)
+{
+    VertexCacheStats stats{ .triangles = indices.size() / 3 };
+    VertexCache cache{ vertexCount, cacheSize };
+    std::vector<bool> used(vertexCount);
+    for (uint32_t index : indices) {
+        stats.transformedVertices += cache.access(index);
+        if (!used[index]) {
+            used[index] = true;
+            ++stats.vertices;
+        }
+    }
+    return stats;
+}
+
+std::vector<uint32_t> optimize_vertex_cache(std::span<uint32_t> indices,
+                                            uint32_t vertexCount,
+                                            uint32_t cacheSize)
+{
+    uint32_t triangleCount{ static_cast<uint32_t>(indices.size() / 3) };
+    if (triangleCount == 0) {
+        return {};
+    }
+
+    // Triangles of each vertex, as offsets into one array
+    std::vector<uint32_t> liveTriangles(vertexCount);
+    for (uint32_t index : indices) {
+        ++liveTriangles[index];
+    }
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+    std::inclusive_scan(liveTriangles.begin(), liveTriangles.end(), adjacencyOffsets.begin() + 1);
+    std::vector<uint32_t> adjacency(indices.size());
+    {
+        std::vector<uint32_t> filled(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (uint32_t i = 0; i < indices.size(); ++i) {
+            adjacency[filled[indices[i]]++] = i / 3;
+        }
+    }
+
+    std::vector<uint32_t> result{};
+    result.reserve(indices.size());
+    std::vector<uint32_t> clusters{ 0 };
+    std::vector<bool> emitted(triangleCount);
+    std::vector<uint32_t> timestamps(vertexCount);
+    std::vector<uint32_t> deadEnd{};  // Recently used vertices, to continue from when stuck
+    std::vector<uint32_t> candidates{};
+    uint32_t time{ cacheSize + 1 };
+    uint32_t cursor{ 0 };  // Vertices before it have no live triangles
+
+    // Fans around a vertex, then moves to the cached vertex that will stay cached the longest
+    std::optional<uint32_t> fanVertex{ indices[0] };
+    while (fanVertex) {
+        candidates.clear();
+        uint32_t vertex{ fanVertex.value() };
+        for (uint32_t a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; ++a) {
+            uint32_t triangle{ adjacency[a] };
+            if (emitted[triangle]) {
+                continue;
+            }
+            emitted[triangle] = true;
+            for (uint32_t corner = 0; corner < 3; ++corner) {
+                uint32_t v{ indices[triangle * 3 + corner] };
+                result.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                --liveTriangles[v];
+                if (time - timestamps[v] > cacheSize) {
+                    timestamps[v] = time++;
+                }
+            }
+        }
+
+        fanVertex.reset();
+        int64_t bestPriority{ -1 };
+        for (uint32_t v : candidates) {
+            if (liveTriangles[v] == 0) {
+                continue;
+            }
+            // Vertices that will be evicted before their fan is done are the last choice
+            int64_t priority{ 0 };
+            if (time - timestamps[v] + 2 * liveTriangles[v] <= cacheSize) {
+                priority = time - timestamps[v];
+            }
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                fanVertex    = v;
+            }
+        }
+        if (fanVertex) {
+            continue;
+        }
+
+        // Dead end, the cache will have to be refilled
+        while (!deadEnd.empty() && !fanVertex) {
+            uint32_t v{ deadEnd.back() };
+            deadEnd.pop_back();
+            if (liveTriangles[v] > 0) {
+                fanVertex = v;
+            }
+        }
+        while (!fanVertex && cursor < vertexCount) {
+            if (liveTriangles[cursor] > 0) {
+                fanVertex = cursor;
+            }
+            ++cursor;
+        }
+        if (fanVertex) {
+            clusters.push_back(static_cast<uint32_t>(result.size() / 3));
+        }
+    }
+
+    std::ranges::copy(result, indices.begin());
+    return clusters;
+}
+
+void optimize_overdraw(std::span<uint32_t> indices,
+                       std::span<const Vertex> vertices,
+                       const std::vector<uint32_t>& clusters,
+                       float threshold,
+                       uint32_t cacheSize)
+{
+    uint32_t triangleCount{ static_cast<uint32_t>(indices.size() / 3) };
+    if (triangleCount == 0 || clusters.empty()) {
+        return;
+    }
+
+    // Smaller clusters sort better, they are split where the cache is about as efficient as in
+    // the whole cluster
+    std::vector<uint32_t> splitClusters{};
+    VertexCache cache{ static_cast<uint32_t>(vertices.size()), cacheSize };
+    for (size_t c = 0; c < clusters.size(); ++c) {
+        uint32_t start{ clusters[c] };
+        uint32_t end{ c + 1 < clusters.size() ? clusters[c + 1] : triangleCount };
+        cache.flush();
+        uint32_t clusterMisses{};
+        for (uint32_t i = start * 3; i < end * 3; ++i) {
+            clusterMisses += cache.access(indices[i]);
+        }
+        float clusterThreshold{ threshold * clusterMisses / std::max(end - start, 1u) };
+
+        splitClusters.push_back(start);
+        cache.flush();
+        uint32_t misses{};
+        uint32_t splitStart{ start };
+        for (uint32_t triangle = start; triangle < end; ++triangle) {
+            for (uint32_t corner = 0; corner < 3; ++corner) {
+                misses += cache.access(indices[triangle * 3 + corner]);
+            }
+            uint32_t splitTriangles{ triangle - splitStart + 1 };
+            if (triangle + 1 < end
+                && static_cast<float>(misses) / splitTriangles <= clusterThreshold) {
+                splitClusters.push_back(triangle + 1);
+                splitStart = triangle + 1;
+                misses     = 0;
+                cache.flush();
+            }
+        }
+    }
+
+    // Sorted by how much they face away from the center of the mesh
+    glm::dvec3 meshCentroid{};
+    for (uint32_t index : indices) {
+        meshCentroid += glm::dvec3{ vertices[index].position };
+    }
+    meshCentroid /= static_cast<double>(indices.size());
+    std::vector<float> sortKeys(splitClusters.size());
+    for (size_t c = 0; c < splitClusters.size(); ++c) {
+        uint32_t start{ splitClusters[c] };
+        uint32_t end{ c + 1 < splitClusters.size() ? splitClusters[c + 1] : triangleCount };
+        glm::vec3 centroid{};
+        glm::vec3 normal{};  // Area weighted
+        for (uint32_t triangle = start; triangle < end; ++triangle) {
+            const glm::vec3& p0{ vertices[indices[triangle * 3]].position };
+            const glm::vec3& p1{ vertices[indices[triangle * 3 + 1]].position };
+            const glm::vec3& p2{ vertices[indices[triangle * 3 + 2]].position };
+            centroid += p0 + p1 + p2;
+            normal += glm::cross(p1 - p0, p2 - p0);
+        }
+        centroid /= static_cast<float>((end - start) * 3);
+        float normalLength{ glm::length(normal) };
+        sortKeys[c] = normalLength > 0.f ? glm::dot(centroid - glm::vec3{ meshCentroid },
+                                                    normal / normalLength)
+                                         : 0.f;
+    }
+    std::vector<uint32_t> order(splitClusters.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::ranges::stable_sort(order,
+                             [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+    std::vector<uint32_t> result{};
+    result.reserve(indices.size());
+    for (uint32_t c : order) {
+        uint32_t start{ splitClusters[c] };
+        uint32_t end{ c + 1 < splitClusters.size() ? splitClusters[c + 1] : triangleCount };
+        result.insert(result.end(), indices.begin() + start * 3, indices.begin() + end * 3);
+    }
+    std::ranges::copy(result, indices.begin());
+}
+
+void optimize_vertex_fetch(std::span<uint32_t> indices, std::span<Vertex> vertices)
+{
+    constexpr uint32_t unused{ std::numeric_limits<uint32_t>::max() };
+    std::vector<uint32_t> remap(vertices.size(), unused);
+    std::vector<Vertex> result{};
+    result.reserve(vertices.size());
+    for (uint32_t& index : indices) {
+        if (remap[index] == unused) {
+            remap[index] = static_cast<uint32_t>(result.size());
+            result.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        if (remap[i] == unused) {
+            result.push_back(vertices[i]);
+        }
+    }
+    std::ranges::copy(result, vertices.begin());
+}
+
+std::pair<VertexCacheStats, VertexCacheStats> optimize_mesh(std::span<uint32_t> indices,
+                                                            std::span<Vertex> vertices)
+{
+    auto vertexCount{ static_cast<uint32_t>(vertices.size()) };
+    VertexCacheStats before{ analyze_vertex_cache(indices, vertexCount) };
+    auto clusters{ optimize_vertex_cache(indices, vertexCount) };
+    optimize_overdraw(indices, vertices, clusters);
+    optimize_vertex_fetch(indices, vertices);
+    return { before, analyze_vertex_cache(indices, vertexCount) };
+}
+
+}  // namespace ec
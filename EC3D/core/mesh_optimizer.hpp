@@ -0,0 +1,56 @@
+#pragma once
+
+#include "mesh.hpp"
+
+#include <span>
+
+namespace ec
+{
+
+// Entries of the post-transform vertex cache assumed by the optimizer and the statistics, a FIFO
+// cache like the ones of most GPUs
+constexpr uint32_t VERTEX_CACHE_SIZE{ 16 };
+
+// Vertex shader invocations of a triangle list, simulated with a FIFO vertex cache
+struct VertexCacheStats {
+    uint64_t triangles{};
+    uint64_t vertices{};  // Referenced by the triangles
+    uint64_t transformedVertices{};
+
+    // Average cache miss ratio, transformed vertices per triangle. 0.5 at best, 3 at worst
+    float get_acmr() const;
+    // Average transformed to vertex ratio, transformed vertices per vertex. 1 at best
+    float get_atvr() const;
+
+    VertexCacheStats& operator+=(const VertexCacheStats& other);
+};
+
+VertexCacheStats analyze_vertex_cache(std::span<const uint32_t> indices,
+                                      uint32_t vertexCount,
+                                      uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+// Reorders the triangles for vertex cache hits with Tipsify (Sander et al. 2007). Returns the first
+// triangle of each cluster, where the cache had to be refilled, for optimize_overdraw
+std::vector<uint32_t> optimize_vertex_cache(std::span<uint32_t> indices,
+                                            uint32_t vertexCount,
+                                            uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+// Draws the clusters of optimize_vertex_cache facing outwards first, so they occlude the rest from
+// most points of view. Clusters are split further while their cache efficiency stays within
+// threshold of the whole cluster
+void optimize_overdraw(std::span<uint32_t> indices,
+                       std::span<const Vertex> vertices,
+                       const std::vector<uint32_t>& clusters,
+                       float threshold = 1.05f,
+                       uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+// Reorders the vertices by first use in the indices, which are remapped, so vertex fetches are
+// mostly sequential. Unused vertices are moved to the end
+void optimize_vertex_fetch(std::span<uint32_t> indices, std::span<Vertex> vertices);
+
+// All the passes above, in order. Indices are relative to the vertices. Returns the statistics
+// before and after
+std::pair<VertexCacheStats, VertexCacheStats> optimize_mesh(std::span<uint32_t> indices,
+                                                            std::span<Vertex> vertices);
+
+}  // namespace ec
@@ -0,0 +1,24 @@
+#include "pch.hpp"
+#include "model.hpp"
+
+namespace ec
+{
+
+BoundingBox Model::get_bounds() const
+{
+    BoundingBox bounds{};
+    if (defaultScene >= scenes.size()) {
+        return bounds;
+    }
+    scenes[defaultScene].traverse(
+        [&](const Entity& entity, const glm::mat4& transform)
+        {
+            if (entity.get_mesh_index()) {
+                bounds.extend(meshes.at(entity.get_mesh_index().value()).get_bounds().transformed(
+                    transform));
+            }
+        });
+    return bounds;
+}
+
+}  // namespace ec
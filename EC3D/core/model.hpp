@@ -0,0 +1,38 @@
+#pragma once
+
+#include "mesh.hpp"
+#include "material.hpp"
+#include "scene.hpp"
+
+#include <optional>
+
+namespace ec
+{
+
+// Decoded image of a model, always 8-bit RGBA unless read from a KTX2 file
+struct ModelImage {
+    std::string name{};
+    uint32_t width{};
+    uint32_t height{};
+    std::vector<uint8_t> pixels{};  // Empty if it could not be decoded or is in a KTX2 file
+    std::string ktx2Path{};         // KTX2 file loaded as is on upload, if set (see Ktx2Texture)
+};
+
+// CPU-side contents of a model file. All meshes share the vertex and index streams, so they can be
+// uploaded to one vertex and one index buffer
+struct Model {
+    std::vector<Vertex> vertices{};
+    std::vector<uint32_t> indices{};
+    std::vector<Mesh> meshes{};
+    std::vector<Material> materials{};
+    std::vector<ModelImage> images{};
+    // Image of each texture, MaterialTexture indices refer to textures
+    std::vector<std::optional<uint32_t>> textureImages{};
+    std::vector<Scene> scenes{};
+    uint32_t defaultScene{};
+
+    // Of the default scene, in scene space
+    BoundingBox get_bounds() const;
+};
+
+}  // namespace ec
@@ -1,4 +1,5 @@
 #include "pch.hpp"
+#include "object_loader.hpp"
 
 #define TINYGLTF_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
@@ -8,19 +9,501 @@
 #include <tiny_gltf.h>
 #pragma warning(pop)
 
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "misc/thread_pool.hpp"
+#include "mesh_optimizer.hpp"
+#include "ktx2_texture.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <tuple>
+
 namespace ec
 {
 
-using namespace tinygltf;
+// Reads the accessor into count * components values of T, including its sparse substitutions.
+// readComponent converts a single component from the accessor's component type
+template<typename T, typename ComponentReader>
+static std::vector<T> read_accessor(const tinygltf::Model& root,
+                                    const tinygltf::Accessor& accessor,
+                                    ComponentReader readComponent)
+{
+    int numComponents{ tinygltf::GetNumComponentsInType(static_cast<uint32_t>(accessor.type)) };
+    int componentSize{ tinygltf::GetComponentSizeInBytes(
+        static_cast<uint32_t>(accessor.componentType)) };
+    if (numComponents <= 0 || componentSize <= 0) {
+        throw std::runtime_error(std::format("Accessor {} has an invalid type", accessor.name));
+    }
+    size_t elementSize{ static_cast<size_t>(numComponents * componentSize) };
+
+    auto getData{ [&](int bufferViewIndex, size_t byteOffset, size_t stride, size_t count) {
+        const auto& view{ root.bufferViews.at(bufferViewIndex) };
+        const auto& buffer{ root.buffers.at(view.buffer) };
+        size_t start{ view.byteOffset + byteOffset };
+        if (count > 0 && start + (count - 1) * stride + elementSize > buffer.data.size()) {
+            throw std::runtime_error(
+                std::format("Accessor {} reads outside of its buffer", accessor.name));
+        }
+        return buffer.data.data() + start;
+    } };
+
+    // Without a buffer view, all values are zero (only sparse values are set)
+    std::vector<T> values(accessor.count * numComponents, T{});
+    if (accessor.bufferView >= 0) {
+        int stride{ accessor.ByteStride(root.bufferViews.at(accessor.bufferView)) };
+        if (stride < 0) {
+            throw std::runtime_error(
+                std::format("Accessor {} has an invalid stride", accessor.name));
+        }
+        const unsigned char* data{
+            getData(accessor.bufferView, accessor.byteOffset, stride, accessor.count)
+        };
+        for (size_t i = 0; i < accessor.count; ++i) {
+            for (int c = 0; c < numComponents; ++c) {
+                values[i * numComponents + c] = readComponent(data + i * stride + c * componentSize,
+                                                              accessor.componentType,
+                                                              accessor.normalized);
+            }
+        }
+    }
+
+    if (accessor.sparse.isSparse) {
+        const auto& sparse{ accessor.sparse };
+        size_t count{ static_cast<size_t>(sparse.count) };
+        int indexSize{ tinygltf::GetComponentSizeInBytes(
+            static_cast<uint32_t>(sparse.indices.componentType)) };
+        const unsigned char* indices{
+            getData(sparse.indices.bufferView, sparse.indices.byteOffset, indexSize, count)
+        };
+        const unsigned char* data{
+            getData(sparse.values.bufferView, sparse.values.byteOffset, elementSize, count)
+        };
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t index{};
+            std::memcpy(&index, indices + i * indexSize, indexSize);  // Little endian
+            if (index >= accessor.count) {
+                throw std::runtime_error(
+                    std::format("Sparse accessor {} has an index out of range", accessor.name));
+            }
+            const unsigned char* element{ data + i * elementSize };
+            for (int c = 0; c < numComponents; ++c) {
+                values[index * numComponents + c] = readComponent(element + c * componentSize,
+                                                                  accessor.componentType,
+                                                                  accessor.normalized);
+            }
+        }
+    }
+
+    return values;
+}
+
+template<typename T>
+static T read_unaligned(const unsigned char* src)
+{
+    T value{};
+    std::memcpy(&value, src, sizeof(T));
+    return value;
+}
+
+// Integer components are converted to float as is, or mapped to [0, 1] / [-1, 1] if normalized
+static float read_float_component(const unsigned char* src, int componentType, bool normalized)
+{
+    switch (componentType) {
+        case TINYGLTF_COMPONENT_TYPE_BYTE: {
+            float value{ static_cast<float>(read_unaligned<int8_t>(src)) };
+            return normalized ? std::max(value / 127.f, -1.f) : value;
+        }
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
+            float value{ static_cast<float>(read_unaligned<uint8_t>(src)) };
+            return normalized ? value / 255.f : value;
+        }
+        case TINYGLTF_COMPONENT_TYPE_SHORT: {
+            float value{ static_cast<float>(read_unaligned<int16_t>(src)) };
+            return normalized ? std::max(value / 32767.f, -1.f) : value;
+        }
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+            float value{ static_cast<float>(read_unaligned<uint16_t>(src)) };
+            return normalized ? value / 65535.f : value;
+        }
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+            return static_cast<float>(read_unaligned<uint32_t>(src));
+        case TINYGLTF_COMPONENT_TYPE_FLOAT:
+            return read_unaligned<float>(src);
+        default:
+            throw std::runtime_error(std::format("Unsupported component type {}", componentType));
+    }
+}
+
+static uint32_t read_index_component(const unsigned char* src, int componentType, bool)
+{
+    switch (componentType) {
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+            return read_unaligned<uint8_t>(src);
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+            return read_unaligned<uint16_t>(src);
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+            return read_unaligned<uint32_t>(src);
+        default:
+            throw std::runtime_error(std::format("Unsupported index type {}", componentType));
+    }
+}
+
+// Attribute of the primitive as floats, empty if it does not have it
+static std::vector<float> read_attribute(const tinygltf::Model& root,
+                                         const tinygltf::Primitive& primitive,
+                                         const std::string& name,
+                                         int& numComponents)
+{
+    auto it{ primitive.attributes.find(name) };
+    if (it == primitive.attributes.end()) {
+        return {};
+    }
+    const auto& accessor{ root.accessors.at(it->second) };
+    numComponents = tinygltf::GetNumComponentsInType(static_cast<uint32_t>(accessor.type));
+    return read_accessor<float>(root, accessor, read_float_component);
+}
+
+// Strips and fans are converted to lists, so every primitive can be drawn with the same pipeline
+static std::vector<uint32_t> to_triangle_list(const std::vector<uint32_t>& indices, int mode)
+{
+    if (mode == TINYGLTF_MODE_TRIANGLES || indices.size() < 3) {
+        return indices;
+    }
+    std::vector<uint32_t> list{};
+    list.reserve((indices.size() - 2) * 3);
+    for (size_t i = 0; i + 2 < indices.size(); ++i) {
+        if (mode == TINYGLTF_MODE_TRIANGLE_FAN) {
+            list.insert(list.end(), { indices[0], indices[i + 1], indices[i + 2] });
+        } else if (i % 2 == 0) {
+            list.insert(list.end(), { indices[i], indices[i + 1], indices[i + 2] });
+        } else {
+            // Keeps the winding order of the strip
+            list.insert(list.end(), { indices[i + 1], indices[i], indices[i + 2] });
+        }
+    }
+    return list;
+}
+
+// glTF requires flat normals when they are missing, so vertices are no longer shared
+static void compute_flat_normals(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+    std::vector<Vertex> unwelded(indices.size());
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        for (size_t j = 0; j < 3; ++j) {
+            unwelded[i + j] = vertices.at(indices[i + j]);
+        }
+        glm::vec3 normal{ glm::cross(unwelded[i + 1].position - unwelded[i].position,
+                                     unwelded[i + 2].position - unwelded[i].position) };
+        float length{ glm::length(normal) };
+        normal = length > 0.f ? normal / length : glm::vec3{ 0.f, 0.f, 1.f };
+        for (size_t j = 0; j < 3; ++j) {
+            unwelded[i + j].normal = normal;
+        }
+    }
+    vertices = std::move(unwelded);
+    for (uint32_t i = 0; i < indices.size(); ++i) {
+        indices[i] = i;
+    }
+}
+
+// Vertices and triangle list indices of a primitive, before they are added to the model streams
+struct PrimitiveData {
+    std::vector<Vertex> vertices{};
+    std::vector<uint32_t> indices{};
+    BoundingBox bounds{};
+    VertexCacheStats statsBefore{};  // Before and after optimize_mesh, the same if not optimized
+    VertexCacheStats statsAfter{};
+};
+
+// Per-vertex tangents from the texture coordinate gradients of the adjacent triangles,
+// orthogonalized against the normal
+static void compute_tangents(std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+{
+    std::vector<glm::vec3> tangents(vertices.size());
+    std::vector<glm::vec3> bitangents(vertices.size());
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        const Vertex& v0{ vertices[indices[i]] };
+        const Vertex& v1{ vertices[indices[i + 1]] };
+        const Vertex& v2{ vertices[indices[i + 2]] };
+        glm::vec3 edge1{ v1.position - v0.position };
+        glm::vec3 edge2{ v2.position - v0.position };
+        glm::vec2 deltaUv1{ v1.texCoord0 - v0.texCoord0 };
+        glm::vec2 deltaUv2{ v2.texCoord0 - v0.texCoord0 };
+        float determinant{ deltaUv1.x * deltaUv2.y - deltaUv2.x * deltaUv1.y };
+        if (std::abs(determinant) < 1e-12f) {
+            continue;  // Degenerate mapping, the other triangles decide
+        }
+        glm::vec3 tangent{ (edge1 * deltaUv2.y - edge2 * deltaUv1.y) / determinant };
+        glm::vec3 bitangent{ (edge2 * deltaUv1.x - edge1 * deltaUv2.x) / determinant };
+        for (size_t j = 0; j < 3; ++j) {
+            tangents[indices[i + j]] += tangent;
+            bitangents[indices[i + j]] += bitangent;
+        }
+    }
+
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        const glm::vec3& normal{ vertices[i].normal };
+        glm::vec3 tangent{ tangents[i] - normal * glm::dot(normal, tangents[i]) };
+        if (glm::dot(tangent, tangent) < 1e-12f) {
+            // No usable texture mapping, any direction perpendicular to the normal
+            glm::vec3 axis{ std::abs(normal.x) > 0.9f ? glm::vec3{ 0.f, 1.f, 0.f }
+                                                      : glm::vec3{ 1.f, 0.f, 0.f } };
+            tangent = axis - normal * glm::dot(normal, axis);
+        }
+        float handedness{ glm::dot(glm::cross(normal, tangent), bitangents[i]) < 0.f ? -1.f : 1.f };
+        vertices[i].tangent = glm::vec4{ glm::normalize(tangent), handedness };
+    }
+}
 
-std::vector<Scene> load_gltf_file(std::string_view filePath)
+// Converts the primitive to a triangle list, empty if it can't be drawn as triangles. Tangents
+// are generated if missing and needsTangents is set. Only reads root, so primitives can be
+// converted concurrently
+static std::optional<PrimitiveData> convert_primitive(const tinygltf::Model& root,
+                                                      const tinygltf::Primitive& gltfPrimitive,
+                                                      bool needsTangents,
+                                                      bool optimize)
+{
+    if (gltfPrimitive.mode != TINYGLTF_MODE_TRIANGLES
+        && gltfPrimitive.mode != TINYGLTF_MODE_TRIANGLE_STRIP
+        && gltfPrimitive.mode != TINYGLTF_MODE_TRIANGLE_FAN) {
+        EC_LOG_WARN("Skipping glTF primitive with mode {}, only triangles are supported",
+                    gltfPrimitive.mode);
+        return std::nullopt;
+    }
+
+    int numComponents{};
+    auto positions{ read_attribute(root, gltfPrimitive, "POSITION", numComponents) };
+    if (positions.empty() || numComponents != 3) {
+        EC_LOG_WARN("Skipping glTF primitive without positions");
+        return std::nullopt;
+    }
+    size_t vertexCount{ positions.size() / 3 };
+    std::vector<Vertex> vertices(vertexCount);
+    for (size_t i = 0; i < vertexCount; ++i) {
+        vertices[i].position = glm::make_vec3(&positions[i * 3]);
+    }
+
+    // Attributes with an unexpected number of components are ignored
+    auto normals{ read_attribute(root, gltfPrimitive, "NORMAL", numComponents) };
+    bool hasNormals{ !normals.empty() && numComponents == 3 && normals.size() == vertexCount * 3 };
+    for (size_t i = 0; hasNormals && i < vertexCount; ++i) {
+        vertices[i].normal = glm::make_vec3(&normals[i * 3]);
+    }
+    auto tangents{ read_attribute(root, gltfPrimitive, "TANGENT", numComponents) };
+    bool hasTangents{ numComponents == 4 && tangents.size() == vertexCount * 4 };
+    if (hasTangents) {
+        for (size_t i = 0; i < vertexCount; ++i) {
+            vertices[i].tangent = glm::make_vec4(&tangents[i * 4]);
+        }
+    }
+    auto texCoords0{ read_attribute(root, gltfPrimitive, "TEXCOORD_0", numComponents) };
+    bool hasTexCoords{ numComponents == 2 && texCoords0.size() == vertexCount * 2 };
+    if (hasTexCoords) {
+        for (size_t i = 0; i < vertexCount; ++i) {
+            vertices[i].texCoord0 = glm::make_vec2(&texCoords0[i * 2]);
+        }
+    }
+    auto texCoords1{ read_attribute(root, gltfPrimitive, "TEXCOORD_1", numComponents) };
+    if (numComponents == 2 && texCoords1.size() == vertexCount * 2) {
+        for (size_t i = 0; i < vertexCount; ++i) {
+            vertices[i].texCoord1 = glm::make_vec2(&texCoords1[i * 2]);
+        }
+    }
+    auto colors{ read_attribute(root, gltfPrimitive, "COLOR_0", numComponents) };
+    bool validColors{ numComponents == 3 || numComponents == 4 };
+    if (validColors && colors.size() == vertexCount * numComponents) {
+        for (size_t i = 0; i < vertexCount; ++i) {
+            const float* color{ &colors[i * numComponents] };
+            float alpha{ numComponents == 4 ? color[3] : 1.f };
+            vertices[i].color = { color[0], color[1], color[2], alpha };
+        }
+    }
+
+    std::vector<uint32_t> indices{};
+    if (gltfPrimitive.indices >= 0) {
+        indices = read_accessor<uint32_t>(root,
+                                          root.accessors.at(gltfPrimitive.indices),
+                                          read_index_component);
+    } else {
+        indices.resize(vertexCount);
+        for (uint32_t i = 0; i < indices.size(); ++i) {
+            indices[i] = i;
+        }
+    }
+    indices = to_triangle_list(indices, gltfPrimitive.mode);
+    indices.resize(indices.size() - indices.size() % 3);
+    if (std::ranges::any_of(indices, [&](uint32_t index) { return index >= vertexCount; })) {
+        throw std::runtime_error("glTF primitive has an index out of range");
+    }
+    if (!hasNormals) {
+        compute_flat_normals(vertices, indices);
+    }
+    if (!hasTangents && needsTangents && hasTexCoords) {
+        compute_tangents(vertices, indices);
+    }
+
+    PrimitiveData data{ .vertices = std::move(vertices), .indices = std::move(indices) };
+    for (const auto& vertex : data.vertices) {
+        data.bounds.extend(vertex.position);
+    }
+    if (optimize) {
+        std::tie(data.statsBefore, data.statsAfter) = optimize_mesh(data.indices, data.vertices);
+    } else {
+        data.statsBefore = analyze_vertex_cache(data.indices,
+                                                static_cast<uint32_t>(data.vertices.size()));
+        data.statsAfter  = data.statsBefore;
+    }
+    return data;
+}
+
+static std::optional<MaterialTexture> load_texture_info(int textureIndex, int texCoord)
+{
+    if (textureIndex < 0) {
+        return std::nullopt;
+    }
+    return MaterialTexture{ static_cast<uint32_t>(textureIndex), static_cast<uint32_t>(texCoord) };
+}
+
+static Material load_material(const tinygltf::Material& gltfMaterial)
+{
+    const auto& pbr{ gltfMaterial.pbrMetallicRoughness };
+    Material::AlphaMode alphaMode{ Material::AlphaMode::opaque };
+    if (gltfMaterial.alphaMode == "MASK") {
+        alphaMode = Material::AlphaMode::mask;
+    } else if (gltfMaterial.alphaMode == "BLEND") {
+        alphaMode = Material::AlphaMode::blend;
+    }
+
+    Material::Info materialInfo{
+        .name                      = gltfMaterial.name,
+        .baseColor                 = glm::vec4{ glm::make_vec4(pbr.baseColorFactor.data()) },
+        .metalness                 = static_cast<float>(pbr.metallicFactor),
+        .roughness                 = static_cast<float>(pbr.roughnessFactor),
+        .baseColorTexture          = load_texture_info(pbr.baseColorTexture.index,
+                                                       pbr.baseColorTexture.texCoord),
+        .metalnessRoughnessTexture = load_texture_info(pbr.metallicRoughnessTexture.index,
+                                                       pbr.metallicRoughnessTexture.texCoord),
+        .alphaMode                 = alphaMode,
+        .alphaCutoff               = static_cast<float>(gltfMaterial.alphaCutoff),
+        .doubleSided               = gltfMaterial.doubleSided,
+        .emissive          = glm::vec3{ glm::make_vec3(gltfMaterial.emissiveFactor.data()) },
+        .normalScale       = static_cast<float>(gltfMaterial.normalTexture.scale),
+        .occlusionStrength = static_cast<float>(gltfMaterial.occlusionTexture.strength),
+        .emissiveTexture   = load_texture_info(gltfMaterial.emissiveTexture.index,
+                                               gltfMaterial.emissiveTexture.texCoord),
+        .normalTexture     = load_texture_info(gltfMaterial.normalTexture.index,
+                                               gltfMaterial.normalTexture.texCoord),
+        .occlusionTexture  = load_texture_info(gltfMaterial.occlusionTexture.index,
+                                               gltfMaterial.occlusionTexture.texCoord),
+    };
+    return Material{ materialInfo };
+}
+
+static glm::mat4 node_transform(const tinygltf::Node& node)
+{
+    if (node.matrix.size() == 16) {
+        return glm::mat4{ glm::make_mat4(node.matrix.data()) };  // Column-major, like glm
+    }
+    glm::mat4 transform{ 1.f };
+    if (node.translation.size() == 3) {
+        transform = glm::translate(transform, glm::vec3{ glm::make_vec3(node.translation.data()) });
+    }
+    if (node.rotation.size() == 4) {
+        // glTF quaternions are stored as (x, y, z, w)
+        glm::quat rotation{ static_cast<float>(node.rotation[3]),
+                            static_cast<float>(node.rotation[0]),
+                            static_cast<float>(node.rotation[1]),
+                            static_cast<float>(node.rotation[2]) };
+        transform *= glm::mat4_cast(rotation);
+    }
+    if (node.scale.size() == 3) {
+        transform = glm::scale(transform, glm::vec3{ glm::make_vec3(node.scale.data()) });
+    }
+    return transform;
+}
+
+static Entity load_node(const tinygltf::Model& root, int nodeIndex, size_t depth)
+{
+    // Nodes must form a forest, a deeper hierarchy can only come from a cycle
+    if (depth > root.nodes.size()) {
+        throw std::runtime_error("glTF node hierarchy has a cycle");
+    }
+    const auto& node{ root.nodes.at(nodeIndex) };
+    Entity entity{ Entity::Info{
+        .name      = node.name,
+        .transform = node_transform(node),
+        .meshIndex = node.mesh >= 0 ? std::optional{ static_cast<uint32_t>(node.mesh) }
+                                    : std::nullopt,
+    } };
+    for (int child : node.children) {
+        entity.add_child(load_node(root, child, depth + 1));
+    }
+    return entity;
+}
+
+// Keeps the encoded bytes of every image, so they can be decoded in parallel after parsing
+static bool store_encoded_image(tinygltf::Image*,
+                                const int imageIndex,
+                                std::string*,
+                                std::string*,
+                                int,
+                                int,
+                                const unsigned char* bytes,
+                                int size,
+                                void* userData)
+{
+    auto& encodedImages{ *static_cast<std::vector<std::vector<unsigned char>>*>(userData) };
+    if (imageIndex < 0) {
+        return false;
+    }
+    if (encodedImages.size() <= static_cast<size_t>(imageIndex)) {
+        encodedImages.resize(imageIndex + 1);
+    }
+    encodedImages[imageIndex].assign(bytes, bytes + size);
+    return true;
+}
+
+static ModelImage decode_image(const std::string& name, const std::vector<unsigned char>& encoded)
+{
+    ModelImage image{ .name = name };
+    int width{}, height{}, components{};
+    stbi_uc* pixels{ stbi_load_from_memory(encoded.data(),
+                                           static_cast<int>(encoded.size()),
+                                           &width,
+                                           &height,
+                                           &components,
+                                           STBI_rgb_alpha) };
+    if (!pixels) {
+        EC_LOG_WARN("Failed to decode glTF image {}: {}", name, stbi_failure_reason());
+        return image;
+    }
+    image.width  = static_cast<uint32_t>(width);
+    image.height = static_cast<uint32_t>(height);
+    image.pixels.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+    stbi_image_free(pixels);
+    return image;
+}
+
+Model load_gltf_file(std::string_view filePath, const GltfLoadInfo& info)
 {
     std::filesystem::path path(filePath);
     auto extension{ path.extension().string() };
 
-    Model root{};
-    TinyGLTF loader{};
+    tinygltf::Model root{};
+    tinygltf::TinyGLTF loader{};
     std::string error{}, warning{};
+    // Images are only read while parsing, decoding them is left to the thread pool
+    std::vector<std::vector<unsigned char>> encodedImages{};
+    loader.SetImageLoader(store_encoded_image, &encodedImages);
 
     bool ret{};
     if (extension == ".gltf") {
@@ -38,9 +521,219 @@ std::vector<Scene> load_gltf_file(std::string_view filePath)
         throw std::runtime_error(
             std::format("Failed to load glTF file. Error: {}\n", error.c_str()));
     }
+    encodedImages.resize(root.images.size());
+
+    // Images and primitives finished by the workers, images in completion order. Declared before
+    // the pool, which runs the queued tasks to completion when destroyed
+    std::mutex completionMutex{};
+    std::condition_variable completionCondition{};
+    std::deque<uint32_t> decodedImages{};
+    std::vector<std::vector<bool>> convertedPrimitives(root.meshes.size());
+
+    ThreadPool threadPool{ info.numThreads };
+
+    // Images are submitted first, decoding them usually takes the longest
+    std::vector<std::future<ModelImage>> imageFutures(root.images.size());
+    for (uint32_t i = 0; i < imageFutures.size(); ++i) {
+        imageFutures[i] = threadPool.submit(
+            [&, i]()
+            {
+                ModelImage image{};
+                const auto& uri{ root.images[i].uri };
+                if (std::filesystem::path{ uri }.extension() == Ktx2Texture::FILE_EXTENSION) {
+                    // Kept compressed, loaded by the renderer from the file
+                    image = { .name     = root.images[i].name,
+                              .ktx2Path = (path.parent_path() / uri).string() };
+                } else {
+                    try {
+                        image = decode_image(root.images[i].name, encodedImages[i]);
+                    }
+                    catch (const std::exception& e) {
+                        EC_LOG_WARN("Failed to decode glTF image {}: {}", i, e.what());
+                    }
+                }
+                encodedImages[i] = {};  // Only this task accesses it
+                {
+                    std::scoped_lock lock{ completionMutex };
+                    decodedImages.push_back(i);
+                }
+                completionCondition.notify_one();
+                return image;
+            });
+    }
+
+    std::vector<std::vector<std::future<std::optional<PrimitiveData>>>> primitiveFutures(
+        root.meshes.size());
+    for (size_t i = 0; i < root.meshes.size(); ++i) {
+        convertedPrimitives[i].resize(root.meshes[i].primitives.size());
+        for (size_t j = 0; j < root.meshes[i].primitives.size(); ++j) {
+            const auto& gltfPrimitive{ root.meshes[i].primitives[j] };
+            // Tangents are only generated when a normal map needs them
+            bool needsTangents{ gltfPrimitive.material >= 0
+                                && root.materials.at(gltfPrimitive.material).normalTexture.index
+                                       >= 0 };
+            primitiveFutures[i].push_back(threadPool.submit(
+                [&, i, j, needsTangents]()
+                {
+                    // Marked as converted even if it throws, the exception is kept in the future
+                    std::optional<PrimitiveData> data{};
+                    std::exception_ptr exception{};
+                    try {
+                        data = convert_primitive(root,
+                                                 root.meshes[i].primitives[j],
+                                                 needsTangents,
+                                                 info.optimizeMeshes);
+                    }
+                    catch (...) {
+                        exception = std::current_exception();
+                    }
+                    {
+                        std::scoped_lock lock{ completionMutex };
+                        convertedPrimitives[i][j] = true;
+                    }
+                    completionCondition.notify_one();
+                    if (exception) {
+                        std::rethrow_exception(exception);
+                    }
+                    return data;
+                }));
+        }
+    }
+
+    Model model{};
+
+    model.materials.reserve(root.materials.size());
+    for (const auto& gltfMaterial : root.materials) {
+        model.materials.push_back(load_material(gltfMaterial));
+    }
+    for (const auto& texture : root.textures) {
+        // KTX2 images are the source of KHR_texture_basisu, which may leave the core one unset
+        int source{ texture.source };
+        if (auto basisu{ texture.extensions.find("KHR_texture_basisu") };
+            source < 0 && basisu != texture.extensions.end() && basisu->second.Has("source")) {
+            source = basisu->second.Get("source").GetNumberAsInt();
+        }
+        model.textureImages.push_back(source >= 0 ? std::optional{ static_cast<uint32_t>(source) }
+                                                  : std::nullopt);
+    }
+
+    // Images are handed over as they are decoded, also while waiting for primitives below
+    model.images.resize(root.images.size());
+    size_t numHandedOver{};
+    auto hand_over_images{ [&](std::unique_lock<std::mutex>& lock)
+                           {
+                               while (!decodedImages.empty()) {
+                                   uint32_t imageIndex{ decodedImages.front() };
+                                   decodedImages.pop_front();
+                                   lock.unlock();
+                                   model.images[imageIndex] = imageFutures[imageIndex].get();
+                                   if (info.onImageLoaded) {
+                                       info.onImageLoaded(model, imageIndex);
+                                   }
+                                   ++numHandedOver;
+                                   lock.lock();
+                               }
+                           } };
+
+    // Mesh i of the model is mesh i of the file, so node mesh indices can be kept. Primitives are
+    // appended in file order as they complete, so the streams don't depend on scheduling
+    model.meshes.reserve(root.meshes.size());
+    VertexCacheStats statsBefore{};
+    VertexCacheStats statsAfter{};
+    for (size_t i = 0; i < root.meshes.size(); ++i) {
+        Mesh::Info meshInfo{ .name = root.meshes[i].name };
+        for (size_t j = 0; j < primitiveFutures[i].size(); ++j) {
+            {
+                std::unique_lock lock{ completionMutex };
+                while (true) {
+                    hand_over_images(lock);
+                    if (convertedPrimitives[i][j]) {
+                        break;
+                    }
+                    completionCondition.wait(lock);
+                }
+            }
+            auto data{ primitiveFutures[i][j].get() };
+            if (!data) {
+                continue;
+            }
+            int material{ root.meshes[i].primitives[j].material };
+            meshInfo.primitives.push_back({
+                .firstIndex    = static_cast<uint32_t>(model.indices.size()),
+                .indexCount    = static_cast<uint32_t>(data->indices.size()),
+                .vertexOffset  = static_cast<int32_t>(model.vertices.size()),
+                .vertexCount   = static_cast<uint32_t>(data->vertices.size()),
+                .materialIndex = material >= 0 ? std::optional{ static_cast<uint32_t>(material) }
+                                               : std::nullopt,
+                .bounds        = data->bounds,
+            });
+            model.vertices.insert(model.vertices.end(),
+                                  data->vertices.begin(),
+                                  data->vertices.end());
+            model.indices.insert(model.indices.end(), data->indices.begin(), data->indices.end());
+            statsBefore += data->statsBefore;
+            statsAfter += data->statsAfter;
+        }
+        model.meshes.emplace_back(meshInfo);
+    }
+
+    if (root.scenes.empty()) {
+        // Nodes that are not the child of any other are the roots of the only scene
+        std::vector<bool> isChild(root.nodes.size());
+        for (const auto& node : root.nodes) {
+            for (int child : node.children) {
+                isChild.at(child) = true;
+            }
+        }
+        Scene scene{ path.stem().string() };
+        for (size_t i = 0; i < root.nodes.size(); ++i) {
+            if (!isChild[i]) {
+                scene.add_entity(load_node(root, static_cast<int>(i), 0));
+            }
+        }
+        model.scenes.push_back(std::move(scene));
+    } else {
+        for (const auto& gltfScene : root.scenes) {
+            Scene scene{ gltfScene.name };
+            for (int node : gltfScene.nodes) {
+                scene.add_entity(load_node(root, node, 0));
+            }
+            model.scenes.push_back(std::move(scene));
+        }
+    }
+    model.defaultScene = root.defaultScene >= 0 ? static_cast<uint32_t>(root.defaultScene) : 0;
+
+    // The images still being decoded once all the primitives are in
+    {
+        std::unique_lock lock{ completionMutex };
+        while (true) {
+            hand_over_images(lock);
+            if (numHandedOver == imageFutures.size()) {
+                break;
+            }
+            completionCondition.wait(lock);
+        }
+    }
 
-    std::vector<Scene> scenes(root.scenes.size());
+    EC_LOG_INFO("Loaded {} with {} threads: {} meshes, {} materials, {} images, {} vertices, {} "
+                "indices",
+                filePath,
+                threadPool.get_num_threads(),
+                model.meshes.size(),
+                model.materials.size(),
+                model.images.size(),
+                model.vertices.size(),
+                model.indices.size());
+    EC_LOG_INFO("Vertex cache of {} ({} entries){}: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}",
+                filePath,
+                VERTEX_CACHE_SIZE,
+                info.optimizeMeshes ? "" : " (not optimized)",
+                statsBefore.get_acmr(),
+                statsAfter.get_acmr(),
+                statsBefore.get_atvr(),
+                statsAfter.get_atvr());
 
+    return model;
 }
 
-}  // namespace ec
\ No newline at end of file
+}  // namespace ec
@@ -1,13 +1,27 @@
 #pragma once
 
-#include "scene.hpp"
-#include "entity.hpp"
+#include "model.hpp"
+
+#include <functional>
 
 namespace ec
 {
 
-// Data that can be read from a glTF file
+struct GltfLoadInfo {
+    // Primitives are converted and images decoded by this many worker threads, 0 for one per
+    // hardware thread
+    uint32_t numThreads{};
+    // Called on the loading thread for every image as soon as it is decoded, in completion order
+    // and while the primitives are still being converted. The materials and textures of model
+    // are already loaded, its meshes may not be
+    std::function<void(const Model& model, uint32_t imageIndex)> onImageLoaded{};
+    // Reorders the triangles and vertices of each primitive for the vertex cache, overdraw and
+    // vertex fetch (see optimize_mesh)
+    bool optimizeMeshes{ true };
+};
 
-std::vector<Scene> load_gltf_file(std::string_view filePath);
+// Data that can be read from a glTF file. The JSON is parsed once, then the conversion of each
+// primitive and the decoding of each image run in parallel. Throws if the file can't be loaded
+Model load_gltf_file(std::string_view filePath, const GltfLoadInfo& info = {});
 
-}  // namespace ec
\ No newline at end of file
+}  // namespace ec
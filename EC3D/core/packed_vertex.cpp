@@ -0,0 +1,79 @@
+#include "pch.hpp"
+#include "packed_vertex.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+
+namespace ec
+{
+
+// Center and half size of bounds, the scale is never 0 so flat primitives can be packed too
+static std::pair<glm::vec3, glm::vec3> quantization_range(const BoundingBox& bounds)
+{
+    if (!bounds.is_valid()) {
+        return { glm::vec3{}, glm::vec3{ 1.f } };
+    }
+    return { bounds.get_center(),
+             glm::max(bounds.get_size() * 0.5f, glm::vec3{ std::numeric_limits<float>::min() }) };
+}
+
+glm::vec2 encode_octahedral(const glm::vec3& direction)
+{
+    float norm{ std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z) };
+    if (norm == 0.f) {
+        return {};  // Unused tangents are zero
+    }
+    glm::vec3 octahedron{ direction / norm };
+    glm::vec2 encoded{ octahedron.x, octahedron.y };
+    if (octahedron.z < 0.f) {
+        // The lower half is folded over the diagonals
+        glm::vec2 sign{ encoded.x >= 0.f ? 1.f : -1.f, encoded.y >= 0.f ? 1.f : -1.f };
+        encoded = (1.f - glm::abs(glm::vec2{ encoded.y, encoded.x })) * sign;
+    }
+    return encoded;
+}
+
+PackedVertex pack_vertex(const Vertex& vertex, const BoundingBox& bounds)
+{
+    auto snorm{ [](float value) { return static_cast<int16_t>(glm::packSnorm1x16(value)); } };
+    auto [center, scale]{ quantization_range(bounds) };
+    glm::vec3 position{ (vertex.position - center) / scale };
+    glm::vec2 normal{ encode_octahedral(vertex.normal) };
+    glm::vec2 tangent{ encode_octahedral(glm::vec3{ vertex.tangent }) };
+    glm::vec4 color{ glm::clamp(vertex.color, 0.f, 1.f) };
+    return {
+        .position  = { snorm(position.x), snorm(position.y), snorm(position.z),
+                       snorm(vertex.tangent.w < 0.f ? -1.f : 1.f) },
+        .normal    = { snorm(normal.x), snorm(normal.y) },
+        .tangent   = { snorm(tangent.x), snorm(tangent.y) },
+        .texCoord0 = { glm::packHalf1x16(vertex.texCoord0.x),
+                       glm::packHalf1x16(vertex.texCoord0.y) },
+        .texCoord1 = { glm::packHalf1x16(vertex.texCoord1.x),
+                       glm::packHalf1x16(vertex.texCoord1.y) },
+        .color     = { glm::packUnorm1x8(color.r), glm::packUnorm1x8(color.g),
+                       glm::packUnorm1x8(color.b), glm::packUnorm1x8(color.a) },
+    };
+}
+
+std::vector<PackedVertex> pack_vertices(std::span<const Vertex> vertices,
+                                        std::span<const Mesh> meshes)
+{
+    std::vector<PackedVertex> packed(vertices.size());
+    for (const auto& mesh : meshes) {
+        for (const auto& primitive : mesh.get_primitives()) {
+            for (uint32_t i = 0; i < primitive.vertexCount; ++i) {
+                size_t vertex{ static_cast<size_t>(primitive.vertexOffset) + i };
+                packed.at(vertex) = pack_vertex(vertices[vertex], primitive.bounds);
+            }
+        }
+    }
+    return packed;
+}
+
+glm::mat4 get_dequantization_matrix(const BoundingBox& bounds)
+{
+    auto [center, scale]{ quantization_range(bounds) };
+    return glm::scale(glm::translate(glm::mat4{ 1.f }, center), scale);
+}
+
+}  // namespace ec
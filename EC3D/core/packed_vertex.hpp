@@ -0,0 +1,44 @@
+#pragma once
+
+#include "backend/vertex_layout.hpp"
+#include "mesh.hpp"
+
+#include <span>
+
+namespace ec
+{
+
+// Vertex as read by the model shaders, 28 bytes instead of the 72 of Vertex. Positions are
+// quantized to the bounds of their primitive and directions are octahedral encoded
+struct PackedVertex {
+    vulkan::Snorm16x4 position{};  // w is the handedness of the bitangent
+    vulkan::Snorm16x2 normal{};
+    vulkan::Snorm16x2 tangent{};
+    vulkan::Half2 texCoord0{};
+    vulkan::Half2 texCoord1{};
+    vulkan::Unorm8x4 color{};
+};
+
+using PackedVertexLayout = vulkan::VertexLayout<PackedVertex,
+                                                &PackedVertex::position,
+                                                &PackedVertex::normal,
+                                                &PackedVertex::tangent,
+                                                &PackedVertex::texCoord0,
+                                                &PackedVertex::texCoord1,
+                                                &PackedVertex::color>;
+
+// Unit direction mapped to the [-1, 1] square by projecting it on an octahedron
+glm::vec2 encode_octahedral(const glm::vec3& direction);
+
+// Positions are stored relative to bounds, in [-1, 1]
+PackedVertex pack_vertex(const Vertex& vertex, const BoundingBox& bounds);
+
+// The vertices of each primitive packed with its bounds, in the same order
+std::vector<PackedVertex> pack_vertices(std::span<const Vertex> vertices,
+                                        std::span<const Mesh> meshes);
+
+// Maps positions packed with bounds back to the space of their primitive, to be applied before the
+// model transform
+glm::mat4 get_dequantization_matrix(const BoundingBox& bounds);
+
+}  // namespace ec
@@ -4,4 +4,22 @@
 namespace ec
 {
 
+static void traverse_entity(const Entity& entity,
+                            const glm::mat4& parentTransform,
+                            const Scene::EntityVisitor& visitor)
+{
+    glm::mat4 transform{ parentTransform * entity.get_transform() };
+    visitor(entity, transform);
+    for (const auto& child : entity.get_children()) {
+        traverse_entity(child, transform, visitor);
+    }
 }
+
+void Scene::traverse(const EntityVisitor& visitor) const
+{
+    for (const auto& entity : m_entities) {
+        traverse_entity(entity, glm::mat4{ 1.f }, visitor);
+    }
+}
+
+}  // namespace ec
@@ -2,6 +2,7 @@
 
 #include "entity.hpp"
 
+#include <functional>
 #include <string>
 
 namespace ec
@@ -11,7 +12,19 @@ class Scene
 {
 public:
 
+    // Called for every entity with its transform relative to the scene
+    using EntityVisitor = std::function<void(const Entity&, const glm::mat4&)>;
+
     Scene() = default;
+    explicit Scene(std::string_view name) : m_name(name){};
+
+    void add_entity(Entity&& entity) { m_entities.push_back(std::move(entity)); }
+
+    const std::string& get_name() const { return m_name; }
+    const std::vector<Entity>& get_entities() const { return m_entities; }
+
+    // Depth-first, parents before their children
+    void traverse(const EntityVisitor& visitor) const;
 
 private:
 
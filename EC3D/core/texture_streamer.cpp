@@ -0,0 +1,324 @@
+#include "pch.hpp"
+#include "texture_streamer.hpp"
+#include "backend/utils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace ec
+{
+
+// Of the remaining device budget, the rest is left for other allocations
+constexpr double DEVICE_BUDGET_SHARE{ 0.9 };
+
+static bool is_rgba8(vk::Format format)
+{
+    switch (format) {
+        case vk::Format::eR8G8B8A8Unorm:
+        case vk::Format::eR8G8B8A8Srgb:
+        case vk::Format::eB8G8R8A8Unorm:
+        case vk::Format::eB8G8R8A8Srgb: return true;
+        default: return false;
+    }
+}
+
+// Box filtered levels 1 and up of every layer. sRGB colors are averaged in linear space
+static std::vector<std::vector<std::byte>> generate_rgba8_levels(const vulkan::ImageData& data)
+{
+    bool srgb{ data.format == vk::Format::eR8G8B8A8Srgb
+               || data.format == vk::Format::eB8G8R8A8Srgb };
+    std::array<float, 256> toLinear{};
+    for (uint32_t i = 0; i < 256; ++i) {
+        float value{ i / 255.f };
+        toLinear[i] = !srgb            ? value
+                      : value <= 0.04045f ? value / 12.92f
+                                          : std::pow((value + 0.055f) / 1.055f, 2.4f);
+    }
+    auto fromLinear{ [&](float value) {
+        if (srgb) {
+            value = value <= 0.0031308f ? value * 12.92f
+                                        : 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+        }
+        return static_cast<std::byte>(std::clamp(value * 255.f + 0.5f, 0.f, 255.f));
+    } };
+
+    std::vector<std::vector<std::byte>> levels{};
+    std::span<const std::byte> source{ data.levels[0] };
+    for (uint32_t level = 1; level < data.mipLevels; ++level) {
+        vk::Extent3D srcExtent{ vulkan::mip_level_extent(data.extent, level - 1) };
+        vk::Extent3D dstExtent{ vulkan::mip_level_extent(data.extent, level) };
+        size_t srcLayerSize{ size_t{ srcExtent.width } * srcExtent.height * 4 };
+        auto& destination{ levels.emplace_back(size_t{ dstExtent.width } * dstExtent.height * 4
+                                               * data.arrayLayers) };
+        size_t dstIndex{};
+        for (uint32_t layer = 0; layer < data.arrayLayers; ++layer) {
+            auto texel{ [&](uint32_t x, uint32_t y, uint32_t channel) {
+                size_t index{ layer * srcLayerSize + (size_t{ y } * srcExtent.width + x) * 4 };
+                return static_cast<uint8_t>(source[index + channel]);
+            } };
+            for (uint32_t y = 0; y < dstExtent.height; ++y) {
+                // Odd sizes repeat the last row or column
+                uint32_t y0{ std::min(y * 2, srcExtent.height - 1) };
+                uint32_t y1{ std::min(y * 2 + 1, srcExtent.height - 1) };
+                for (uint32_t x = 0; x < dstExtent.width; ++x) {
+                    uint32_t x0{ std::min(x * 2, srcExtent.width - 1) };
+                    uint32_t x1{ std::min(x * 2 + 1, srcExtent.width - 1) };
+                    for (uint32_t channel = 0; channel < 4; ++channel) {
+                        std::array<uint8_t, 4> values{ texel(x0, y0, channel),
+                                                       texel(x1, y0, channel),
+                                                       texel(x0, y1, channel),
+                                                       texel(x1, y1, channel) };
+                        if (channel == 3) {  // Alpha is always linear
+                            uint32_t sum{ 2u + values[0] + values[1] + values[2] + values[3] };
+                            destination[dstIndex++] = static_cast<std::byte>(sum / 4);
+                        } else {
+                            float sum{ toLinear[values[0]] + toLinear[values[1]]
+                                       + toLinear[values[2]] + toLinear[values[3]] };
+                            destination[dstIndex++] = fromLinear(sum / 4.f);
+                        }
+                    }
+                }
+            }
+        }
+        source = destination;
+    }
+    return levels;
+}
+
+TextureStreamer::TextureStreamer(vulkan::Renderer& renderer, const TextureStreamer::Info& info) :
+  m_renderer{ &renderer },
+  m_info{ info }
+{
+}
+
+uint32_t TextureStreamer::add_texture(const vulkan::ImageData& data)
+{
+    auto& texture{ m_textures.emplace_back(StreamedTexture{ .data = data }) };
+    auto& levels{ texture.data.levels };
+    if (levels.size() == 1 && data.mipLevels > 1 && is_rgba8(data.format)
+        && data.type != vulkan::Image::Type::image3D) {
+        texture.generatedLevels = generate_rgba8_levels(data);
+        levels.insert(levels.end(), texture.generatedLevels.begin(), texture.generatedLevels.end());
+    }
+
+    // Only whole chains can be split, the rest is uploaded at once
+    texture.tailLevel = 0;
+    if (levels.size() == data.mipLevels) {
+        while (texture.tailLevel + 1 < data.mipLevels) {
+            vk::Extent3D extent{ vulkan::mip_level_extent(data.extent, texture.tailLevel) };
+            if (std::max({ extent.width, extent.height, extent.depth }) <= m_info.tailSize) {
+                break;
+            }
+            ++texture.tailLevel;
+        }
+    }
+    texture.residentLevel  = data.mipLevels;
+    texture.requestedLevel = texture.tailLevel;
+
+    // Levels are staged one at a time after the tail
+    if (!levels.empty() && get_staged_size(texture, texture.tailLevel) > m_info.uploadBudget) {
+        EC_LOG_WARN("Streamed texture {} needs more than the upload budget at once, it is never "
+                    "resident",
+                    m_textures.size() - 1);
+        levels.clear();
+        texture.generatedLevels.clear();
+    }
+    texture.topLevel = texture.tailLevel;
+    while (texture.topLevel > 0
+           && vulkan::image_level_size(data.format,
+                                       data.extent,
+                                       texture.topLevel - 1,
+                                       data.arrayLayers)
+                  <= m_info.uploadBudget) {
+        --texture.topLevel;
+    }
+    return static_cast<uint32_t>(m_textures.size() - 1);
+}
+
+void TextureStreamer::request(uint32_t texture, float screenSize)
+{
+    auto& streamed{ m_textures.at(texture) };
+    vk::Extent3D extent{ streamed.data.extent };
+    auto textureSize{ static_cast<float>(std::max({ extent.width, extent.height, extent.depth })) };
+    // The level with about one texel per pixel
+    float level{ std::floor(std::log2(textureSize / std::max(screenSize, 1.f))) };
+    uint32_t requestedLevel{ std::clamp(static_cast<uint32_t>(std::max(level, 0.f)),
+                                        streamed.topLevel,
+                                        streamed.tailLevel) };
+    if (streamed.lastRequest != m_updateCount) {
+        streamed.requestedLevel = requestedLevel;
+    } else {
+        streamed.requestedLevel = std::min(streamed.requestedLevel, requestedLevel);
+    }
+    streamed.lastRequest = m_updateCount;
+}
+
+void TextureStreamer::update(vulkan::GraphicsContext& context)
+{
+    // The replaced images may still be used by the frames in flight
+    for (auto& texture : m_textures) {
+        if (!texture.pending
+            || !m_renderer->is_transfer_complete(texture.pending->transferValue)) {
+            continue;
+        }
+        if (texture.image.get_image()) {
+            context.retire_image(std::move(texture.image));
+        }
+        m_residentSize -= get_size(texture, texture.residentLevel);
+        m_pendingSize -= get_size(texture, texture.pending->level);
+        m_residentSize += get_size(texture, texture.pending->level);
+        texture.image         = std::move(texture.pending->image);
+        texture.residentLevel = texture.pending->level;
+        texture.pending.reset();
+    }
+
+    std::vector<uint32_t> targets(m_textures.size());
+    vk::DeviceSize targetSize{};
+    for (size_t i = 0; i < m_textures.size(); ++i) {
+        const auto& texture{ m_textures[i] };
+        bool recent{ texture.lastRequest
+                     && texture.lastRequest.value() + m_info.staleFrames >= m_updateCount };
+        targets[i] = recent ? texture.requestedLevel : texture.tailLevel;
+        targetSize += get_size(texture, targets[i]);
+    }
+
+    // Over budget, the least recently requested textures are shrunk first, down to their tails
+    vk::DeviceSize budget{ get_budget() };
+    std::vector<uint32_t> order(m_textures.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::ranges::sort(order,
+                      [&](uint32_t a, uint32_t b)
+                      { return m_textures[a].lastRequest < m_textures[b].lastRequest; });
+    for (uint32_t i : order) {
+        const auto& texture{ m_textures[i] };
+        while (targetSize > budget && targets[i] < texture.tailLevel) {
+            targetSize -= get_size(texture, targets[i]) - get_size(texture, targets[i] + 1);
+            ++targets[i];
+        }
+    }
+
+    // Shrinking first to free memory, then the textures missing the most levels
+    std::erase_if(order,
+                  [&](uint32_t i)
+                  {
+                      return m_textures[i].pending || m_textures[i].data.levels.empty()
+                             || targets[i] == m_textures[i].residentLevel;
+                  });
+    auto missingLevels{ [&](uint32_t i) {
+        return static_cast<int64_t>(m_textures[i].residentLevel) - static_cast<int64_t>(targets[i]);
+    } };
+    std::ranges::stable_sort(order,
+                             [&](uint32_t a, uint32_t b)
+                             { return missingLevels(a) > missingLevels(b); });
+    std::ranges::stable_partition(order, [&](uint32_t i) { return missingLevels(i) < 0; });
+
+    std::vector<vulkan::ImageData> uploadData{};
+    uploadData.reserve(order.size());  // Transfers point to its elements
+    std::vector<vulkan::ImageTransfer> transfers{};
+    std::vector<uint32_t> uploaded{};
+    vk::DeviceSize uploadSize{};
+    vk::DeviceSize usedSize{ m_residentSize + m_pendingSize };
+    for (uint32_t i : order) {
+        auto& texture{ m_textures[i] };
+        // One level at a time when growing, so the smallest ones are always there first
+        uint32_t level{ texture.residentLevel == texture.data.mipLevels ? texture.tailLevel
+                        : missingLevels(i) > 0                          ? texture.residentLevel - 1
+                                                                        : targets[i] };
+        vk::DeviceSize stagedSize{ get_staged_size(texture, level) };
+        if (uploadSize + stagedSize > m_info.uploadBudget) {
+            break;
+        }
+        vk::DeviceSize size{ get_size(texture, level) };
+        vk::DeviceSize residentSize{ get_size(texture, texture.residentLevel) };
+        if (size > residentSize && usedSize + size - residentSize > budget) {
+            continue;
+        }
+
+        // Resident levels are copied from the current image, so only the missing ones are staged
+        const vulkan::Image* srcImage{ texture.image.get_image() ? &texture.image : nullptr };
+        auto firstStaged{ texture.data.levels.begin() + level };
+        auto lastStaged{ srcImage ? texture.data.levels.begin()
+                                        + std::max(level, texture.residentLevel)
+                                  : texture.data.levels.end() };
+        auto& data{ uploadData.emplace_back(vulkan::ImageData{
+            .format      = texture.data.format,
+            .type        = texture.data.type,
+            .extent      = vulkan::mip_level_extent(texture.data.extent, level),
+            .mipLevels   = texture.data.mipLevels - level,
+            .arrayLayers = texture.data.arrayLayers,
+            .levels      = { firstStaged, lastStaged },
+        }) };
+        texture.pending = PendingImage{ .image = m_renderer->create_texture(data), .level = level };
+        transfers.push_back({
+            .dstImage = &texture.pending->image,
+            .data     = &data,
+            .srcImage = srcImage,
+        });
+        uploaded.push_back(i);
+        uploadSize += stagedSize;
+        usedSize += size;
+        m_pendingSize += size;
+    }
+    if (!transfers.empty()) {
+        uint64_t transferValue{ m_renderer->transfer_data_async(transfers) };
+        for (uint32_t i : uploaded) {
+            m_textures[i].pending->transferValue = transferValue;
+        }
+    }
+    ++m_updateCount;
+}
+
+void TextureStreamer::free()
+{
+    for (auto& texture : m_textures) {
+        m_renderer->free_image(texture.image);
+        if (texture.pending) {
+            m_renderer->free_image(texture.pending->image);
+            texture.pending.reset();
+        }
+    }
+    m_textures.clear();
+    m_residentSize = 0;
+    m_pendingSize  = 0;
+}
+
+vk::DeviceSize TextureStreamer::get_size(const StreamedTexture& texture, uint32_t level) const
+{
+    vk::DeviceSize size{};
+    for (; level < texture.data.mipLevels; ++level) {
+        size += vulkan::image_level_size(texture.data.format,
+                                         texture.data.extent,
+                                         level,
+                                         texture.data.arrayLayers);
+    }
+    return size;
+}
+
+vk::DeviceSize TextureStreamer::get_staged_size(const StreamedTexture& texture,
+                                                uint32_t level) const
+{
+    uint32_t lastLevel{ texture.image.get_image() ? std::max(level, texture.residentLevel)
+                                                  : static_cast<uint32_t>(
+                                                        texture.data.levels.size()) };
+    vk::DeviceSize size{};
+    for (; level < lastLevel; ++level) {
+        size += texture.data.levels[level].size();
+    }
+    return size;
+}
+
+vk::DeviceSize TextureStreamer::get_budget() const
+{
+    // What the rest of the process and other processes leave free, the streamed textures included
+    auto deviceBudget{ m_renderer->get_memory_budget() };
+    vk::DeviceSize streamedSize{ m_residentSize + m_pendingSize };
+    vk::DeviceSize otherUsage{ deviceBudget.usage > streamedSize ? deviceBudget.usage - streamedSize
+                                                                 : 0 };
+    auto available{ static_cast<vk::DeviceSize>(
+        (deviceBudget.budget > otherUsage ? deviceBudget.budget - otherUsage : 0)
+        * DEVICE_BUDGET_SHARE) };
+    return m_info.memoryBudget > 0 ? std::min(m_info.memoryBudget, available) : available;
+}
+
+}  // namespace ec
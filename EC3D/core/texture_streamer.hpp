@@ -0,0 +1,94 @@
+#pragma once
+
+#include "backend/renderer.hpp"
+
+#include <optional>
+#include <vector>
+
+namespace ec
+{
+
+// Keeps textures partially resident. Each one starts with its smallest mip levels and gets one
+// more level at a time while screen-space size feedback asks for it. Textures without recent
+// requests, and the least recently requested ones when over the memory budget, are shrunk back.
+// Resizing a texture replaces its image with one holding the new levels, the resident ones are
+// copied from the old image on the GPU so only a new level is staged. Uploads are asynchronous
+// and throttled per update, so the frame never waits for them
+class TextureStreamer
+{
+public:
+
+    struct Info {
+        // Bytes of streamed textures, 0 for what the device memory budget leaves free
+        vk::DeviceSize memoryBudget{};
+        // Bytes staged per update. Levels, or data that can't be split, staging more than this
+        // on their own are never resident
+        vk::DeviceSize uploadBudget{ 16 << 20 };
+        uint32_t tailSize{ 64 };      // Levels this size or smaller are resident from the start
+        uint32_t staleFrames{ 120 };  // Updates without requests before a texture is shrunk
+    };
+
+    TextureStreamer(vulkan::Renderer& renderer, const TextureStreamer::Info& info);
+
+    TextureStreamer(const TextureStreamer&)            = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    // Levels are read from data on every upload, so they must outlive the streamer. Single level
+    // RGBA8 data gets the rest of its levels generated here, other data without all of its levels
+    // is fully resident. Data without levels is never resident
+    uint32_t add_texture(const vulkan::ImageData& data);
+
+    // The texture covers about screenSize pixels along its largest axis in the current frame
+    void request(uint32_t texture, float screenSize);
+    // Once per frame, between frames. Swaps in the finished uploads and starts new ones
+    void update(vulkan::GraphicsContext& context);
+
+    // Without an image until the first upload is done. Level 0 of the image is the resident level
+    const vulkan::Image& get_image(uint32_t texture) const { return m_textures.at(texture).image; }
+    uint32_t get_resident_level(uint32_t texture) const
+    {
+        return m_textures.at(texture).residentLevel;
+    }
+    vk::DeviceSize get_resident_size() const { return m_residentSize; }
+
+    // The device must be idle
+    void free();
+
+private:
+
+    struct PendingImage {
+        vulkan::Image image{};
+        uint32_t level{};
+        uint64_t transferValue{};
+    };
+
+    struct StreamedTexture {
+        vulkan::ImageData data{};
+        std::vector<std::vector<std::byte>> generatedLevels{};  // Levels 1 and up, if generated
+        uint32_t topLevel{};  // The largest level that fits the upload budget
+        uint32_t tailLevel{};
+        vulkan::Image image{};
+        uint32_t residentLevel{};  // data.mipLevels if nothing is resident
+        uint32_t requestedLevel{};
+        std::optional<uint64_t> lastRequest{};  // Update of the last request
+        std::optional<PendingImage> pending{};
+    };
+
+    // Bytes of the image holding the levels from level to the smallest one
+    vk::DeviceSize get_size(const StreamedTexture& texture, uint32_t level) const;
+    // Bytes of data staged to resize the texture to level, the rest is copied from its image
+    vk::DeviceSize get_staged_size(const StreamedTexture& texture, uint32_t level) const;
+    vk::DeviceSize get_budget() const;
+
+private:
+
+    vulkan::Renderer* m_renderer{};
+    TextureStreamer::Info m_info{};
+
+    std::vector<StreamedTexture> m_textures{};
+    vk::DeviceSize m_residentSize{};
+    vk::DeviceSize m_pendingSize{};
+    uint64_t m_updateCount{};
+};
+
+}  // namespace ec
@@ -6,13 +6,13 @@ namespace ec
 
 void init()
 {
-    std::cout << "Initializing EC3D." << std::endl;
+    std::clog << "Initializing EC3D." << std::endl;
     log::register_macro_logger(log::Severity::debug);
 }
 
 void shutdown()
 {
-    std::cout << "Shutting down EC3D." << std::endl;
+    std::clog << "Shutting down EC3D." << std::endl;
 }
 
 }  // namespace ec
@@ -0,0 +1,94 @@
+#include "pch.hpp"
+#include "frame_limiter.hpp"
+
+#include <cmath>
+
+namespace ec
+{
+
+FrameLimiter::FrameLimiter(float targetFrameRate)
+{
+#ifdef _WIN32
+    m_timer = CreateWaitableTimerExW(nullptr,
+                                     nullptr,
+                                     CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+                                     TIMER_ALL_ACCESS);
+#endif
+    set_target_frame_rate(targetFrameRate);
+}
+
+FrameLimiter::~FrameLimiter()
+{
+#ifdef _WIN32
+    if (m_timer) {
+        CloseHandle(m_timer);
+    }
+#endif
+}
+
+void FrameLimiter::set_target_frame_rate(float targetFrameRate)
+{
+    m_period    = targetFrameRate > 0.f ? Duration{ 1.0 / targetFrameRate } : Duration{};
+    m_nextFrame = Clock::now();
+}
+
+void FrameLimiter::wait()
+{
+    if (!is_enabled()) {
+        return;
+    }
+
+    auto now{ Clock::now() };
+    m_nextFrame += std::chrono::duration_cast<Clock::duration>(m_period);
+    if (m_nextFrame < now - m_period) {
+        m_nextFrame = now;  // Too late to catch up, start over
+        return;
+    }
+    sleep_until(m_nextFrame);
+}
+
+void FrameLimiter::sleep_until(Clock::time_point deadline)
+{
+    constexpr Duration SLEEP_STEP{ 1e-3 };
+
+    // Sleep in small steps while even a slow one (mean + 1 stddev) ends before the deadline
+    while (true) {
+        Duration remaining{ deadline - Clock::now() };
+        double stddev{ std::sqrt(m_sleepM2 / static_cast<double>(m_sleepCount)) };
+        if (remaining.count() <= m_sleepMean + stddev) {
+            break;
+        }
+
+        auto start{ Clock::now() };
+        sleep_for(SLEEP_STEP);
+        double observed{ Duration{ Clock::now() - start }.count() };
+
+        ++m_sleepCount;
+        double delta{ observed - m_sleepMean };
+        m_sleepMean += delta / static_cast<double>(m_sleepCount);
+        m_sleepM2 += delta * (observed - m_sleepMean);
+    }
+
+    // Spin for the rest
+    while (Clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+}
+
+void FrameLimiter::sleep_for(Duration duration)
+{
+#ifdef _WIN32
+    if (m_timer) {
+        // Relative due time in 100 ns intervals
+        LARGE_INTEGER dueTime{};
+        dueTime.QuadPart = -static_cast<LONGLONG>(duration.count() * 1e7);
+        if (SetWaitableTimerEx(m_timer, &dueTime, 0, nullptr, nullptr, nullptr, 0)) {
+            WaitForSingleObject(m_timer, INFINITE);
+            return;
+        }
+    }
+#endif
+    std::this_thread::sleep_for(duration);
+}
+
+}  // namespace ec
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+
+namespace ec
+{
+
+// Caps the frame rate by waiting until the next frame deadline. Sleeps while the remaining time is
+// clearly longer than the measured sleep overshoot, then spins for the rest, so frames are paced
+// with sub-millisecond accuracy without keeping a core busy
+class FrameLimiter
+{
+public:
+
+    FrameLimiter() = default;
+    explicit FrameLimiter(float targetFrameRate);
+    ~FrameLimiter() noexcept;
+
+    FrameLimiter(const FrameLimiter&)            = delete;
+    FrameLimiter(FrameLimiter&&)                 = delete;
+    FrameLimiter& operator=(const FrameLimiter&) = delete;
+    FrameLimiter& operator=(FrameLimiter&&)      = delete;
+
+    // 0 disables the limiter
+    void set_target_frame_rate(float targetFrameRate);
+    bool is_enabled() const { return m_period.count() > 0; }
+
+    // Blocks until the next frame may start. Deadlines advance by a fixed period, so a late frame
+    // is made up for by the next one, unless it is more than a whole period late
+    void wait();
+
+private:
+
+    using Clock    = std::chrono::steady_clock;
+    using Duration = std::chrono::duration<double>;
+
+    void sleep_until(Clock::time_point deadline);
+    void sleep_for(Duration duration);
+
+private:
+
+    Duration m_period{};
+    Clock::time_point m_nextFrame{};
+
+    // Running mean and variance of the actual duration of a 1 ms sleep (Welford)
+    double m_sleepMean{ 1e-3 };
+    double m_sleepM2{};
+    uint64_t m_sleepCount{ 1 };
+
+#ifdef _WIN32
+    void* m_timer{};  // High resolution waitable timer, the default sleep granularity is too coarse
+#endif
+};
+
+}  // namespace ec
@@ -12,7 +12,8 @@ std::shared_ptr<spdlog::logger> g_macroLogger;
 
 void register_macro_logger(log::Severity severity)
 {
-    g_macroLogger = spdlog::stdout_color_mt(MACRO_LOGGER_NAME);
+    // On stderr, stdout can carry exported frames (see FrameExporter::STDOUT_PATH)
+    g_macroLogger = spdlog::stderr_color_mt(MACRO_LOGGER_NAME);
     spdlog::set_level(ec_severity_to_spdlog_level(severity));
 }
 
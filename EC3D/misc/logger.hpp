@@ -1,6 +1,6 @@
 #pragma once
 
-// For now, only an stdout logger
+// For now, only an stderr logger
 
 namespace ec::log
 {
@@ -0,0 +1,127 @@
+#include "pch.hpp"
+#include "mapped_file.hpp"
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace ec
+{
+
+MappedFile::MappedFile(const std::filesystem::path& path)
+{
+#ifdef _WIN32
+    HANDLE file{ CreateFileW(path.c_str(),
+                             GENERIC_READ,
+                             FILE_SHARE_READ,
+                             nullptr,
+                             OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                             nullptr) };
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error(std::format("Failed to open {}", path.string()));
+    }
+    m_file = file;
+    LARGE_INTEGER fileSize{};
+    if (!GetFileSizeEx(file, &fileSize)) {
+        close();
+        throw std::runtime_error(std::format("Failed to get the size of {}", path.string()));
+    }
+    m_size = static_cast<size_t>(fileSize.QuadPart);
+    if (m_size == 0) {
+        return;  // Empty files can't be mapped
+    }
+    m_mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void* data{ m_mapping ? MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr };
+    if (!data) {
+        close();
+        throw std::runtime_error(std::format("Failed to map {}", path.string()));
+    }
+    m_data = static_cast<const std::byte*>(data);
+#else
+    int fd{ ::open(path.c_str(), O_RDONLY) };
+    if (fd < 0) {
+        throw std::runtime_error(std::format("Failed to open {}", path.string()));
+    }
+    struct stat fileStat{};
+    if (::fstat(fd, &fileStat) != 0) {
+        ::close(fd);
+        throw std::runtime_error(std::format("Failed to get the size of {}", path.string()));
+    }
+    m_size = static_cast<size_t>(fileStat.st_size);
+    if (m_size == 0) {
+        ::close(fd);
+        return;  // Empty files can't be mapped
+    }
+    void* data{ ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0) };
+    ::close(fd);  // The mapping keeps its own reference
+    if (data == MAP_FAILED) {
+        m_size = 0;
+        throw std::runtime_error(std::format("Failed to map {}", path.string()));
+    }
+    // Most of the file is read front to back, right after mapping it
+    ::madvise(data, m_size, MADV_SEQUENTIAL);
+    ::madvise(data, m_size, MADV_WILLNEED);
+    m_data = static_cast<const std::byte*>(data);
+#endif
+}
+
+MappedFile::~MappedFile() noexcept
+{
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other) {
+        close();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+#ifdef _WIN32
+        m_file    = std::exchange(other.m_file, nullptr);
+        m_mapping = std::exchange(other.m_mapping, nullptr);
+#endif
+    }
+    return *this;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if (m_data) {
+        UnmapViewOfFile(m_data);
+    }
+    if (m_mapping) {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+    if (m_file) {
+        CloseHandle(m_file);
+        m_file = nullptr;
+    }
+#else
+    if (m_data) {
+        ::munmap(const_cast<std::byte*>(m_data), m_size);
+    }
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
+
+std::span<const std::byte> MappedFile::get_bytes(uint64_t offset, uint64_t size) const
+{
+    if (offset > m_size || size > m_size - offset) {
+        throw std::runtime_error("Range outside of the mapped file");
+    }
+    return { m_data + offset, static_cast<size_t>(size) };
+}
+
+}  // namespace ec
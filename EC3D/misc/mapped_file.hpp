@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+
+namespace ec
+{
+
+// Read-only memory mapping of a whole file. Pages are read by the OS when first accessed
+class MappedFile
+{
+public:
+
+    MappedFile() = default;
+    // Throws if the file can't be opened or mapped
+    explicit MappedFile(const std::filesystem::path& path);
+    ~MappedFile() noexcept;
+
+    MappedFile(const MappedFile&)            = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    void close();
+
+    std::span<const std::byte> get_bytes() const { return { m_data, m_size }; }
+    // Throws if the range is not inside the file
+    std::span<const std::byte> get_bytes(uint64_t offset, uint64_t size) const;
+
+private:
+
+    const std::byte* m_data{};
+    size_t m_size{};
+#ifdef _WIN32
+    void* m_file{};
+    void* m_mapping{};
+#endif
+};
+
+}  // namespace ec
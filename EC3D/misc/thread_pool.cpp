@@ -0,0 +1,48 @@
+#include "pch.hpp"
+#include "thread_pool.hpp"
+
+namespace ec
+{
+
+ThreadPool::ThreadPool(uint32_t numThreads)
+{
+    if (numThreads == 0) {
+        numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    m_threads.reserve(numThreads);
+    for (uint32_t i = 0; i < numThreads; ++i) {
+        m_threads.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() noexcept
+{
+    {
+        std::scoped_lock lock{ m_mutex };
+        m_stop = true;
+    }
+    m_condition.notify_all();
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::worker_loop()
+{
+    while (true) {
+        std::function<void()> task{};
+        {
+            std::unique_lock lock{ m_mutex };
+            m_condition.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+            // Queued tasks are still run when stopping, their futures would never be ready
+            if (m_tasks.empty()) {
+                return;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task();
+    }
+}
+
+}  // namespace ec
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ec
+{
+
+// Fixed set of worker threads running submitted tasks in FIFO order. Exceptions thrown by a task
+// are rethrown by the get() of its future
+class ThreadPool
+{
+public:
+
+    // 0 uses one thread per hardware thread
+    explicit ThreadPool(uint32_t numThreads = 0);
+    ~ThreadPool() noexcept;
+
+    ThreadPool(const ThreadPool&)            = delete;
+    ThreadPool(ThreadPool&&)                 = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ThreadPool& operator=(ThreadPool&&)      = delete;
+
+    template<typename F>
+    auto submit(F&& task) -> std::future<std::invoke_result_t<F>>
+    {
+        // std::function needs a copyable target
+        auto packagedTask{ std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(
+            std::forward<F>(task)) };
+        auto future{ packagedTask->get_future() };
+        {
+            std::scoped_lock lock{ m_mutex };
+            m_tasks.emplace_back([packagedTask]() { (*packagedTask)(); });
+        }
+        m_condition.notify_one();
+        return future;
+    }
+
+    uint32_t get_num_threads() const { return static_cast<uint32_t>(m_threads.size()); }
+
+private:
+
+    void worker_loop();
+
+private:
+
+    std::vector<std::thread> m_threads{};
+    std::mutex m_mutex{};
+    std::condition_variable m_condition{};
+    std::deque<std::function<void()>> m_tasks{};
+    bool m_stop{};
+};
+
+}  // namespace ec
@@ -0,0 +1,20 @@
+#version 450
+
+layout(location = 0) in vec3 normal;
+layout(location = 1) in vec4 color;
+layout(location = 2) flat in float alphaCutoff;
+
+layout(location = 0) out vec4 outColor;
+
+// MaterialFeature bits, set per pipeline variant
+layout(constant_id = 5) const bool ALPHA_MASK = false;
+
+const vec3 lightDirection = normalize(vec3(0.4, 1., 0.6));
+
+void main() {
+	if (ALPHA_MASK && color.a < alphaCutoff) {
+		discard;
+	}
+	float diffuse = max(dot(normalize(normal), lightDirection), 0.);
+	outColor = vec4(color.rgb * (0.2 + 0.8 * diffuse), color.a);
+}
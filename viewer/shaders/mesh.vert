@@ -0,0 +1,34 @@
+#version 450
+
+// PackedVertex, see packed_vertex.hpp
+layout(location = 0) in vec4 position; // Quantized to the primitive bounds, w is the bitangent sign
+layout(location = 1) in vec2 normal;   // Octahedral
+layout(location = 2) in vec2 tangent;  // Octahedral
+layout(location = 3) in vec2 texCoord0;
+layout(location = 4) in vec2 texCoord1;
+layout(location = 5) in vec4 color;
+
+// Set per draw, see Engine::draw_model
+layout(push_constant) uniform PushConstants {
+	mat4 mvp; // Includes the dequantization of the positions
+	vec4 normalMatrix[3]; // Columns of a mat3, alpha cutoff in [0].w
+	vec4 baseColor;
+} pc;
+
+layout(location = 0) out vec3 outNormal;
+layout(location = 1) out vec4 outColor;
+layout(location = 2) flat out float outAlphaCutoff;
+
+vec3 decode_octahedral(vec2 encoded) {
+	vec3 direction = vec3(encoded, 1. - abs(encoded.x) - abs(encoded.y));
+	float fold = max(-direction.z, 0.);
+	direction.xy += vec2(direction.x >= 0. ? -fold : fold, direction.y >= 0. ? -fold : fold);
+	return normalize(direction);
+}
+
+void main() {
+	gl_Position = pc.mvp * vec4(position.xyz, 1.);
+	outNormal = mat3(pc.normalMatrix[0].xyz, pc.normalMatrix[1].xyz, pc.normalMatrix[2].xyz) * decode_octahedral(normal);
+	outColor = color * pc.baseColor;
+	outAlphaCutoff = pc.normalMatrix[0].w;
+}
@@ -1,11 +1,73 @@
 #include <EC3D/ec3d.hpp>
 
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <format>
 #include <iostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
 
 constexpr int DEFAULT_WINDOW_WIDTH{ 1200 };
 constexpr int DEFAULT_WINDOW_HEIGHT{ 675 };
 
-int main([[maybe_unused]] int argc, [[maybe_unused]] char* argv[])
+// Times importing a glTF file against mapping its cooked version. Both copy everything that would
+// be uploaded to a staging-like buffer, so the lazy reads of the mapping are measured too. Only
+// the glTF vertices are packed, the cooked ones already are
+static void benchmark_loading(const std::string& gltfPath, uint32_t iterations)
+{
+    std::filesystem::path cookedPath{ std::filesystem::temp_directory_path()
+                                      / std::filesystem::path{ gltfPath }.filename() };
+    cookedPath.replace_extension(ec::CookedModel::FILE_EXTENSION);
+    ec::cook_model(ec::load_gltf_file(gltfPath), cookedPath);
+
+    std::vector<std::byte> staging{};
+    auto stage{ [&](std::span<const std::byte> data) {
+        if (staging.size() < data.size()) {
+            staging.resize(data.size());
+        }
+        std::memcpy(staging.data(), data.data(), data.size());
+    } };
+
+    using Clock = std::chrono::steady_clock;
+    std::chrono::duration<double, std::milli> gltfTime{}, cookedTime{};
+    for (uint32_t i = 0; i < iterations; ++i) {
+        auto start{ Clock::now() };
+        {
+            // The cooked file already holds the optimized meshes, so the optimizer isn't timed
+            auto model{ ec::load_gltf_file(gltfPath, ec::GltfLoadInfo{ .optimizeMeshes = false }) };
+            stage(std::as_bytes(std::span{ ec::pack_vertices(model.vertices, model.meshes) }));
+            stage(std::as_bytes(std::span{ model.indices }));
+            for (const auto& image : model.images) {
+                stage(std::as_bytes(std::span{ image.pixels }));
+            }
+        }
+        auto gltfEnd{ Clock::now() };
+        {
+            ec::CookedModel cooked{ cookedPath };
+            stage(cooked.get_vertex_data());
+            stage(cooked.get_index_data());
+            for (uint32_t j = 0; j < cooked.get_model().images.size(); ++j) {
+                stage(cooked.get_image_data(j));
+            }
+        }
+        auto cookedEnd{ Clock::now() };
+        gltfTime += gltfEnd - start;
+        cookedTime += cookedEnd - gltfEnd;
+    }
+    std::filesystem::remove(cookedPath);
+
+    std::cout << std::format("Average load time over {} iterations: glTF {:.2f} ms, cooked {:.2f} "
+                             "ms ({:.1f}x faster)\n",
+                             iterations,
+                             gltfTime.count() / iterations,
+                             cookedTime.count() / iterations,
+                             gltfTime / cookedTime);
+}
+
+int main(int argc, char* argv[])
 {
     try {
         ec::init();
@@ -18,12 +80,86 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char* argv[])
                         .name   = "EC3D Renderer",
                         }
         };
+        std::string cookPath{};
+        uint32_t benchmarkIterations{};
+        for (int i = 1; i < argc; ++i) {
+            std::string_view arg{ argv[i] };
+            if (arg == "--dynamic-rendering") {
+                engineInfo.dynamicRendering = true;
+            } else if (arg == "--shader-objects") {
+                engineInfo.shaderObjects = true;
+            } else if (arg == "--headless") {
+                engineInfo.headless = true;
+            } else if (arg == "--record-ahead") {
+                engineInfo.recordAhead = true;
+            } else if (arg == "--frames-in-flight" && i + 1 < argc) {
+                engineInfo.framesInFlight = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else if (arg == "--swapchain-images" && i + 1 < argc) {
+                engineInfo.swapchainImages = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else if (arg == "--target-fps" && i + 1 < argc) {
+                engineInfo.targetFrameRate = std::stof(argv[++i]);
+            } else if (arg == "--fps-limit" && i + 1 < argc) {
+                engineInfo.frameRateLimit = std::stof(argv[++i]);
+            } else if (arg == "--present-mode" && i + 1 < argc) {
+                std::string_view mode{ argv[++i] };
+                if (mode == "fifo") {
+                    engineInfo.presentMode = vk::PresentModeKHR::eFifo;
+                } else if (mode == "fifo-relaxed") {
+                    engineInfo.presentMode = vk::PresentModeKHR::eFifoRelaxed;
+                } else if (mode == "mailbox") {
+                    engineInfo.presentMode = vk::PresentModeKHR::eMailbox;
+                } else if (mode == "immediate") {
+                    engineInfo.presentMode = vk::PresentModeKHR::eImmediate;
+                } else {
+                    std::cerr << "Unknown present mode " << mode << std::endl;
+                }
+            } else if (arg == "--model" && i + 1 < argc) {
+                engineInfo.modelPath = argv[++i];
+            } else if (arg == "--cook" && i + 1 < argc) {
+                cookPath = argv[++i];
+            } else if (arg == "--benchmark-load" && i + 1 < argc) {
+                benchmarkIterations = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else if (arg == "--loader-threads" && i + 1 < argc) {
+                engineInfo.loaderThreads = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else if (arg == "--no-mesh-optimization") {
+                engineInfo.optimizeMeshes = false;
+            } else if (arg == "--stream-textures") {
+                engineInfo.streamTextures = true;
+            } else if (arg == "--texture-budget" && i + 1 < argc) {
+                engineInfo.textureBudget = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else if (arg == "--texture" && i + 1 < argc) {
+                engineInfo.texturePath = argv[++i];
+            } else if (arg == "--frames" && i + 1 < argc) {
+                engineInfo.maxFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else if (arg == "--export-png" && i + 1 < argc) {
+                engineInfo.exportInfo = { .mode = ec::FrameExporter::Mode::png, .path = argv[++i] };
+            } else if (arg == "--export-raw" && i + 1 < argc) {
+                engineInfo.exportInfo = { .mode = ec::FrameExporter::Mode::raw, .path = argv[++i] };
+            }
+        }
+        // Offline tools, the glTF file in --model is cooked or benchmarked instead of rendered
+        if (!cookPath.empty() || benchmarkIterations > 0) {
+            if (engineInfo.modelPath.empty()) {
+                throw std::runtime_error("--cook and --benchmark-load need a --model file");
+            }
+            if (!cookPath.empty()) {
+                ec::cook_model(ec::load_gltf_file(engineInfo.modelPath), cookPath);
+            }
+            if (benchmarkIterations > 0) {
+                benchmark_loading(engineInfo.modelPath, benchmarkIterations);
+            }
+            ec::shutdown();
+            return EXIT_SUCCESS;
+        }
+
         ec::Engine engine{ engineInfo };
         engine.run();
         engine.free();
 
         ec::shutdown();
-        system("pause");
+        if (!engineInfo.exportInfo.writes_to_stdout()) {
+            system("pause");  // Its prompt would end up in the exported frames
+        }
     }
     catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;